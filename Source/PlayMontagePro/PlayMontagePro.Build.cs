@@ -12,6 +12,8 @@ public class PlayMontagePro : ModuleRules
 			new string[]
 			{
 				"Core",
+				"GameplayAbilities",
+				"GameplayTasks",
 			}
 			);
 			
@@ -21,6 +23,7 @@ public class PlayMontagePro : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"TraceLog",
 			}
 			);
 
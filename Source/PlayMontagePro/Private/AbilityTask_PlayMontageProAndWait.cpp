@@ -0,0 +1,423 @@
+// Copyright (c) Jared Taylor
+
+#include "AbilityTask_PlayMontageProAndWait.h"
+
+#include "AbilitySystemComponent.h"
+#include "AbilitySystemGlobals.h"
+#include "AbilitySystemLog.h"
+#include "PlayMontageProStatics.h"
+#include "PlayMontageProSubsystem.h"
+#include "Animation/AnimMontage.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/Character.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(AbilityTask_PlayMontageProAndWait)
+
+UAbilityTask_PlayMontageProAndWait::UAbilityTask_PlayMontageProAndWait(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+	, Rate(1.f)
+	, AnimRootMotionTranslationScale(1.f)
+	, StartTimeSeconds(0.f)
+	, bStopWhenAbilityEnds(true)
+	, bAllowInterruptAfterBlendOut(false)
+	, bTriggerNotifiesBeforeStartTime(false)
+	, bEnableCustomTimeDilation(false)
+{
+}
+
+UAbilityTask_PlayMontageProAndWait* UAbilityTask_PlayMontageProAndWait::CreatePlayMontageProAndWaitProxy(UGameplayAbility* OwningAbility,
+	FName TaskInstanceName, UAnimMontage* MontageToPlay, float Rate, FName StartSection, bool bStopWhenAbilityEnds,
+	float AnimRootMotionTranslationScale, float StartTimeSeconds, bool bAllowInterruptAfterBlendOut,
+	bool bTriggerNotifiesBeforeStartTime, bool bEnableCustomTimeDilation)
+{
+	UAbilitySystemGlobals::NonShipping_ApplyGlobalAbilityScaler_Rate(Rate);
+
+	UAbilityTask_PlayMontageProAndWait* MyObj = NewAbilityTask<UAbilityTask_PlayMontageProAndWait>(OwningAbility, TaskInstanceName);
+	MyObj->MontageToPlay = MontageToPlay;
+	MyObj->Rate = Rate;
+	MyObj->StartSection = StartSection;
+	MyObj->AnimRootMotionTranslationScale = AnimRootMotionTranslationScale;
+	MyObj->bStopWhenAbilityEnds = bStopWhenAbilityEnds;
+	MyObj->bAllowInterruptAfterBlendOut = bAllowInterruptAfterBlendOut;
+	MyObj->StartTimeSeconds = StartTimeSeconds;
+	MyObj->bTriggerNotifiesBeforeStartTime = bTriggerNotifiesBeforeStartTime;
+	MyObj->bEnableCustomTimeDilation = bEnableCustomTimeDilation;
+
+	return MyObj;
+}
+
+void UAbilityTask_PlayMontageProAndWait::Activate()
+{
+	if (Ability == nullptr)
+	{
+		return;
+	}
+
+	bool bPlayedMontage = false;
+
+	if (UAbilitySystemComponent* ASC = AbilitySystemComponent.Get())
+	{
+		const FGameplayAbilityActorInfo* ActorInfo = Ability->GetCurrentActorInfo();
+		UAnimInstance* AnimInstance = ActorInfo->GetAnimInstance();
+		if (AnimInstance != nullptr)
+		{
+			// Predicted on the owning client, replicated to everyone else by the ability system component
+			if (ASC->PlayMontage(Ability, Ability->GetCurrentActivationInfo(), MontageToPlay, Rate, StartSection, StartTimeSeconds) > 0.f)
+			{
+				// Playing a montage could potentially fire off a callback into game code which could kill this ability! Early out if we are pending kill.
+				if (ShouldBroadcastAbilityTaskDelegates() == false)
+				{
+					return;
+				}
+
+				InterruptedHandle = Ability->OnGameplayAbilityCancelled.AddUObject(this, &ThisClass::OnGameplayAbilityCancelled);
+
+				BlendingOutDelegate.BindUObject(this, &ThisClass::OnMontageBlendingOut);
+				AnimInstance->Montage_SetBlendingOutDelegate(BlendingOutDelegate, MontageToPlay);
+
+				MontageEndedDelegate.BindUObject(this, &ThisClass::OnMontageEnded);
+				AnimInstance->Montage_SetEndDelegate(MontageEndedDelegate, MontageToPlay);
+
+				ACharacter* Character = Cast<ACharacter>(GetAvatarActor());
+				if (Character && (Character->GetLocalRole() == ROLE_Authority ||
+					(Character->GetLocalRole() == ROLE_AutonomousProxy && Ability->GetNetExecutionPolicy() == EGameplayAbilityNetExecutionPolicy::LocalPredicted)))
+				{
+					Character->SetAnimRootMotionTranslationScale(AnimRootMotionTranslationScale);
+				}
+
+				bPlayedMontage = true;
+
+				// -- PlayMontagePro --
+
+				AnimInstancePtr = AnimInstance;
+				MeshComp = ActorInfo->SkeletalMeshComponent;
+
+				const AActor* Avatar = GetAvatarActor();
+				bFollowTimeDilation = bEnableCustomTimeDilation && Avatar != nullptr;
+				TimeDilation = bFollowTimeDilation ? Avatar->CustomTimeDilation : 1.f;
+
+				AnimInstance->OnMontageSectionChanged.AddDynamic(this, &ThisClass::OnMontageSectionChanged);
+
+				// Scheduled from the predicted start
+				GatherAndScheduleNotifies(bTriggerNotifiesBeforeStartTime);
+				if (!bNotifiesStopped && bFollowTimeDilation)
+				{
+					if (UPlayMontageProSubsystem* Scheduler = UPlayMontageProSubsystem::Get(GetWorld()))
+					{
+						Scheduler->RegisterTimeDilation(this, Avatar, TimeDilation);
+					}
+				}
+			}
+		}
+		else
+		{
+			ABILITY_LOG(Warning, TEXT("UAbilityTask_PlayMontageProAndWait call to PlayMontage failed!"));
+		}
+	}
+	else
+	{
+		ABILITY_LOG(Warning, TEXT("UAbilityTask_PlayMontageProAndWait called on invalid AbilitySystemComponent"));
+	}
+
+	if (!bPlayedMontage)
+	{
+		ABILITY_LOG(Warning, TEXT("UAbilityTask_PlayMontageProAndWait called in Ability %s failed to play montage %s; Task Instance Name %s."),
+			*Ability->GetName(), *GetNameSafe(MontageToPlay), *InstanceName.ToString());
+		if (ShouldBroadcastAbilityTaskDelegates())
+		{
+			OnCancelled.Broadcast();
+		}
+	}
+
+	SetWaitingOnAvatar();
+}
+
+void UAbilityTask_PlayMontageProAndWait::GatherAndScheduleNotifies(bool bTriggerPassedNotifies)
+{
+	UAnimInstance* AnimInstance = AnimInstancePtr.Get();
+	if (!AnimInstance || !MontageToPlay)
+	{
+		return;
+	}
+
+	bNotifiesStopped = false;
+	const float StartPosition = AnimInstance->Montage_GetPosition(MontageToPlay);
+	const FName Section = AnimInstance->Montage_GetCurrentSection(MontageToPlay);
+	const float PlayRate = AnimInstance->Montage_GetPlayRate(MontageToPlay);
+
+	// Shares the compiled table of the montage with every other instance playing it
+	UPlayMontageProStatics::GatherNotifies(MontageToPlay, NotifyId, Notifies, Section, StartPosition, TimeDilation, PlayRate);
+	UPlayMontageProStatics::SkipInsignificantNotifies(Notifies, this);
+
+	const uint32 FirstNotifyId = Notifies.FirstNotifyId;
+	UPlayMontageProStatics::HandleHistoricNotifies(Notifies, bTriggerPassedNotifies, this);
+
+	// A historic notify may have ended the montage or changed section
+	if (!bNotifiesStopped && Notifies.FirstNotifyId == FirstNotifyId)
+	{
+		UPlayMontageProStatics::SetupNotifyTimers(this, GetWorld(), Notifies);
+	}
+}
+
+void UAbilityTask_PlayMontageProAndWait::OnMontageSectionChanged(UAnimMontage* Montage, FName SectionName, bool bLooped)
+{
+	if (bNotifiesStopped || Montage != MontageToPlay)
+	{
+		return;
+	}
+
+	UAnimInstance* AnimInstance = AnimInstancePtr.Get();
+	if (!AnimInstance)
+	{
+		return;
+	}
+
+	// End previous notify timers, keeping the time dilation the clock was running at
+	TimeDilation = Notifies.Clock.TimeDilation;
+	UPlayMontageProStatics::ClearNotifyTimers(GetWorld(), Notifies);
+
+	// Switch to the new section's notifies from the same table, only re-arming them if the section looped
+	const float StartPosition = AnimInstance->Montage_GetPosition(MontageToPlay);
+	const float PlayRate = AnimInstance->Montage_GetPlayRate(MontageToPlay);
+	UPlayMontageProStatics::GatherSectionNotifies(MontageToPlay, NotifyId, Notifies, StartPosition, TimeDilation, PlayRate);
+	UPlayMontageProStatics::SkipInsignificantNotifies(Notifies, this);
+	UPlayMontageProStatics::SetupNotifyTimers(this, GetWorld(), Notifies);
+}
+
+void UAbilityTask_PlayMontageProAndWait::StopNotifies(EAnimNotifyProEventType EventType)
+{
+	if (bNotifiesStopped)
+	{
+		return;
+	}
+	bNotifiesStopped = true;
+
+	UPlayMontageProStatics::ClearNotifyTimers(GetWorld(), Notifies);
+	if (UAnimInstance* AnimInstance = AnimInstancePtr.Get())
+	{
+		AnimInstance->OnMontageSectionChanged.RemoveDynamic(this, &ThisClass::OnMontageSectionChanged);
+	}
+	if (bFollowTimeDilation)
+	{
+		if (UPlayMontageProSubsystem* Scheduler = UPlayMontageProSubsystem::Get(GetWorld()))
+		{
+			Scheduler->UnregisterTimeDilation(this);
+		}
+	}
+
+	// Not queued with the subsystem's terminations, the task is marked as garbage once it ends
+	if (EventType != EAnimNotifyProEventType::None)
+	{
+		UPlayMontageProStatics::EnsureBroadcastNotifyEvents(EventType, Notifies, this);
+	}
+}
+
+void UAbilityTask_PlayMontageProAndWait::OnMontageBlendingOut(UAnimMontage* Montage, bool bInterrupted)
+{
+	const bool bPlayingThisMontage = (Montage == MontageToPlay) && Ability && Ability->GetCurrentMontage() == MontageToPlay;
+	if (bPlayingThisMontage)
+	{
+		// Reset AnimRootMotionTranslationScale
+		ACharacter* Character = Cast<ACharacter>(GetAvatarActor());
+		if (Character && (Character->GetLocalRole() == ROLE_Authority ||
+			(Character->GetLocalRole() == ROLE_AutonomousProxy && Ability->GetNetExecutionPolicy() == EGameplayAbilityNetExecutionPolicy::LocalPredicted)))
+		{
+			Character->SetAnimRootMotionTranslationScale(1.f);
+		}
+	}
+
+	// Notifies keep running while the montage blends out
+	if (!bNotifiesStopped)
+	{
+		UPlayMontageProStatics::EnsureBroadcastNotifyEvents(bInterrupted ? EAnimNotifyProEventType::OnInterrupted : EAnimNotifyProEventType::BlendOut, Notifies, this);
+	}
+
+	if (bPlayingThisMontage && (bInterrupted || !bAllowInterruptAfterBlendOut))
+	{
+		if (UAbilitySystemComponent* ASC = AbilitySystemComponent.Get())
+		{
+			ASC->ClearAnimatingAbility(Ability);
+		}
+	}
+
+	if (ShouldBroadcastAbilityTaskDelegates())
+	{
+		if (bInterrupted)
+		{
+			OnInterrupted.Broadcast();
+		}
+		else
+		{
+			OnBlendOut.Broadcast();
+		}
+	}
+}
+
+void UAbilityTask_PlayMontageProAndWait::OnMontageEnded(UAnimMontage* Montage, bool bInterrupted)
+{
+	StopNotifies(bInterrupted ? EAnimNotifyProEventType::None : EAnimNotifyProEventType::OnCompleted);
+
+	if (!bInterrupted)
+	{
+		if (ShouldBroadcastAbilityTaskDelegates())
+		{
+			OnCompleted.Broadcast();
+		}
+	}
+	else if (bAllowInterruptAfterBlendOut)
+	{
+		if (ShouldBroadcastAbilityTaskDelegates())
+		{
+			OnInterrupted.Broadcast();
+		}
+	}
+
+	EndTask();
+}
+
+void UAbilityTask_PlayMontageProAndWait::OnGameplayAbilityCancelled()
+{
+	if (StopPlayingMontage() || bAllowInterruptAfterBlendOut)
+	{
+		// Let the BP handle the interrupt as well
+		if (ShouldBroadcastAbilityTaskDelegates())
+		{
+			OnInterrupted.Broadcast();
+		}
+	}
+
+	EndTask();
+}
+
+void UAbilityTask_PlayMontageProAndWait::ExternalCancel()
+{
+	if (ShouldBroadcastAbilityTaskDelegates())
+	{
+		OnCancelled.Broadcast();
+	}
+	Super::ExternalCancel();
+}
+
+void UAbilityTask_PlayMontageProAndWait::OnDestroy(bool bInOwnerFinished)
+{
+	// Note: Clearing montage end delegate isn't necessary since its not a multicast and will be cleared when the next montage plays.
+	// (If we are destroyed, it will detect this and not do anything)
+
+	// This delegate, however, should be cleared as it is a multicast
+	if (Ability)
+	{
+		Ability->OnGameplayAbilityCancelled.Remove(InterruptedHandle);
+		if (bInOwnerFinished && bStopWhenAbilityEnds)
+		{
+			StopPlayingMontage();
+		}
+	}
+
+	// Nothing is dispatched once the task is destroyed
+	// Stopping the montage already ensured the notifies for OnCancelled, a montage that keeps playing was not cancelled
+	StopNotifies(EAnimNotifyProEventType::None);
+	if (UPlayMontageProSubsystem* Subsystem = UPlayMontageProSubsystem::Get(GetWorld()))
+	{
+		Subsystem->UnregisterNotifyStateTicks(Notifies);
+	}
+
+	Super::OnDestroy(bInOwnerFinished);
+}
+
+bool UAbilityTask_PlayMontageProAndWait::StopPlayingMontage()
+{
+	if (Ability == nullptr)
+	{
+		return false;
+	}
+
+	const FGameplayAbilityActorInfo* ActorInfo = Ability->GetCurrentActorInfo();
+	if (ActorInfo == nullptr)
+	{
+		return false;
+	}
+
+	UAnimInstance* AnimInstance = ActorInfo->GetAnimInstance();
+	if (AnimInstance == nullptr)
+	{
+		return false;
+	}
+
+	// Check if the montage is still playing
+	// The ability would have been interrupted, in which case we should automatically stop the montage
+	UAbilitySystemComponent* ASC = AbilitySystemComponent.Get();
+	if (ASC && Ability)
+	{
+		if (ASC->GetAnimatingAbility() == Ability
+			&& ASC->GetCurrentMontage() == MontageToPlay)
+		{
+			// Unbind delegates so they don't get called as well
+			FAnimMontageInstance* MontageInstance = AnimInstance->GetActiveInstanceForMontage(MontageToPlay);
+			if (MontageInstance)
+			{
+				MontageInstance->OnMontageBlendingOutStarted.Unbind();
+				MontageInstance->OnMontageEnded.Unbind();
+			}
+
+			// The montage is cancelled rather than interrupted, so notifies are ensured for OnCancelled
+			StopNotifies(EAnimNotifyProEventType::OnCancelled);
+			ASC->CurrentMontageStop();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void UAbilityTask_PlayMontageProAndWait::NotifyCallback(const FAnimNotifyProEvent& Event)
+{
+	if (ShouldBroadcastAbilityTaskDelegates())
+	{
+		OnNotify.Broadcast(Event);
+	}
+}
+
+void UAbilityTask_PlayMontageProAndWait::NotifyBeginCallback(const FAnimNotifyProEvent& Event)
+{
+	if (ShouldBroadcastAbilityTaskDelegates())
+	{
+		OnNotifyStateBegin.Broadcast(Event);
+	}
+}
+
+void UAbilityTask_PlayMontageProAndWait::NotifyEndCallback(const FAnimNotifyProEvent& Event)
+{
+	if (ShouldBroadcastAbilityTaskDelegates())
+	{
+		OnNotifyStateEnd.Broadcast(Event);
+	}
+}
+
+bool UAbilityTask_PlayMontageProAndWait::WantsNotifyEvents() const
+{
+	return OnNotify.IsBound() || OnNotifyStateBegin.IsBound() || OnNotifyStateEnd.IsBound();
+}
+
+bool UAbilityTask_PlayMontageProAndWait::IsSignificant() const
+{
+	const UPlayMontageProSubsystem* Subsystem = UPlayMontageProSubsystem::Get(GetWorld());
+	return !Subsystem || Subsystem->IsSignificant(MeshComp.Get());
+}
+
+FString UAbilityTask_PlayMontageProAndWait::GetDebugString() const
+{
+	UAnimMontage* PlayingMontage = nullptr;
+	if (Ability)
+	{
+		const FGameplayAbilityActorInfo* ActorInfo = Ability->GetCurrentActorInfo();
+		UAnimInstance* AnimInstance = ActorInfo ? ActorInfo->GetAnimInstance() : nullptr;
+
+		if (AnimInstance != nullptr)
+		{
+			PlayingMontage = AnimInstance->Montage_IsActive(MontageToPlay) ? ToRawPtr(MontageToPlay) : AnimInstance->GetCurrentActiveMontage();
+		}
+	}
+
+	return FString::Printf(TEXT("PlayMontageProAndWait. MontageToPlay: %s  (Currently Playing): %s  Pro Notifies: %d"),
+		*GetNameSafe(MontageToPlay), *GetNameSafe(PlayingMontage), Notifies.Num());
+}
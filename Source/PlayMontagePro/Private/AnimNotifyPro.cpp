@@ -2,10 +2,14 @@
 
 
 #include "AnimNotifyPro.h"
+#include "PlayMontageProStatics.h"
+#include "PlayMontageProSubsystem.h"
+#include "PlayMontageProValidation.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "Animation/AnimMontage.h"
 
 #if WITH_EDITOR
+#include "Animation/AnimSequence.h"
 #include "Animation/DebugSkelMeshComponent.h"
 #include "Misc/DataValidation.h"
 #endif
@@ -14,6 +18,8 @@
 
 UAnimNotifyPro::UAnimNotifyPro(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
+	, bCachedImplementsK2OnNotify(false)
+	, bImplementsK2OnNotify(false)
 {
 #if WITH_EDITORONLY_DATA
 	auto ImplementedInBlueprint = [](const UFunction* Func) -> bool
@@ -48,30 +54,62 @@ EDataValidationResult UAnimNotifyPro::IsDataValid(class FDataValidationContext&
 		return EDataValidationResult::Invalid;
 	}
 #endif
+	if (bThreadSafeCallback && GetClass()->HasAnyClassFlags(CLASS_CompiledFromBlueprint))
+	{
+		Context.AddError(
+			FText::Format(
+				NSLOCTEXT("AnimNotifyPro", "BlueprintThreadSafeCallbackWarning",
+					"AnimNotifyPro {0} is a Blueprint with bThreadSafeCallback enabled, which is not supported. "
+					"K2_OnNotify is never called for thread safe notifies, please disable bThreadSafeCallback."),
+				FText::FromString(GetName())
+			)
+		);
+		return EDataValidationResult::Invalid;
+	}
 	return Super::IsDataValid(Context);
 }
 
+bool UAnimNotifyPro::CanBePlaced(UAnimSequenceBase* Animation) const
+{
+	// Composites are not walked when gathering, and their notifies would never trigger
+	return Animation && (Animation->IsA<UAnimMontage>() || Animation->IsA<UAnimSequence>());
+}
+
 #endif
 
 void UAnimNotifyPro::Notify(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation,
 	const FAnimNotifyEventReference& EventReference)
 {
+	// Notifies of a montage's segments are triggered with the segment's sequence
+	UAnimMontage* Montage = UPlayMontageProStatics::GetNotifyMontage(MeshComp, Animation, EventReference);
+
 #if WITH_EDITOR
 	// Editor support -- for previewing in the editor
 	if (MeshComp->IsA<UDebugSkelMeshComponent>() && ShouldFireInEditor())
 	{
-		UAnimMontage* Montage = Animation ? Cast<UAnimMontage>(Animation) : nullptr;
 		OnNotify(MeshComp, Montage);
 	}
 #endif
 
+#if !UE_BUILD_SHIPPING
+	if (!Montage)
+	{
+		// Sequences are previewed on their own in the editor
+#if WITH_EDITOR
+		if (!MeshComp->IsA<UDebugSkelMeshComponent>())
+#endif
+		{
+			PlayMontagePro::Validation::WarnOutsideMontage(this, Animation);
+		}
+	}
+#endif
+
 	if (SimulatedProxyBehavior == EAnimNotifyLegacyType::Legacy)
 	{
 		const AActor* Owner = MeshComp->GetOwner();
 		if (Owner->GetNetMode() != NM_Standalone && Owner->GetLocalRole() == ROLE_SimulatedProxy)
 		{
 			// Legacy behavior, notify will be triggered on simulated proxies no different to the old system
-			UAnimMontage* Montage = Animation ? Cast<UAnimMontage>(Animation) : nullptr;
 			OnNotify(MeshComp, Montage);
 		}
 	}
@@ -86,11 +124,41 @@ void UAnimNotifyPro::NotifyCallback(USkeletalMeshComponent* MeshComp, UAnimMonta
 {
 	if (!MeshComp || MeshComp->GetNetMode() != NM_DedicatedServer || bTriggerOnDedicatedServer)
 	{
+		if (bThreadSafeCallback)
+		{
+			QueueThreadSafeCallback(MeshComp, Montage);
+			return;
+		}
 		OnNotify(MeshComp, Montage);
 	}
 }
 
+void UAnimNotifyPro::QueueThreadSafeCallback(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage) const
+{
+	if (UPlayMontageProSubsystem* Subsystem = MeshComp ? UPlayMontageProSubsystem::Get(MeshComp->GetWorld()) : nullptr)
+	{
+		Subsystem->QueueThreadSafeNotify(this, nullptr, EAnimNotifyProType::Notify, MeshComp, Montage);
+	}
+	else
+	{
+		OnNotifyAnyThread(MeshComp, Montage, nullptr);
+	}
+}
+
 void UAnimNotifyPro::OnNotify(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage)
 {
-	K2_OnNotify(MeshComp, Montage);
+	if (ImplementsK2OnNotify())
+	{
+		K2_OnNotify(MeshComp, Montage);
+	}
+}
+
+bool UAnimNotifyPro::ImplementsK2OnNotify() const
+{
+	if (!bCachedImplementsK2OnNotify)
+	{
+		bImplementsK2OnNotify = GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(UAnimNotifyPro, K2_OnNotify));
+		bCachedImplementsK2OnNotify = true;
+	}
+	return bImplementsK2OnNotify;
 }
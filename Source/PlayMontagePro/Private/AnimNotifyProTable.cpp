@@ -0,0 +1,529 @@
+// Copyright (c) Jared Taylor
+
+#include "AnimNotifyProTable.h"
+
+#include "AnimNotifyPro.h"
+#include "AnimNotifyStatePro.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/StableSort.h"
+#include "Animation/AnimMontage.h"
+#include "UObject/UObjectGlobals.h"
+
+TMap<TObjectKey<UAnimMontage>, TSharedRef<const FAnimNotifyProMontageTable>> FAnimNotifyProTableCache::Tables;
+TArray<TSharedRef<const FAnimNotifyProMontageTable>> FAnimNotifyProTableCache::MergedTables;
+FDelegateHandle FAnimNotifyProTableCache::PostGarbageCollectHandle;
+
+#if WITH_EDITOR
+FDelegateHandle FAnimNotifyProTableCache::ObjectModifiedHandle;
+FDelegateHandle FAnimNotifyProTableCache::ObjectPropertyChangedHandle;
+#endif
+
+namespace AnimNotifyProTable
+{
+	/** Event as it is gathered from the montage, before sorting */
+	struct FGatheredEvent
+	{
+		float Position;
+		EAnimNotifyProType Type;
+		int32 PairIndex;
+		uint8 EnsureTriggerNotify;
+		UAnimNotifyPro* Notify;
+		UAnimNotifyStatePro* NotifyState;
+		uint8 Source;
+	};
+
+	static void AddNotifyState(TArray<FGatheredEvent>& Events, UAnimNotifyStatePro* NotifyState, float Position, float Duration, uint8 Source)
+	{
+		const uint8 EnsureTriggerNotify = static_cast<uint8>(NotifyState->EnsureTriggerNotify);
+		const int32 BeginIndex = Events.Num();
+		Events.Add({ Position, EAnimNotifyProType::NotifyStateBegin, BeginIndex + 1, EnsureTriggerNotify, nullptr, NotifyState, Source });
+		Events.Add({ Position + Duration, EAnimNotifyProType::NotifyStateEnd, BeginIndex, EnsureTriggerNotify, nullptr, NotifyState, Source });
+	}
+
+	/** Adds the notify if it is a Pro notify or notify state, placed at NotifyTime of Montage and lasting Duration */
+	static void AddEvent(const UAnimMontage* Montage, const FAnimNotifyEvent& AnimNotify, float NotifyTime, float Duration, uint8 Source,
+		TArray<TArray<FGatheredEvent>>& SectionEvents, TArray<FGatheredEvent>& InvalidSectionEvents)
+	{
+		// Notifies only belong to the section they are placed in
+		if (UAnimNotifyPro* Notify = AnimNotify.Notify ? Cast<UAnimNotifyPro>(AnimNotify.Notify) : nullptr)
+		{
+			const int32 SectionIndex = Montage->GetSectionIndexFromPosition(NotifyTime);
+			if (SectionEvents.IsValidIndex(SectionIndex))
+			{
+				SectionEvents[SectionIndex].Add({ NotifyTime, EAnimNotifyProType::Notify, INDEX_NONE,
+					static_cast<uint8>(Notify->EnsureTriggerNotify), Notify, nullptr, Source });
+			}
+		}
+
+		// Notify states are gathered regardless of section
+		if (UAnimNotifyStatePro* NotifyState = AnimNotify.NotifyStateClass ? Cast<UAnimNotifyStatePro>(AnimNotify.NotifyStateClass) : nullptr)
+		{
+			for (TArray<FGatheredEvent>& Events : SectionEvents)
+			{
+				AddNotifyState(Events, NotifyState, NotifyTime, Duration, Source);
+			}
+			AddNotifyState(InvalidSectionEvents, NotifyState, NotifyTime, Duration, Source);
+		}
+	}
+
+	/**
+	 * Gathers the Pro notifies of SourceMontage, and of the animations it plays, into the sections of Montage.
+	 * Positions are scaled by PositionScale so notifies of a driven montage are placed where the driver montage reaches them.
+	 * @param OutAnimations Receives every animation whose notifies were gathered through a segment.
+	 */
+	static void GatherEvents(const UAnimMontage* Montage, const UAnimMontage* SourceMontage, uint8 Source, float PositionScale,
+		TArray<TArray<FGatheredEvent>>& SectionEvents, TArray<FGatheredEvent>& InvalidSectionEvents,
+		TArray<TObjectKey<UAnimSequenceBase>>& OutAnimations)
+	{
+		for (const FAnimNotifyEvent& MontageNotify : SourceMontage->Notifies)
+		{
+			AddEvent(Montage, MontageNotify, MontageNotify.GetTime() * PositionScale, MontageNotify.GetDuration() * PositionScale,
+				Source, SectionEvents, InvalidSectionEvents);
+		}
+
+		// Notifies placed in the animations the montage plays, the engine also only triggers them from the first slot track
+		if (SourceMontage->SlotAnimTracks.Num() == 0)
+		{
+			return;
+		}
+
+		for (const FAnimSegment& Segment : SourceMontage->SlotAnimTracks[0].AnimTrack.AnimSegments)
+		{
+			const UAnimSequenceBase* Animation = Segment.GetAnimReference();
+			const float SegmentPlayRate = FMath::Abs(Segment.AnimPlayRate);
+			const float SegmentLength = Segment.AnimEndTime - Segment.AnimStartTime;
+			if (!Animation || SegmentPlayRate <= 0.f || SegmentLength <= 0.f || Animation->Notifies.Num() == 0)
+			{
+				continue;
+			}
+			OutAnimations.AddUnique(Animation);
+
+			for (const FAnimNotifyEvent& AnimNotify : Animation->Notifies)
+			{
+				// Only the part of the notify within the segment's range of the animation is played
+				const float NotifyStart = AnimNotify.GetTime();
+				const float NotifyEnd = NotifyStart + AnimNotify.GetDuration();
+				const bool bInRange = NotifyStart < Segment.AnimEndTime
+					&& (AnimNotify.GetDuration() > 0.f ? NotifyEnd > Segment.AnimStartTime : NotifyStart >= Segment.AnimStartTime);
+				if (!bInRange)
+				{
+					continue;
+				}
+
+				const float ClippedStart = FMath::Max(NotifyStart, Segment.AnimStartTime);
+				const float ClippedEnd = FMath::Min(NotifyEnd, Segment.AnimEndTime);
+				const float Duration = (ClippedEnd - ClippedStart) / SegmentPlayRate * PositionScale;
+
+				// A reversed segment reaches the end of the notify first
+				const float AnimOffset = Segment.AnimPlayRate > 0.f ? ClippedStart - Segment.AnimStartTime : Segment.AnimEndTime - ClippedEnd;
+				for (int32 Loop = 0; Loop < FMath::Max(1, Segment.LoopingCount); Loop++)
+				{
+					const float NotifyTime = Segment.StartPos + (Loop * SegmentLength + AnimOffset) / SegmentPlayRate;
+					AddEvent(Montage, AnimNotify, NotifyTime * PositionScale, Duration, Source, SectionEvents, InvalidSectionEvents);
+				}
+			}
+		}
+	}
+
+	static void Compile(const TArray<FGatheredEvent>& Events, FAnimNotifyProSectionTable& Table)
+	{
+		const int32 NumEvents = Events.Num();
+
+		// Sort by position, stable so that events at the same position keep their montage order, i.e. state begin before state end
+		TArray<int32> SortedIndices;
+		SortedIndices.SetNumUninitialized(NumEvents);
+		for (int32 EventIndex = 0; EventIndex < NumEvents; EventIndex++)
+		{
+			SortedIndices[EventIndex] = EventIndex;
+		}
+		Algo::StableSortBy(SortedIndices, [&Events](int32 EventIndex) { return Events[EventIndex].Position; });
+
+		// Map gathered indices to sorted indices so pairs can be resolved
+		TArray<int32> GatheredToSorted;
+		GatheredToSorted.SetNumUninitialized(NumEvents);
+		for (int32 SortedIndex = 0; SortedIndex < NumEvents; SortedIndex++)
+		{
+			GatheredToSorted[SortedIndices[SortedIndex]] = SortedIndex;
+		}
+
+		Table.Positions.Reserve(NumEvents);
+		Table.Types.Reserve(NumEvents);
+		Table.PairIndices.Reserve(NumEvents);
+		Table.EnsureTriggerNotify.Reserve(NumEvents);
+		Table.Notifies.Reserve(NumEvents);
+		Table.NotifyStates.Reserve(NumEvents);
+		Table.Sources.Reserve(NumEvents);
+
+		for (const int32 EventIndex : SortedIndices)
+		{
+			const FGatheredEvent& Event = Events[EventIndex];
+			Table.Positions.Add(Event.Position);
+			Table.Types.Add(Event.Type);
+			Table.PairIndices.Add(Event.PairIndex != INDEX_NONE ? GatheredToSorted[Event.PairIndex] : INDEX_NONE);
+			Table.EnsureTriggerNotify.Add(Event.EnsureTriggerNotify);
+			Table.Notifies.Add(Event.Notify);
+			Table.NotifyStates.Add(Event.NotifyState);
+			Table.Sources.Add(Event.Source);
+		}
+
+		// Precompute which events each ensure condition needs to check
+		const int32 NumWords = FMath::DivideAndRoundUp(NumEvents, 32);
+		for (TArray<uint32>& EnsureMask : Table.EnsureMasks)
+		{
+			EnsureMask.SetNumZeroed(NumWords);
+		}
+		Table.EndStateMask.SetNumZeroed(NumWords);
+		Table.CosmeticMask.SetNumZeroed(NumWords);
+
+		for (int32 EventIndex = 0; EventIndex < NumEvents; EventIndex++)
+		{
+			const int32 WordIndex = EventIndex / 32;
+			const uint32 EventBit = 1u << (EventIndex % 32);
+			for (int32 ReasonIndex = 0; ReasonIndex < FAnimNotifyProSectionTable::NumEnsureReasons; ReasonIndex++)
+			{
+				if (Table.EnsureTriggerNotify[EventIndex] & (1 << ReasonIndex))
+				{
+					Table.EnsureMasks[ReasonIndex][WordIndex] |= EventBit;
+				}
+			}
+			if (Table.Types[EventIndex] == EAnimNotifyProType::NotifyStateEnd)
+			{
+				Table.EndStateMask[WordIndex] |= EventBit;
+			}
+
+			// Both events of a notify state share its significance, so a state is never begun without being ended
+			const EAnimNotifyProSignificance Significance = Table.Notifies[EventIndex].IsValid()
+				? Table.Notifies[EventIndex]->Significance : Table.NotifyStates[EventIndex]->Significance;
+			if (Significance == EAnimNotifyProSignificance::Cosmetic && Table.EnsureTriggerNotify[EventIndex] == 0)
+			{
+				Table.CosmeticMask[WordIndex] |= EventBit;
+			}
+		}
+	}
+}
+
+TSharedRef<FAnimNotifyProMontageTable> FAnimNotifyProMontageTable::Build(const UAnimMontage* Montage, TConstArrayView<FAnimNotifyProDrivenSource> DrivenSources)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FAnimNotifyProMontageTable::Build);
+
+	using namespace AnimNotifyProTable;
+
+	TSharedRef<FAnimNotifyProMontageTable> Table = MakeShared<FAnimNotifyProMontageTable>();
+	Table->Montage = Montage;
+
+	const int32 NumSections = Montage->CompositeSections.Num();
+	TArray<TArray<FGatheredEvent>> SectionEvents;
+	SectionEvents.SetNum(NumSections);
+	TArray<FGatheredEvent> InvalidSectionEvents;
+
+	GatherEvents(Montage, Montage, 0, 1.f, SectionEvents, InvalidSectionEvents, Table->Animations);
+
+	// Driven notifies are placed where the driver montage reaches them, so they share its sections and schedule
+	const int32 NumDriven = FMath::Min(DrivenSources.Num(), static_cast<int32>(MAX_uint8));
+	ensureMsgf(NumDriven == DrivenSources.Num(), TEXT("Too many driven montages (%d), only %d are merged"), DrivenSources.Num(), MAX_uint8);
+	for (int32 DrivenIndex = 0; DrivenIndex < NumDriven; DrivenIndex++)
+	{
+		const FAnimNotifyProDrivenSource& Driven = DrivenSources[DrivenIndex];
+		Table->DrivenMontages.Add(Driven.Montage);
+		Table->DrivenPositionScales.Add(Driven.PositionScale);
+		if (Driven.Montage)
+		{
+			GatherEvents(Montage, Driven.Montage, static_cast<uint8>(DrivenIndex + 1), Driven.PositionScale, SectionEvents, InvalidSectionEvents,
+				Table->Animations);
+		}
+	}
+
+	Table->Sections.SetNum(NumSections);
+	for (int32 SectionIndex = 0; SectionIndex < NumSections; SectionIndex++)
+	{
+		Compile(SectionEvents[SectionIndex], Table->Sections[SectionIndex]);
+	}
+	Compile(InvalidSectionEvents, Table->InvalidSection);
+
+	// Sections are not necessarily stored in the order they are placed
+	Table->SortedSectionIndices.SetNumUninitialized(NumSections);
+	for (int32 SectionIndex = 0; SectionIndex < NumSections; SectionIndex++)
+	{
+		Table->SortedSectionIndices[SectionIndex] = SectionIndex;
+	}
+	Algo::StableSortBy(Table->SortedSectionIndices, [Montage](int32 SectionIndex) { return Montage->CompositeSections[SectionIndex].GetTime(); });
+
+	Table->SectionStartTimes.Reserve(NumSections);
+	for (const int32 SectionIndex : Table->SortedSectionIndices)
+	{
+		Table->SectionStartTimes.Add(Montage->CompositeSections[SectionIndex].GetTime());
+	}
+
+	return Table;
+}
+
+bool FAnimNotifyProMontageTable::Matches(const UAnimMontage* InMontage, TConstArrayView<FAnimNotifyProDrivenSource> DrivenSources) const
+{
+	if (Montage != TObjectKey<UAnimMontage>(InMontage) || DrivenMontages.Num() != DrivenSources.Num())
+	{
+		return false;
+	}
+
+	for (int32 DrivenIndex = 0; DrivenIndex < DrivenSources.Num(); DrivenIndex++)
+	{
+		if (DrivenMontages[DrivenIndex] != TObjectKey<UAnimMontage>(DrivenSources[DrivenIndex].Montage)
+			|| DrivenPositionScales[DrivenIndex] != DrivenSources[DrivenIndex].PositionScale)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int32 FAnimNotifyProMontageTable::FindSectionIndex(float Position) const
+{
+	// Last section that starts at or before the position
+	const int32 SortedIndex = Algo::UpperBound(SectionStartTimes, Position) - 1;
+	return SortedSectionIndices.IsValidIndex(SortedIndex) ? SortedSectionIndices[SortedIndex] : INDEX_NONE;
+}
+
+void FAnimNotifyProEvents::Init(const TSharedRef<const FAnimNotifyProMontageTable>& InMontageTable,
+	const FAnimNotifyProSectionTable& InTable, uint32 InFirstNotifyId)
+{
+	MontageTable = InMontageTable;
+	Table = &InTable;
+	FirstNotifyId = InFirstNotifyId;
+
+	const int32 NumEvents = InTable.Num();
+	Times.Reset(NumEvents);
+	Times.SetNumUninitialized(NumEvents);
+	HasBroadcast.Reset();
+	HasBroadcast.Add(false, NumEvents);
+	Skipped.Reset();
+	Skipped.Add(false, NumEvents);
+	Clock = FAnimNotifyProClock();
+	FixedStep.TickRate = FAnimNotifyProFixedStepClock::DefaultTickRate;
+	FixedStep.CurrentTick = 0;
+	FixedStep.FireTicks.Reset();
+	NextEventIndex = 0;
+	ScheduleHandle = 0;
+}
+
+int32 FAnimNotifyProFixedStepClock::GetTick(float LocalTime, float Scale, int32 InTickRate)
+{
+	if (Scale <= 0.f || InTickRate <= 0)
+	{
+		return MAX_int32;
+	}
+
+	// Computed the same way everywhere from the same inputs, the tolerance keeps events placed exactly on a tick on that tick
+	const double Ticks = static_cast<double>(LocalTime) * InTickRate / Scale;
+	return static_cast<int32>(FMath::Clamp(FMath::CeilToDouble(Ticks - UE_KINDA_SMALL_NUMBER), 1.0, static_cast<double>(MAX_int32)));
+}
+
+void FAnimNotifyProEvents::Rearm(uint32 InFirstNotifyId)
+{
+	FirstNotifyId = InFirstNotifyId;
+
+	const int32 NumEvents = Num();
+	HasBroadcast.SetRange(0, NumEvents, false);
+	Skipped.SetRange(0, NumEvents, false);
+	Clock = FAnimNotifyProClock();
+	NextEventIndex = 0;
+	ScheduleHandle = 0;
+}
+
+void FAnimNotifyProEvents::Reset()
+{
+	MontageTable.Reset();
+	Table = nullptr;
+	FirstNotifyId = 0;
+	Times.Reset();
+	HasBroadcast.Reset();
+	Skipped.Reset();
+	Clock = FAnimNotifyProClock();
+	NextEventIndex = 0;
+	ScheduleHandle = 0;
+	TickHandles.Reset();
+}
+
+FAnimNotifyProEvent FAnimNotifyProEvents::MakeEvent(int32 Index) const
+{
+	FAnimNotifyProEvent Event(GetNotifyId(Index), Table->EnsureTriggerNotify[Index], Table->Types[Index], Times[Index], Table->Positions[Index]);
+	Event.bHasBroadcast = HasBroadcast[Index];
+	Event.bNotifySkipped = Skipped[Index];
+	Event.bIsEndState = IsEndState(Index);
+	Event.NotifyStatePairIndex = Table->PairIndices[Index];
+	Event.Notify = Table->Notifies[Index];
+	Event.NotifyState = Table->NotifyStates[Index];
+	return Event;
+}
+
+uint32 FAnimNotifyProEvents::FindTickHandle(const UAnimNotifyStatePro* NotifyState) const
+{
+	// Only the states of this montage that are ticking right now, rarely more than one
+	for (const TPair<const UAnimNotifyStatePro*, uint32>& TickHandle : TickHandles)
+	{
+		if (TickHandle.Key == NotifyState)
+		{
+			return TickHandle.Value;
+		}
+	}
+	return 0;
+}
+
+void FAnimNotifyProEvents::AddTickHandle(const UAnimNotifyStatePro* NotifyState, uint32 Handle)
+{
+	for (TPair<const UAnimNotifyStatePro*, uint32>& TickHandle : TickHandles)
+	{
+		if (TickHandle.Key == NotifyState)
+		{
+			TickHandle.Value = Handle;
+			return;
+		}
+	}
+	TickHandles.Emplace(NotifyState, Handle);
+}
+
+uint32 FAnimNotifyProEvents::RemoveTickHandle(const UAnimNotifyStatePro* NotifyState)
+{
+	for (int32 Index = 0; Index < TickHandles.Num(); Index++)
+	{
+		if (TickHandles[Index].Key == NotifyState)
+		{
+			const uint32 Handle = TickHandles[Index].Value;
+			TickHandles.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+			return Handle;
+		}
+	}
+	return 0;
+}
+
+TSharedRef<const FAnimNotifyProMontageTable> FAnimNotifyProTableCache::Get(const UAnimMontage* Montage)
+{
+	check(IsInGameThread());
+	check(Montage);
+
+	if (const TSharedRef<const FAnimNotifyProMontageTable>* Table = Tables.Find(Montage))
+	{
+		return *Table;
+	}
+
+	return Tables.Add(Montage, FAnimNotifyProMontageTable::Build(Montage));
+}
+
+TSharedRef<const FAnimNotifyProMontageTable> FAnimNotifyProTableCache::GetMerged(const UAnimMontage* Montage,
+	TConstArrayView<FAnimNotifyProDrivenSource> DrivenSources)
+{
+	check(IsInGameThread());
+	check(Montage);
+
+	if (DrivenSources.Num() == 0)
+	{
+		return Get(Montage);
+	}
+
+	for (const TSharedRef<const FAnimNotifyProMontageTable>& Table : MergedTables)
+	{
+		if (Table->Matches(Montage, DrivenSources))
+		{
+			return Table;
+		}
+	}
+
+	return MergedTables.Add_GetRef(FAnimNotifyProMontageTable::Build(Montage, DrivenSources));
+}
+
+void FAnimNotifyProTableCache::Invalidate(const UObject* Object)
+{
+	if (!Object || (Tables.Num() == 0 && MergedTables.Num() == 0))
+	{
+		return;
+	}
+
+	// Notifies are instanced with the montage or sequence as their outer
+	const UAnimSequenceBase* Animation = Object->IsA<UAnimSequenceBase>() ? Cast<UAnimSequenceBase>(Object) : Object->GetTypedOuter<UAnimSequenceBase>();
+	if (!Animation)
+	{
+		return;
+	}
+
+	if (const UAnimMontage* Montage = Cast<UAnimMontage>(Animation))
+	{
+		Tables.Remove(Montage);
+
+		const TObjectKey<UAnimMontage> MontageKey(Montage);
+		MergedTables.RemoveAll([&MontageKey](const TSharedRef<const FAnimNotifyProMontageTable>& Table)
+		{
+			return Table->Montage == MontageKey || Table->DrivenMontages.Contains(MontageKey);
+		});
+		return;
+	}
+
+	// Sequences are flattened into every montage that plays them
+	const TObjectKey<UAnimSequenceBase> AnimationKey(Animation);
+	for (auto It = Tables.CreateIterator(); It; ++It)
+	{
+		if (It.Value()->Animations.Contains(AnimationKey))
+		{
+			It.RemoveCurrent();
+		}
+	}
+	MergedTables.RemoveAll([&AnimationKey](const TSharedRef<const FAnimNotifyProMontageTable>& Table)
+	{
+		return Table->Animations.Contains(AnimationKey);
+	});
+}
+
+void FAnimNotifyProTableCache::Reset()
+{
+	Tables.Reset();
+	MergedTables.Reset();
+}
+
+void FAnimNotifyProTableCache::Startup()
+{
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddStatic(&FAnimNotifyProTableCache::OnPostGarbageCollect);
+
+#if WITH_EDITOR
+	ObjectModifiedHandle = FCoreUObjectDelegates::OnObjectModified.AddStatic(&FAnimNotifyProTableCache::OnObjectModified);
+	ObjectPropertyChangedHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddStatic(&FAnimNotifyProTableCache::OnObjectPropertyChanged);
+#endif
+}
+
+void FAnimNotifyProTableCache::Shutdown()
+{
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+
+#if WITH_EDITOR
+	FCoreUObjectDelegates::OnObjectModified.Remove(ObjectModifiedHandle);
+	FCoreUObjectDelegates::OnObjectPropertyChanged.Remove(ObjectPropertyChangedHandle);
+#endif
+
+	Reset();
+}
+
+void FAnimNotifyProTableCache::OnPostGarbageCollect()
+{
+	for (auto It = Tables.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().ResolveObjectPtr())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	// A merged table is only valid while the driver and every driven montage are
+	MergedTables.RemoveAll([](const TSharedRef<const FAnimNotifyProMontageTable>& Table)
+	{
+		return !Table->Montage.ResolveObjectPtr() || Table->DrivenMontages.ContainsByPredicate(
+			[](const TObjectKey<UAnimMontage>& DrivenMontage) { return !DrivenMontage.ResolveObjectPtr(); });
+	});
+}
+
+#if WITH_EDITOR
+void FAnimNotifyProTableCache::OnObjectModified(UObject* Object)
+{
+	Invalidate(Object);
+}
+
+void FAnimNotifyProTableCache::OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Invalidate(Object);
+}
+#endif
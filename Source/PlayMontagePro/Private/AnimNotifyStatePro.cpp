@@ -2,10 +2,14 @@
 
 
 #include "AnimNotifyStatePro.h"
+#include "PlayMontageProStatics.h"
+#include "PlayMontageProSubsystem.h"
+#include "PlayMontageProValidation.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "Animation/AnimMontage.h"
 
 #if WITH_EDITOR
+#include "Animation/AnimSequence.h"
 #include "Animation/DebugSkelMeshComponent.h"
 #include "Misc/DataValidation.h"
 #endif
@@ -14,6 +18,10 @@
 
 UAnimNotifyStatePro::UAnimNotifyStatePro(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
+	, bCachedImplementsK2Events(false)
+	, bImplementsK2OnNotifyBegin(false)
+	, bImplementsK2OnNotifyEnd(false)
+	, bImplementsK2OnNotifyTick(false)
 {
 #if WITH_EDITORONLY_DATA
 	auto ImplementedInBlueprint = [](const UFunction* Func) -> bool
@@ -65,7 +73,7 @@ EDataValidationResult UAnimNotifyStatePro::IsDataValid(class FDataValidationCont
 			FText::Format(
 				NSLOCTEXT("AnimNotifyStatePro", "BlueprintReceivedNotifyTickWarning",
 					"AnimNotifyPro {0} has a Blueprint implementation of Received_NotifyTick, which is not supported. "
-					"Ticking is not supported with Pro."),
+					"Please use K2_OnNotifyTick instead, and set TickRate."),
 				FText::FromString(GetName())
 			)
 		);
@@ -84,9 +92,27 @@ EDataValidationResult UAnimNotifyStatePro::IsDataValid(class FDataValidationCont
 		return EDataValidationResult::Invalid;
 	}
 #endif
+	if (bThreadSafeCallback && GetClass()->HasAnyClassFlags(CLASS_CompiledFromBlueprint))
+	{
+		Context.AddError(
+			FText::Format(
+				NSLOCTEXT("AnimNotifyStatePro", "BlueprintThreadSafeCallbackWarning",
+					"AnimNotifyPro {0} is a Blueprint with bThreadSafeCallback enabled, which is not supported. "
+					"K2_OnNotifyBegin and K2_OnNotifyEnd are never called for thread safe notifies, please disable bThreadSafeCallback."),
+				FText::FromString(GetName())
+			)
+		);
+		return EDataValidationResult::Invalid;
+	}
 	return Super::IsDataValid(Context);
 }
 
+bool UAnimNotifyStatePro::CanBePlaced(UAnimSequenceBase* Animation) const
+{
+	// Composites are not walked when gathering, and their notifies would never trigger
+	return Animation && (Animation->IsA<UAnimMontage>() || Animation->IsA<UAnimSequence>());
+}
+
 #endif
 
 bool UAnimNotifyStatePro::WantsSimulatedProxyNotify(const USkeletalMeshComponent* MeshComp) const
@@ -106,19 +132,33 @@ bool UAnimNotifyStatePro::WantsSimulatedProxyNotify(const USkeletalMeshComponent
 void UAnimNotifyStatePro::NotifyBegin(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation,
 	float TotalDuration, const FAnimNotifyEventReference& EventReference)
 {
+	// Notifies of a montage's segments are triggered with the segment's sequence
+	UAnimMontage* Montage = UPlayMontageProStatics::GetNotifyMontage(MeshComp, Animation, EventReference);
+
 #if WITH_EDITOR
 	// Editor support -- for previewing in the editor
 	if (MeshComp->IsA<UDebugSkelMeshComponent>() && ShouldFireInEditor())
 	{
-		UAnimMontage* Montage = Animation ? Cast<UAnimMontage>(Animation) : nullptr;
 		OnNotifyBegin(MeshComp, Montage);
 	}
 #endif
 
+#if !UE_BUILD_SHIPPING
+	if (!Montage)
+	{
+		// Sequences are previewed on their own in the editor
+#if WITH_EDITOR
+		if (!MeshComp->IsA<UDebugSkelMeshComponent>())
+#endif
+		{
+			PlayMontagePro::Validation::WarnOutsideMontage(this, Animation);
+		}
+	}
+#endif
+
 	if (WantsSimulatedProxyNotify(MeshComp))
 	{
 		// Legacy behavior, notify will be triggered on simulated proxies no different to the old system
-		UAnimMontage* Montage = Animation ? Cast<UAnimMontage>(Animation) : nullptr;
 		OnNotifyBegin(MeshComp, Montage);
 	}
 }
@@ -126,11 +166,12 @@ void UAnimNotifyStatePro::NotifyBegin(USkeletalMeshComponent* MeshComp, UAnimSeq
 void UAnimNotifyStatePro::NotifyEnd(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation,
 	const FAnimNotifyEventReference& EventReference)
 {
+	UAnimMontage* Montage = UPlayMontageProStatics::GetNotifyMontage(MeshComp, Animation, EventReference);
+
 #if WITH_EDITOR
 	// Editor support -- for previewing in the editor
 	if (MeshComp->IsA<UDebugSkelMeshComponent>() && ShouldFireInEditor())
 	{
-		UAnimMontage* Montage = Animation ? Cast<UAnimMontage>(Animation) : nullptr;
 		OnNotifyEnd(MeshComp, Montage);
 	}
 #endif
@@ -138,7 +179,6 @@ void UAnimNotifyStatePro::NotifyEnd(USkeletalMeshComponent* MeshComp, UAnimSeque
 	if (WantsSimulatedProxyNotify(MeshComp))
 	{
 		// Legacy behavior, notify will be triggered on simulated proxies no different to the old system
-		UAnimMontage* Montage = Animation ? Cast<UAnimMontage>(Animation) : nullptr;
 		OnNotifyEnd(MeshComp, Montage);
 	}
 }
@@ -152,6 +192,11 @@ void UAnimNotifyStatePro::NotifyBeginCallback(USkeletalMeshComponent* MeshComp,
 {
 	if (ShouldTriggerNotify(MeshComp))
 	{
+		if (bThreadSafeCallback)
+		{
+			QueueThreadSafeCallback(EAnimNotifyProType::NotifyStateBegin, MeshComp, Montage);
+			return;
+		}
 		OnNotifyBegin(MeshComp, Montage);
 	}
 }
@@ -160,16 +205,64 @@ void UAnimNotifyStatePro::NotifyEndCallback(USkeletalMeshComponent* MeshComp, UA
 {
 	if (ShouldTriggerNotify(MeshComp))
 	{
+		if (bThreadSafeCallback)
+		{
+			QueueThreadSafeCallback(EAnimNotifyProType::NotifyStateEnd, MeshComp, Montage);
+			return;
+		}
 		OnNotifyEnd(MeshComp, Montage);
 	}
 }
 
+void UAnimNotifyStatePro::QueueThreadSafeCallback(EAnimNotifyProType NotifyType, USkeletalMeshComponent* MeshComp,
+	UAnimMontage* Montage) const
+{
+	if (UPlayMontageProSubsystem* Subsystem = MeshComp ? UPlayMontageProSubsystem::Get(MeshComp->GetWorld()) : nullptr)
+	{
+		Subsystem->QueueThreadSafeNotify(nullptr, this, NotifyType, MeshComp, Montage);
+	}
+	else if (NotifyType == EAnimNotifyProType::NotifyStateBegin)
+	{
+		OnNotifyBeginAnyThread(MeshComp, Montage, nullptr);
+	}
+	else
+	{
+		OnNotifyEndAnyThread(MeshComp, Montage, nullptr);
+	}
+}
+
 void UAnimNotifyStatePro::OnNotifyBegin(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage)
 {
-	K2_OnNotifyBegin(MeshComp, Montage);
+	if (ImplementsK2OnNotifyBegin())
+	{
+		K2_OnNotifyBegin(MeshComp, Montage);
+	}
 }
 
 void UAnimNotifyStatePro::OnNotifyEnd(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage)
 {
-	K2_OnNotifyEnd(MeshComp, Montage);
+	if (ImplementsK2OnNotifyEnd())
+	{
+		K2_OnNotifyEnd(MeshComp, Montage);
+	}
+}
+
+void UAnimNotifyStatePro::OnNotifyTick(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage, float DeltaTime)
+{
+	if (ImplementsK2OnNotifyTick())
+	{
+		K2_OnNotifyTick(MeshComp, Montage, DeltaTime);
+	}
+}
+
+void UAnimNotifyStatePro::CacheImplementsK2Events() const
+{
+	if (!bCachedImplementsK2Events)
+	{
+		const UClass* Class = GetClass();
+		bImplementsK2OnNotifyBegin = Class->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(UAnimNotifyStatePro, K2_OnNotifyBegin));
+		bImplementsK2OnNotifyEnd = Class->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(UAnimNotifyStatePro, K2_OnNotifyEnd));
+		bImplementsK2OnNotifyTick = Class->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(UAnimNotifyStatePro, K2_OnNotifyTick));
+		bCachedImplementsK2Events = true;
+	}
 }
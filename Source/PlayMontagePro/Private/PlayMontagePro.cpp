@@ -2,17 +2,23 @@
 
 #include "PlayMontagePro.h"
 
+#include "AnimNotifyProTable.h"
+
+DEFINE_LOG_CATEGORY(LogPlayMontagePro);
+
 #define LOCTEXT_NAMESPACE "FPlayMontageProModule"
 
 void FPlayMontageProModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+	FAnimNotifyProTableCache::Startup();
 }
 
 void FPlayMontageProModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FAnimNotifyProTableCache::Shutdown();
 }
 
 #undef LOCTEXT_NAMESPACE
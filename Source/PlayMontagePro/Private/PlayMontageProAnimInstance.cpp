@@ -0,0 +1,145 @@
+// Copyright (c) Jared Taylor
+
+#include "PlayMontageProAnimInstance.h"
+
+#include "AnimNotifyProTable.h"
+#include "PlayMontageProInterface.h"
+#include "Algo/BinarySearch.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(PlayMontageProAnimInstance)
+
+//////////////////////////////////////////////////////////////////////////
+// FPlayMontageProAnimInstanceProxy
+
+void FPlayMontageProAnimInstanceProxy::PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds)
+{
+	FAnimInstanceProxy::PreUpdate(InAnimInstance, DeltaSeconds);
+
+	CastChecked<UPlayMontageProAnimInstance>(InAnimInstance)->CopyPositionWatches(PositionWatches);
+}
+
+void FPlayMontageProAnimInstanceProxy::Update(float DeltaSeconds)
+{
+	FAnimInstanceProxy::Update(DeltaSeconds);
+
+	if (PositionWatches.Num() == 0)
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPlayMontageProAnimInstanceProxy::Update);
+
+	// Montages have already been advanced on the game thread, find which ones crossed a notify since the last update
+	for (FPlayMontageProPositionWatch& Watch : PositionWatches)
+	{
+		const FMontageEvaluationState* State = GetMontageEvaluationData().FindByPredicate([&Watch](const FMontageEvaluationState& EvaluationState)
+		{
+			return EvaluationState.Montage == Watch.Montage;
+		});
+
+		if (!State || !Watch.Table)
+		{
+			continue;
+		}
+
+		const float Position = State->MontagePosition;
+		Watch.bCrossed = Position < Watch.LastPosition
+			|| Algo::UpperBound(Watch.Table->Positions, Watch.LastPosition) != Algo::UpperBound(Watch.Table->Positions, Position);
+		Watch.LastPosition = Position;
+	}
+}
+
+void FPlayMontageProAnimInstanceProxy::PostUpdate(UAnimInstance* InAnimInstance) const
+{
+	FAnimInstanceProxy::PostUpdate(InAnimInstance);
+
+	CastChecked<UPlayMontageProAnimInstance>(InAnimInstance)->DispatchPositionWatches(PositionWatches);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UPlayMontageProAnimInstance
+
+void UPlayMontageProAnimInstance::RegisterMontagePositionDispatch(IPlayMontageProInterface* Interface, UAnimMontage* Montage,
+	float Position)
+{
+	check(IsInGameThread());
+
+	if (Interface && Montage)
+	{
+		FPlayMontageProPositionWatch& Watch = PositionWatches.AddDefaulted_GetRef();
+		Watch.Interface = TWeakInterfacePtr<IPlayMontageProInterface>(Interface);
+		Watch.Montage = Montage;
+		Watch.LastPosition = Position;
+	}
+}
+
+void UPlayMontageProAnimInstance::UnregisterMontagePositionDispatch(IPlayMontageProInterface* Interface)
+{
+	check(IsInGameThread());
+
+	// Reset rather than remove, the proxy's copy is matched by index until the next update
+	for (FPlayMontageProPositionWatch& Watch : PositionWatches)
+	{
+		if (Watch.Interface.Get() == Interface)
+		{
+			Watch.Interface.Reset();
+		}
+	}
+}
+
+FAnimInstanceProxy* UPlayMontageProAnimInstance::CreateAnimInstanceProxy()
+{
+	return new FPlayMontageProAnimInstanceProxy(this);
+}
+
+void UPlayMontageProAnimInstance::DestroyAnimInstanceProxy(FAnimInstanceProxy* InProxy)
+{
+	delete static_cast<FPlayMontageProAnimInstanceProxy*>(InProxy);
+}
+
+void UPlayMontageProAnimInstance::CopyPositionWatches(TArray<FPlayMontageProPositionWatch>& OutWatches)
+{
+	PositionWatches.RemoveAll([](const FPlayMontageProPositionWatch& Watch)
+	{
+		return !Watch.Interface.IsValid();
+	});
+
+	// The worker may only read the section tables, which are immutable and kept alive by the copy
+	for (FPlayMontageProPositionWatch& Watch : PositionWatches)
+	{
+		const FAnimNotifyProEvents& Notifies = Watch.Interface.Get()->GetNotifies();
+		Watch.MontageTable = Notifies.MontageTable;
+		Watch.Table = Notifies.Table;
+		Watch.FirstNotifyId = Notifies.FirstNotifyId;
+		Watch.bCrossed = false;
+	}
+
+	OutWatches.Reset();
+	OutWatches.Append(PositionWatches);
+}
+
+void UPlayMontageProAnimInstance::DispatchPositionWatches(const TArray<FPlayMontageProPositionWatch>& UpdatedWatches)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProAnimInstance::DispatchPositionWatches);
+
+	// Watches registered during the update were appended, and unregistered watches were only reset, so indices still match
+	const int32 NumWatches = FMath::Min(UpdatedWatches.Num(), PositionWatches.Num());
+	for (int32 WatchIndex = 0; WatchIndex < NumWatches; WatchIndex++)
+	{
+		const FPlayMontageProPositionWatch& UpdatedWatch = UpdatedWatches[WatchIndex];
+		PositionWatches[WatchIndex].LastPosition = UpdatedWatch.LastPosition;
+
+		// A notify may have ended another montage on this mesh
+		IPlayMontageProInterface* Interface = PositionWatches[WatchIndex].Interface.Get();
+		if (!Interface)
+		{
+			continue;
+		}
+
+		// Notifies gathered again after the copy, e.g. by a section change, were not seen by the worker
+		if (UpdatedWatch.bCrossed || Interface->GetNotifies().FirstNotifyId != UpdatedWatch.FirstNotifyId)
+		{
+			Interface->TickMontagePosition();
+		}
+	}
+}
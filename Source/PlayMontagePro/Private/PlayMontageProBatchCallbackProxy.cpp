@@ -0,0 +1,136 @@
+// Copyright (c) Jared Taylor
+
+#include "PlayMontageProBatchCallbackProxy.h"
+
+#include "PlayMontageProCallbackProxy.h"
+#include "PlayMontageProSubsystem.h"
+#include "TimerManager.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Containers/Ticker.h"
+#include "Engine/World.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(PlayMontageProBatchCallbackProxy)
+
+UPlayMontageProBatchCallbackProxy* UPlayMontageProBatchCallbackProxy::CreateProxyObjectForPlayMontageProBatch(
+	const TArray<USkeletalMeshComponent*>& InSkeletalMeshComponents,
+	UAnimMontage* MontageToPlay,
+	float PlayRate,
+	float StartingPosition,
+	FName StartingSection,
+	bool bTriggerNotifiesBeforeStartTime,
+	bool bEnableCustomTimeDilation,
+	bool bShouldStopAllMontages,
+	EAnimNotifyProDispatchMode DispatchMode)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProBatchCallbackProxy::CreateProxyObjectForPlayMontageProBatch);
+
+	UPlayMontageProBatchCallbackProxy* Batch = NewObject<UPlayMontageProBatchCallbackProxy>();
+	Batch->SetFlags(RF_StrongRefOnFrame);
+
+	// Meshes are expected to share a world, the proxies still use the subsystem of their own mesh's world
+	const USkeletalMeshComponent* const* FirstMesh = InSkeletalMeshComponents.FindByPredicate([](const USkeletalMeshComponent* Mesh) { return Mesh != nullptr; });
+	UPlayMontageProSubsystem* Scheduler = FirstMesh ? UPlayMontageProSubsystem::Get((*FirstMesh)->GetWorld()) : nullptr;
+	Batch->Subsystem = Scheduler;
+
+	// Take every proxy from the pool up front
+	const int32 NumMeshes = InSkeletalMeshComponents.Num();
+	TArray<UPlayMontageProCallbackProxy*> NewProxies;
+	if (Scheduler)
+	{
+		Scheduler->AcquireProxies(NumMeshes, NewProxies);
+		Scheduler->RegisterBatch(Batch);
+	}
+	else
+	{
+		NewProxies.Reserve(NumMeshes);
+		for (int32 Index = 0; Index < NumMeshes; Index++)
+		{
+			NewProxies.Add(NewObject<UPlayMontageProCallbackProxy>());
+		}
+	}
+
+	Batch->Proxies.SetNum(NumMeshes);
+	Batch->Results.SetNum(NumMeshes);
+	Batch->NumPending = NumMeshes;
+	Batch->bStarting = true;
+	{
+		// Every montage's first notify is added to the scheduler in one go
+		FPlayMontageProScopedScheduleBatch ScheduleBatch(Scheduler);
+		for (int32 Index = 0; Index < NumMeshes; Index++)
+		{
+			UPlayMontageProCallbackProxy* Proxy = NewProxies[Index];
+			Proxy->SetFlags(RF_StrongRefOnFrame);
+			Proxy->OnEndedNative.AddUObject(Batch, &ThisClass::OnProxyEnded, Index);
+			Batch->Proxies[Index] = Proxy;
+			Batch->Results[Index].Mesh = InSkeletalMeshComponents[Index];
+
+			Proxy->PlayMontagePro(InSkeletalMeshComponents[Index], MontageToPlay, PlayRate, StartingPosition, StartingSection,
+				bTriggerNotifiesBeforeStartTime, bEnableCustomTimeDilation, bShouldStopAllMontages, DispatchMode);
+
+			// Without a mesh the proxy can't find its world's pool, so it is returned to the one it came from
+			if (!InSkeletalMeshComponents[Index] && Scheduler)
+			{
+				Scheduler->ReleaseProxy(Proxy);
+			}
+		}
+	}
+	Batch->bStarting = false;
+
+	// Nothing played, or every montage already ended
+	// Deferred to the next tick, nothing could have bound to OnAllEnded before the factory returns
+	if (Batch->NumPending == 0)
+	{
+		if (UWorld* World = Scheduler ? Scheduler->GetWorld() : nullptr)
+		{
+			World->GetTimerManager().SetTimerForNextTick(FTimerDelegate::CreateUObject(Batch, &ThisClass::Finish));
+		}
+		else
+		{
+			FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateWeakLambda(Batch, [Batch](float)
+			{
+				Batch->Finish();
+				return false;
+			}));
+		}
+	}
+
+	return Batch;
+}
+
+TArray<UPlayMontageProCallbackProxy*> UPlayMontageProBatchCallbackProxy::GetProxies() const
+{
+	TArray<UPlayMontageProCallbackProxy*> Result;
+	Result.Reserve(Proxies.Num());
+	for (UPlayMontageProCallbackProxy* Proxy : Proxies)
+	{
+		Result.Add(Proxy);
+	}
+	return Result;
+}
+
+void UPlayMontageProBatchCallbackProxy::OnProxyEnded(UPlayMontageProCallbackProxy* Proxy, EPlayMontageProResult Result, int32 Index)
+{
+	if (!Results.IsValidIndex(Index))
+	{
+		return;
+	}
+
+	// The proxy returns to the pool and may be reused by anything else
+	Results[Index].Result = Result;
+	Proxies[Index] = nullptr;
+
+	if (--NumPending == 0 && !bStarting)
+	{
+		Finish();
+	}
+}
+
+void UPlayMontageProBatchCallbackProxy::Finish()
+{
+	OnAllEnded.Broadcast(Results);
+
+	if (UPlayMontageProSubsystem* Scheduler = Subsystem.Get())
+	{
+		Scheduler->UnregisterBatch(this);
+	}
+}
@@ -2,12 +2,39 @@
 
 #include "PlayMontageProCallbackProxy.h"
 
+#include "PlayMontageProAnimInstance.h"
+#include "PlayMontageProReplicationComponent.h"
 #include "PlayMontageProStatics.h"
+#include "PlayMontageProStats.h"
+#include "PlayMontageProSubsystem.h"
 #include "Animation/AnimMontage.h"
 #include "Components/SkeletalMeshComponent.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(PlayMontageProCallbackProxy)
 
+namespace PlayMontagePro
+{
+	/** @return Driver montage position per driven montage position */
+	static float GetDrivenPositionScale(const UAnimMontage* DriverMontage, const FPlayMontageProDrivenMontage& Driven)
+	{
+		// Montages play at their rate scale on top of the play rate, so the positions advance at the ratio of their rate scales
+		const float DriverLength = DriverMontage->GetPlayLength();
+		const float DrivenLength = Driven.Montage->GetPlayLength();
+		if (Driven.bMatchDriverDuration && DriverLength > 0.f && DrivenLength > 0.f)
+		{
+			return DriverLength / DrivenLength;
+		}
+		return Driven.Montage->RateScale != 0.f ? DriverMontage->RateScale / Driven.Montage->RateScale : 1.f;
+	}
+
+	/** @return Play rate of the driven montage that keeps it at the driver position, PositionScale is from GetDrivenPositionScale */
+	static float GetDrivenPlayRate(const UAnimMontage* DriverMontage, const FPlayMontageProDrivenMontage& Driven, float PlayRate, float PositionScale)
+	{
+		const float DrivenRateScale = Driven.Montage->RateScale * PositionScale;
+		return DrivenRateScale != 0.f ? PlayRate * DriverMontage->RateScale / DrivenRateScale : PlayRate;
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 // UPlayMontageProCallbackProxy
 
@@ -26,12 +53,50 @@ UPlayMontageProCallbackProxy* UPlayMontageProCallbackProxy::CreateProxyObjectFor
 	FName StartingSection,
 	bool bTriggerNotifiesBeforeStartTime,
 	bool bEnableCustomTimeDilation,
-	bool bShouldStopAllMontages)
+	bool bShouldStopAllMontages,
+	EAnimNotifyProDispatchMode DispatchMode)
 {
-	UPlayMontageProCallbackProxy* Proxy = NewObject<UPlayMontageProCallbackProxy>();
+	// Reuse a finished proxy if possible
+	UPlayMontageProSubsystem* Subsystem = InSkeletalMeshComponent ? UPlayMontageProSubsystem::Get(InSkeletalMeshComponent->GetWorld()) : nullptr;
+	UPlayMontageProCallbackProxy* Proxy = Subsystem ? Subsystem->AcquireProxy() : NewObject<UPlayMontageProCallbackProxy>();
 	Proxy->SetFlags(RF_StrongRefOnFrame);
 	Proxy->PlayMontagePro(InSkeletalMeshComponent, MontageToPlay, PlayRate, StartingPosition, StartingSection,
-		bTriggerNotifiesBeforeStartTime, bEnableCustomTimeDilation, bShouldStopAllMontages);
+		bTriggerNotifiesBeforeStartTime, bEnableCustomTimeDilation, bShouldStopAllMontages, DispatchMode);
+	return Proxy;
+}
+
+UPlayMontageProCallbackProxy* UPlayMontageProCallbackProxy::CreateProxyObjectForPlayMontageProDriven(
+	USkeletalMeshComponent* InSkeletalMeshComponent,
+	UAnimMontage* MontageToPlay,
+	const TArray<FPlayMontageProDrivenMontage>& InDrivenMontages,
+	EPlayMontageProDrivenNotifyPolicy InDrivenNotifyPolicy,
+	float PlayRate,
+	float StartingPosition,
+	FName StartingSection,
+	bool bTriggerNotifiesBeforeStartTime,
+	bool bEnableCustomTimeDilation,
+	bool bShouldStopAllMontages,
+	EAnimNotifyProDispatchMode DispatchMode)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProCallbackProxy::CreateProxyObjectForPlayMontageProDriven);
+
+	UPlayMontageProSubsystem* Subsystem = InSkeletalMeshComponent ? UPlayMontageProSubsystem::Get(InSkeletalMeshComponent->GetWorld()) : nullptr;
+	UPlayMontageProCallbackProxy* Proxy = Subsystem ? Subsystem->AcquireProxy() : NewObject<UPlayMontageProCallbackProxy>();
+	Proxy->SetFlags(RF_StrongRefOnFrame);
+
+	// Merged notifies refer to the driven montages by index, so only keep the ones that can play
+	Proxy->DrivenMontages.Reset(InDrivenMontages.Num());
+	for (const FPlayMontageProDrivenMontage& Driven : InDrivenMontages)
+	{
+		if (Driven.Mesh && Driven.Montage)
+		{
+			Proxy->DrivenMontages.Add(Driven);
+		}
+	}
+	Proxy->DrivenNotifyPolicy = InDrivenNotifyPolicy;
+
+	Proxy->PlayMontagePro(InSkeletalMeshComponent, MontageToPlay, PlayRate, StartingPosition, StartingSection,
+		bTriggerNotifiesBeforeStartTime, bEnableCustomTimeDilation, bShouldStopAllMontages, DispatchMode);
 	return Proxy;
 }
 
@@ -42,10 +107,13 @@ bool UPlayMontageProCallbackProxy::PlayMontagePro(USkeletalMeshComponent* InSkel
 	FName StartingSection,
 	bool bTriggerNotifiesBeforeStartTime,
 	bool bEnableCustomTimeDilation,
-	bool bShouldStopAllMontages)
+	bool bShouldStopAllMontages,
+	EAnimNotifyProDispatchMode InDispatchMode)
 {
 	MeshComp = InSkeletalMeshComponent;
 	Montage = MontageToPlay;
+	NotifyDispatchMode = InDispatchMode;
+	MontagePlayRate = PlayRate;
 	
 	bool bPlayedSuccessfully = false;
 	if (InSkeletalMeshComponent)
@@ -57,6 +125,8 @@ bool UPlayMontageProCallbackProxy::PlayMontagePro(USkeletalMeshComponent* InSkel
 
 			if (bPlayedSuccessfully)
 			{
+				INC_DWORD_STAT(STAT_PlayMontageProActiveProxies);
+
 				// -- Engine default handling --
 				
 				AnimInstancePtr = AnimInstance;
@@ -74,6 +144,8 @@ bool UPlayMontageProCallbackProxy::PlayMontagePro(USkeletalMeshComponent* InSkel
 					StartingPosition += (NewPosition - StartingPosition);
 				}
 
+				PlayDrivenMontages(MontageToPlay, PlayRate, StartingPosition, bShouldStopAllMontages);
+
 				BlendingOutDelegate.BindUObject(this, &ThisClass::OnMontageBlendingOut);
 				AnimInstance->Montage_SetBlendingOutDelegate(BlendingOutDelegate, MontageToPlay);
 
@@ -82,36 +154,77 @@ bool UPlayMontageProCallbackProxy::PlayMontagePro(USkeletalMeshComponent* InSkel
 
 				// -- PlayMontagePro --
 				
-				// Use the mesh comp's OnTickPose to detect time dilation changes
-				if (bEnableCustomTimeDilation)
-				{
-					TimeDilation = MeshComp->GetOwner()->CustomTimeDilation;
-					TickPoseHandle = MeshComp->OnTickPose.AddUObject(this, &ThisClass::OnTickPose);
-				}
-				else
-				{
-					TimeDilation = 1.f;
-				}
+				// Montage position dispatch follows the montage, which already accounts for time dilation
+				// Fixed step converts the time dilation at the start to ticks, the owner's tick decides everything after that
+				bFollowTimeDilation = bEnableCustomTimeDilation && NotifyDispatchMode == EAnimNotifyProDispatchMode::Timer;
+				const bool bUseTimeDilation = bFollowTimeDilation || (bEnableCustomTimeDilation && NotifyDispatchMode == EAnimNotifyProDispatchMode::FixedStep);
+				TimeDilation = bUseTimeDilation ? MeshComp->GetOwner()->CustomTimeDilation : 1.f;
 
 				// Handle section changes
 				AnimInstance->OnMontageSectionChanged.AddDynamic(this, &ThisClass::OnMontageSectionChanged);
 
 				// Gather notifies from montage
 				const FName Section = AnimInstance->Montage_GetCurrentSection(MontageToPlay);
-				UPlayMontageProStatics::GatherNotifies(MontageToPlay, NotifyId, Notifies, Section, StartingPosition, TimeDilation);
+				SectionIndex = MontageToPlay->GetSectionIndex(Section);
+				UPlayMontageProStatics::GatherNotifies(GetNotifyTable(MontageToPlay), MontageToPlay, NotifyId, Notifies, Section, StartingPosition, TimeDilation, MontagePlayRate);
+				UPlayMontageProStatics::SkipInsignificantNotifies(Notifies, this);
 
 				// Trigger notifies before start time and remove them, if we want to trigger them before the start time
 				UPlayMontageProStatics::HandleHistoricNotifies(Notifies, bTriggerNotifiesBeforeStartTime, this);
 
-				// Create timer delegates for notifies
-				UPlayMontageProStatics::SetupNotifyTimers(this, MeshComp->GetWorld(), Notifies);
+				// Let simulated proxies run the same notifies, they gather from the montage alone so merged notifies can't be replicated
+				if (Notifies.MontageTable->DrivenMontages.Num() == 0)
+				{
+					ReplicationComponent = UPlayMontageProReplicationComponent::FindForReplication(MeshComp.Get());
+				}
+				if (ReplicationComponent.IsValid())
+				{
+					ReplicationComponent->ReplicateMontage(MeshComp.Get(), MontageToPlay, SectionIndex, StartingPosition,
+						MontagePlayRate, TimeDilation, Notifies);
+				}
+
+				if (NotifyDispatchMode == EAnimNotifyProDispatchMode::MontagePosition)
+				{
+					// Follow the montage position, starting after the notifies handled as historic
+					UPlayMontageProStatics::SeekNotifyCursor(Notifies, NotifyCursor, StartingPosition);
+					LastMontagePosition = StartingPosition;
+					if (UPlayMontageProAnimInstance* ProAnimInstance = Cast<UPlayMontageProAnimInstance>(AnimInstance))
+					{
+						// Checked as part of the animation update, only ticked when a notify was crossed
+						ProAnimInstance->RegisterMontagePositionDispatch(this, MontageToPlay, StartingPosition);
+					}
+					else if (UPlayMontageProSubsystem* Scheduler = UPlayMontageProSubsystem::Get(MeshComp->GetWorld()))
+					{
+						Scheduler->RegisterMontagePositionDispatch(this);
+					}
+				}
+				else if (NotifyDispatchMode == EAnimNotifyProDispatchMode::FixedStep)
+				{
+					// Nothing triggers until the owner advances the clock
+					UPlayMontageProStatics::SetupFixedStepNotifies(Notifies);
+				}
+				else
+				{
+					// Schedule notifies
+					UPlayMontageProStatics::SetupNotifyTimers(this, MeshComp->GetWorld(), Notifies);
+					if (bFollowTimeDilation)
+					{
+						if (UPlayMontageProSubsystem* Scheduler = UPlayMontageProSubsystem::Get(MeshComp->GetWorld()))
+						{
+							Scheduler->RegisterTimeDilation(this, MeshComp->GetOwner(), TimeDilation);
+						}
+					}
+				}
 			}
 		}
 	}
 
 	if (!bPlayedSuccessfully)
 	{
+		bFinished = true;
 		OnInterrupted.Broadcast(NAME_None);
+		OnEndedNative.Broadcast(this, EPlayMontageProResult::FailedToPlay);
+		ReleaseToPool();
 	}
 
 	return bPlayedSuccessfully;
@@ -126,33 +239,81 @@ void UPlayMontageProCallbackProxy::OnMontageBlendingOut(UAnimMontage* InMontage,
 {
 	if (bInterrupted)
 	{
-		OnInterrupted.Broadcast(NAME_None);
 		bInterruptedCalledBeforeBlendingOut = true;
-		UPlayMontageProStatics::EnsureBroadcastNotifyEvents(EAnimNotifyProEventType::OnInterrupted, Notifies, this);
+		StopDrivenMontages();
+		OnInterrupted.Broadcast(NAME_None);
+		EnsureBroadcastNotifyEvents(EAnimNotifyProEventType::OnInterrupted, false);
 	}
 	else
 	{
 		OnBlendOut.Broadcast(NAME_None);
-		UPlayMontageProStatics::EnsureBroadcastNotifyEvents(EAnimNotifyProEventType::BlendOut, Notifies, this);
+		EnsureBroadcastNotifyEvents(EAnimNotifyProEventType::BlendOut, false);
 	}
 	bFinished = true;
 }
 
 void UPlayMontageProCallbackProxy::OnMontageEnded(UAnimMontage* InMontage, bool bInterrupted)
 {
+	EAnimNotifyProEventType EventType = EAnimNotifyProEventType::None;
 	if (!bInterrupted)
 	{
-		OnCompleted.Broadcast(NAME_None);
-		UPlayMontageProStatics::EnsureBroadcastNotifyEvents(EAnimNotifyProEventType::OnCompleted, Notifies, this);
+		EventType = EAnimNotifyProEventType::OnCompleted;
 	}
 	else if (!bInterruptedCalledBeforeBlendingOut)
 	{
-		OnInterrupted.Broadcast(NAME_None);
-		UPlayMontageProStatics::EnsureBroadcastNotifyEvents(EAnimNotifyProEventType::OnInterrupted, Notifies, this);
+		EventType = EAnimNotifyProEventType::OnInterrupted;
+		StopDrivenMontages();
 	}
 	
 	UPlayMontageProStatics::ClearNotifyTimers(MeshComp->GetWorld(), Notifies);
+	if (UPlayMontageProSubsystem* Scheduler = UPlayMontageProSubsystem::Get(MeshComp->GetWorld()))
+	{
+		if (NotifyDispatchMode == EAnimNotifyProDispatchMode::MontagePosition)
+		{
+			if (UPlayMontageProAnimInstance* ProAnimInstance = Cast<UPlayMontageProAnimInstance>(AnimInstancePtr.Get()))
+			{
+				ProAnimInstance->UnregisterMontagePositionDispatch(this);
+			}
+			Scheduler->UnregisterMontagePositionDispatch(this);
+		}
+		if (bFollowTimeDilation)
+		{
+			Scheduler->UnregisterTimeDilation(this);
+		}
+	}
 	bFinished = true;
+	DEC_DWORD_STAT(STAT_PlayMontageProActiveProxies);
+
+	if (EventType == EAnimNotifyProEventType::OnCompleted)
+	{
+		OnCompleted.Broadcast(NAME_None);
+	}
+	else if (EventType == EAnimNotifyProEventType::OnInterrupted)
+	{
+		OnInterrupted.Broadcast(NAME_None);
+	}
+	OnEndedNative.Broadcast(this, bInterrupted ? EPlayMontageProResult::Interrupted : EPlayMontageProResult::Completed);
+
+	EnsureBroadcastNotifyEvents(EventType, true);
+}
+
+void UPlayMontageProCallbackProxy::EnsureBroadcastNotifyEvents(EAnimNotifyProEventType EventType, bool bEnded)
+{
+	if (ReplicationComponent.IsValid())
+	{
+		ReplicationComponent->ReplicateTermination(Montage.Get(), EventType, bEnded);
+	}
+
+	// Batched with every montage that terminated this frame, timers keep running while blending out
+	// Once ended, nothing else will be broadcast and the proxy can be reused after its notifies
+	if (UPlayMontageProSubsystem* Scheduler = MeshComp.IsValid() ? UPlayMontageProSubsystem::Get(MeshComp->GetWorld()) : nullptr)
+	{
+		Scheduler->QueueTermination(this, EventType, bEnded && CanReturnToPool() ? this : nullptr);
+	}
+	else if (EventType != EAnimNotifyProEventType::None)
+	{
+		UPlayMontageProStatics::EnsureBroadcastNotifyEvents(EventType, Notifies, this);
+	}
 }
 
 void UPlayMontageProCallbackProxy::OnMontageSectionChanged(UAnimMontage* InMontage, FName SectionName, bool bLooped)
@@ -164,28 +325,308 @@ void UPlayMontageProCallbackProxy::OnMontageSectionChanged(UAnimMontage* InMonta
 
 	const float StartTime = AnimInstancePtr->Montage_GetPosition(InMontage);
 
-	// End previous notify timers
+	if (NotifyDispatchMode == EAnimNotifyProDispatchMode::MontagePosition)
+	{
+		const int32 NewSectionIndex = InMontage->GetSectionIndex(SectionName);
+
+		// The montage has already moved into the new section, if it got there by reaching the end of the previous
+		// section then broadcast the notifies that were crossed since the last dispatch
+		const FAnimMontageInstance* MontageInstance = AnimInstancePtr->GetMontageInstanceForID(MontageInstanceID);
+		const bool bReachedSectionEnd = bLooped || (MontageInstance && MontageInstance->GetNextSectionID(SectionIndex) == NewSectionIndex);
+		if (bReachedSectionEnd && InMontage->IsValidSectionIndex(SectionIndex))
+		{
+			float SectionStartTime, SectionEndTime;
+			InMontage->GetSectionStartAndEndTime(SectionIndex, SectionStartTime, SectionEndTime);
+			const float PreviousPosition = LastMontagePosition;
+			LastMontagePosition = SectionEndTime - UE_KINDA_SMALL_NUMBER;
+			UPlayMontageProStatics::HandleMontagePositionNotifies(this, Notifies, NotifyCursor,
+				PreviousPosition, LastMontagePosition);
+
+			// A notify may have ended the montage
+			if (bFinished)
+			{
+				return;
+			}
+		}
+	}
+
+	// End previous notify timers, keeping the time dilation the clock was running at
+	TimeDilation = Notifies.Clock.TimeDilation;
 	UPlayMontageProStatics::ClearNotifyTimers(MeshComp->GetWorld(), Notifies);
 
-	// Gather notifies from montage
-	UPlayMontageProStatics::GatherNotifies(InMontage, NotifyId, Notifies, SectionName, StartTime, TimeDilation);
+	// Pick up any play rate change since the notifies were last gathered
+	if (const FAnimMontageInstance* MontageInstance = AnimInstancePtr->GetMontageInstanceForID(MontageInstanceID))
+	{
+		MontagePlayRate = MontageInstance->GetPlayRate();
+	}
+	SyncDrivenMontages(StartTime, MontagePlayRate);
+
+	// Switch to the new section's notifies, only re-arming them if the section looped
+	SectionIndex = UPlayMontageProStatics::GatherSectionNotifies(InMontage, NotifyId, Notifies, StartTime, TimeDilation, MontagePlayRate);
+	UPlayMontageProStatics::SkipInsignificantNotifies(Notifies, this);
+	if (ReplicationComponent.IsValid())
+	{
+		ReplicationComponent->ReplicateMontage(MeshComp.Get(), InMontage, SectionIndex, StartTime, MontagePlayRate, TimeDilation, Notifies);
+	}
 
-	// Create timer delegates for notifies
-	UPlayMontageProStatics::SetupNotifyTimers(this, MeshComp->GetWorld(), Notifies);
+	if (NotifyDispatchMode == EAnimNotifyProDispatchMode::MontagePosition)
+	{
+		// Continue following the montage from the start of the new section
+		UPlayMontageProStatics::SeekNotifyCursor(Notifies, NotifyCursor, StartTime);
+		LastMontagePosition = StartTime;
+	}
+	else if (NotifyDispatchMode == EAnimNotifyProDispatchMode::FixedStep)
+	{
+		// The clock restarts from the start of the new section
+		UPlayMontageProStatics::SetupFixedStepNotifies(Notifies);
+	}
+	else
+	{
+		// Schedule notifies
+		UPlayMontageProStatics::SetupNotifyTimers(this, MeshComp->GetWorld(), Notifies);
+	}
 }
 
-void UPlayMontageProCallbackProxy::OnTickPose(USkinnedMeshComponent* SkinnedMeshComponent, float DeltaTime,
-	bool NeedsValidRootMotion)
+void UPlayMontageProCallbackProxy::NotifyCallback(const FAnimNotifyProEvent& Event)
 {
-	UPlayMontageProStatics::HandleTimeDilation(this, SkinnedMeshComponent, TimeDilation, Notifies);
+	// Broadcasting a dynamic delegate copies the event into its parameters even if nothing is bound
+	OnNotifyNative.Broadcast(Event);
+	if (OnNotify.IsBound())
+	{
+		OnNotify.Broadcast(Event);
+	}
 }
 
-void UPlayMontageProCallbackProxy::BeginDestroy()
+void UPlayMontageProCallbackProxy::NotifyBeginCallback(const FAnimNotifyProEvent& Event)
 {
-	if (MeshComp.IsValid() && TickPoseHandle.IsValid() && MeshComp->OnTickPose.IsBoundToObject(this))
+	OnNotifyStateBeginNative.Broadcast(Event);
+	if (OnNotifyStateBegin.IsBound())
 	{
-		MeshComp->OnTickPose.Remove(TickPoseHandle);
+		OnNotifyStateBegin.Broadcast(Event);
+	}
+}
+
+void UPlayMontageProCallbackProxy::NotifyEndCallback(const FAnimNotifyProEvent& Event)
+{
+	OnNotifyStateEndNative.Broadcast(Event);
+	if (OnNotifyStateEnd.IsBound())
+	{
+		OnNotifyStateEnd.Broadcast(Event);
+	}
+}
+
+TSharedRef<const FAnimNotifyProMontageTable> UPlayMontageProCallbackProxy::GetNotifyTable(const UAnimMontage* MontageToPlay) const
+{
+	if (DrivenNotifyPolicy != EPlayMontageProDrivenNotifyPolicy::Merge || DrivenMontages.Num() == 0)
+	{
+		return FAnimNotifyProTableCache::Get(MontageToPlay);
+	}
+
+	// Cached per combination of driver and driven montages, so only the first play pays for the merge
+	TArray<FAnimNotifyProDrivenSource, TInlineAllocator<4>> DrivenSources;
+	for (int32 DrivenIndex = 0; DrivenIndex < DrivenMontages.Num(); DrivenIndex++)
+	{
+		DrivenSources.Add({ DrivenMontages[DrivenIndex].Montage, DrivenPositionScales[DrivenIndex] });
+	}
+	return FAnimNotifyProTableCache::GetMerged(MontageToPlay, DrivenSources);
+}
+
+void UPlayMontageProCallbackProxy::PlayDrivenMontages(const UAnimMontage* MontageToPlay, float PlayRate, float DriverPosition,
+	bool bShouldStopAllMontages)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProCallbackProxy::PlayDrivenMontages);
+
+	DrivenPositionScales.Reset(DrivenMontages.Num());
+	for (const FPlayMontageProDrivenMontage& Driven : DrivenMontages)
+	{
+		const float PositionScale = PlayMontagePro::GetDrivenPositionScale(MontageToPlay, Driven);
+		DrivenPositionScales.Add(PositionScale);
+
+		// Driven montages never gather notifies of their own, the driver's schedule is the only one
+		if (UAnimInstance* DrivenAnimInstance = Driven.Mesh->GetAnimInstance())
+		{
+			const float DrivenPlayRate = PlayMontagePro::GetDrivenPlayRate(MontageToPlay, Driven, PlayRate, PositionScale);
+			DrivenAnimInstance->Montage_Play(Driven.Montage, DrivenPlayRate, EMontagePlayReturnType::MontageLength,
+				DriverPosition / PositionScale, bShouldStopAllMontages);
+		}
+	}
+}
+
+void UPlayMontageProCallbackProxy::SyncDrivenMontages(float DriverPosition, float PlayRate)
+{
+	for (int32 DrivenIndex = 0; DrivenIndex < DrivenMontages.Num(); DrivenIndex++)
+	{
+		const FPlayMontageProDrivenMontage& Driven = DrivenMontages[DrivenIndex];
+		UAnimInstance* DrivenAnimInstance = Driven.Mesh ? Driven.Mesh->GetAnimInstance() : nullptr;
+		if (DrivenAnimInstance && DrivenAnimInstance->Montage_IsPlaying(Driven.Montage))
+		{
+			const float PositionScale = DrivenPositionScales[DrivenIndex];
+			DrivenAnimInstance->Montage_SetPosition(Driven.Montage, DriverPosition / PositionScale);
+			DrivenAnimInstance->Montage_SetPlayRate(Driven.Montage, PlayMontagePro::GetDrivenPlayRate(Montage.Get(), Driven, PlayRate, PositionScale));
+		}
+	}
+}
+
+void UPlayMontageProCallbackProxy::StopDrivenMontages()
+{
+	for (const FPlayMontageProDrivenMontage& Driven : DrivenMontages)
+	{
+		UAnimInstance* DrivenAnimInstance = Driven.Mesh ? Driven.Mesh->GetAnimInstance() : nullptr;
+		if (DrivenAnimInstance && DrivenAnimInstance->Montage_IsPlaying(Driven.Montage))
+		{
+			DrivenAnimInstance->Montage_Stop(Driven.Montage->BlendOut.GetBlendTime(), Driven.Montage);
+		}
+	}
+}
+
+void UPlayMontageProCallbackProxy::GetDrivenSource(int32 DrivenIndex, USkeletalMeshComponent*& OutMesh, UAnimMontage*& OutMontage) const
+{
+	if (DrivenMontages.IsValidIndex(DrivenIndex))
+	{
+		OutMesh = DrivenMontages[DrivenIndex].Mesh;
+		OutMontage = DrivenMontages[DrivenIndex].Montage;
+	}
+}
+
+bool UPlayMontageProCallbackProxy::WantsNotifyEvents() const
+{
+	return OnNotifyNative.IsBound() || OnNotifyStateBeginNative.IsBound() || OnNotifyStateEndNative.IsBound()
+		|| OnNotify.IsBound() || OnNotifyStateBegin.IsBound() || OnNotifyStateEnd.IsBound();
+}
+
+void UPlayMontageProCallbackProxy::BroadcastNotifyEvent(int32 NotifyIndex)
+{
+	UPlayMontageProStatics::BroadcastNotifyEvent(Notifies, NotifyIndex, this);
+
+	// Broadcasting an end state may also have broadcast its begin state
+	if (ReplicationComponent.IsValid())
+	{
+		ReplicationComponent->ReplicateBroadcast(Montage.Get(), Notifies);
+	}
+}
+
+void UPlayMontageProCallbackProxy::SetFixedStepTickRate(int32 TickRate)
+{
+	FAnimNotifyProFixedStepClock& FixedStep = Notifies.FixedStep;
+	if (TickRate <= 0 || TickRate == FixedStep.TickRate)
+	{
+		return;
+	}
+
+	// Convert the events again and carry the elapsed time over to the new rate
+	const int32 CurrentTick = FMath::FloorToInt32(static_cast<double>(FixedStep.CurrentTick) * TickRate / FixedStep.TickRate);
+	FixedStep.TickRate = TickRate;
+	if (!bFinished && NotifyDispatchMode == EAnimNotifyProDispatchMode::FixedStep)
+	{
+		UPlayMontageProStatics::SetupFixedStepNotifies(Notifies);
+		UPlayMontageProStatics::RewindFixedStepNotifies(Notifies, CurrentTick);
+	}
+}
+
+void UPlayMontageProCallbackProxy::AdvanceFixedStep(int32 NumTicks)
+{
+	if (!bFinished && NotifyDispatchMode == EAnimNotifyProDispatchMode::FixedStep)
+	{
+		UPlayMontageProStatics::AdvanceFixedStepNotifies(this, Notifies, NumTicks);
+	}
+}
+
+void UPlayMontageProCallbackProxy::RewindFixedStep(int32 Tick)
+{
+	if (!bFinished && NotifyDispatchMode == EAnimNotifyProDispatchMode::FixedStep)
+	{
+		UPlayMontageProStatics::RewindFixedStepNotifies(Notifies, Tick);
+	}
+}
+
+void UPlayMontageProCallbackProxy::ResimulateFixedStep(int32 FromTick, int32 ToTick)
+{
+	RewindFixedStep(FromTick);
+	AdvanceFixedStep(ToTick - FromTick);
+}
+
+void UPlayMontageProCallbackProxy::TickMontagePosition()
+{
+	if (bFinished || !AnimInstancePtr.IsValid())
+	{
+		return;
+	}
+
+	if (const FAnimMontageInstance* MontageInstance = AnimInstancePtr->GetMontageInstanceForID(MontageInstanceID))
+	{
+		// Update the last position first, a notify may change section which restarts from the new section
+		const float PreviousPosition = LastMontagePosition;
+		LastMontagePosition = MontageInstance->GetPosition();
+		UPlayMontageProStatics::HandleMontagePositionNotifies(this, Notifies, NotifyCursor,
+			PreviousPosition, LastMontagePosition);
+	}
+}
+
+bool UPlayMontageProCallbackProxy::IsSignificant() const
+{
+	const UPlayMontageProSubsystem* Subsystem = MeshComp.IsValid() ? UPlayMontageProSubsystem::Get(MeshComp->GetWorld()) : nullptr;
+	return !Subsystem || Subsystem->IsSignificant(MeshComp.Get());
+}
+
+void UPlayMontageProCallbackProxy::ResetProxy()
+{
+	// Unbind everything that was bound for the previous montage
+	OnCompleted.Clear();
+	OnBlendOut.Clear();
+	OnInterrupted.Clear();
+	OnNotify.Clear();
+	OnNotifyStateBegin.Clear();
+	OnNotifyStateEnd.Clear();
+	OnEndedNative.Clear();
+	OnNotifyNative.Clear();
+	OnNotifyStateBeginNative.Clear();
+	OnNotifyStateEndNative.Clear();
+
+	if (AnimInstancePtr.IsValid())
+	{
+		AnimInstancePtr->OnMontageSectionChanged.RemoveDynamic(this, &ThisClass::OnMontageSectionChanged);
+	}
+
+	BlendingOutDelegate.Unbind();
+	MontageEndedDelegate.Unbind();
+
+	// States that never ended stop ticking, so the next montage on the same mesh can't inherit them
+	if (UPlayMontageProSubsystem* Subsystem = MeshComp.IsValid() ? UPlayMontageProSubsystem::Get(MeshComp->GetWorld()) : nullptr)
+	{
+		Subsystem->UnregisterNotifyStateTicks(Notifies);
+	}
+
+	// Keep the allocation for the next montage
+	Notifies.Reset();
+
+	Montage.Reset();
+	MeshComp.Reset();
+	AnimInstancePtr.Reset();
+	MontageInstanceID = INDEX_NONE;
+	bInterruptedCalledBeforeBlendingOut = false;
+	bFinished = false;
+	bFollowTimeDilation = false;
+	TimeDilation = 1.f;
+	MontagePlayRate = 1.f;
+	NotifyDispatchMode = EAnimNotifyProDispatchMode::Timer;
+	NotifyCursor = 0;
+	LastMontagePosition = 0.f;
+	SectionIndex = INDEX_NONE;
+	ReplicationComponent.Reset();
+	DrivenMontages.Reset();
+	DrivenPositionScales.Reset();
+	DrivenNotifyPolicy = EPlayMontageProDrivenNotifyPolicy::Suppress;
+}
+
+void UPlayMontageProCallbackProxy::ReleaseToPool()
+{
+	if (!CanReturnToPool())
+	{
+		return;
+	}
+
+	if (UPlayMontageProSubsystem* Subsystem = MeshComp.IsValid() ? UPlayMontageProSubsystem::Get(MeshComp->GetWorld()) : nullptr)
+	{
+		Subsystem->ReleaseProxy(this);
 	}
-	
-	Super::BeginDestroy();
 }
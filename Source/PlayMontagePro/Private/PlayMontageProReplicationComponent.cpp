@@ -0,0 +1,374 @@
+// Copyright (c) Jared Taylor
+
+#include "PlayMontageProReplicationComponent.h"
+
+#include "AnimNotifyPro.h"
+#include "AnimNotifyStatePro.h"
+#include "PlayMontageProStatics.h"
+#include "PlayMontageProStats.h"
+#include "PlayMontageProSubsystem.h"
+#include "Animation/AnimMontage.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/GameStateBase.h"
+#include "Net/UnrealNetwork.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(PlayMontageProReplicationComponent)
+
+namespace PlayMontagePro
+{
+	/** Set in FPlayMontageProRepState::EndReasons once the montage has ended, after any EAnimNotifyProEventType bits */
+	static constexpr uint8 MontageEndedFlag = 1 << 7;
+
+	/** @return Whether the notify at Index triggers on simulated proxies from the replicated state */
+	static bool IsReplicatedNotify(const FAnimNotifyProSectionTable& Table, int32 Index)
+	{
+		if (const UAnimNotifyPro* Notify = Table.Notifies[Index].Get())
+		{
+			return Notify->SimulatedProxyBehavior == EAnimNotifyLegacyType::Replicated;
+		}
+		if (const UAnimNotifyStatePro* NotifyState = Table.NotifyStates[Index].Get())
+		{
+			return NotifyState->SimulatedProxyBehavior == EAnimNotifyLegacyType::Replicated;
+		}
+		return false;
+	}
+
+	/** Approximate size of FPlayMontageProRepState without FiredWords, object references are sent as 32 bit net GUIDs */
+	static constexpr int32 RepStateHeaderBytes = 2 * sizeof(uint32) + sizeof(uint8) + sizeof(int16) + sizeof(float) + sizeof(double)
+		+ 2 * sizeof(float) + sizeof(uint8);
+
+	/** Counts bytes of replicated state changed on the server, before property replication's own overhead */
+	static void RecordReplicatedBytes(int32 NumBytes)
+	{
+		INC_DWORD_STAT_BY(STAT_PlayMontageProReplicatedBytes, NumBytes);
+		CSV_CUSTOM_STAT(PlayMontagePro, ReplicatedBytes, NumBytes, ECsvCustomStatOp::Accumulate);
+	}
+
+	/**
+	 * Copies the broadcast state of the notifies into FiredWords.
+	 * @return Number of words that changed.
+	 */
+	static int32 CopyFiredWords(TArray<uint32>& FiredWords, const FAnimNotifyProEvents& Notifies)
+	{
+		const uint32* BroadcastWords = Notifies.HasBroadcast.GetData();
+		const int32 NumWords = FMath::Min(FiredWords.Num(), FMath::DivideAndRoundUp(Notifies.Num(), 32));
+		int32 NumChanged = 0;
+		for (int32 WordIndex = 0; WordIndex < NumWords; WordIndex++)
+		{
+			NumChanged += FiredWords[WordIndex] != BroadcastWords[WordIndex] ? 1 : 0;
+			FiredWords[WordIndex] = BroadcastWords[WordIndex];
+		}
+		return NumChanged;
+	}
+
+	/**
+	 * Moves an estimated position that has passed the end of its section on through the section links, as the montage would have.
+	 * Full passes through looping sections are skipped at once.
+	 * @param SectionIndex The section Position was estimated in, set to the section the position was resolved to.
+	 * @return The position, clamped to the end of the last section if the montage would have ended.
+	 */
+	static float ResolveSectionPosition(const UAnimMontage* Montage, int32& SectionIndex, float Position)
+	{
+		float SectionStart, SectionEnd;
+		Montage->GetSectionStartAndEndTime(SectionIndex, SectionStart, SectionEnd);
+		if (Position < SectionEnd)
+		{
+			return Position;
+		}
+
+		// Sections entered from their start, to detect where the links loop back
+		TArray<int32, TInlineAllocator<8>> Path;
+		bool bLoopResolved = false;
+		float Overflow = Position - SectionEnd;
+		while (true)
+		{
+			const int32 NextSectionIndex = Montage->GetSectionIndex(Montage->CompositeSections[SectionIndex].NextSectionName);
+			if (!Montage->IsValidSectionIndex(NextSectionIndex))
+			{
+				return SectionEnd;
+			}
+
+			const int32 LoopIndex = bLoopResolved ? INDEX_NONE : Path.Find(NextSectionIndex);
+			if (LoopIndex != INDEX_NONE)
+			{
+				float LoopLength = 0.f;
+				for (int32 PathIndex = LoopIndex; PathIndex < Path.Num(); PathIndex++)
+				{
+					LoopLength += Montage->GetSectionLength(Path[PathIndex]);
+				}
+				if (LoopLength <= UE_KINDA_SMALL_NUMBER)
+				{
+					return SectionEnd;
+				}
+				Overflow = FMath::Fmod(Overflow, LoopLength);
+				bLoopResolved = true;
+			}
+
+			SectionIndex = NextSectionIndex;
+			Path.Add(SectionIndex);
+			Montage->GetSectionStartAndEndTime(SectionIndex, SectionStart, SectionEnd);
+			if (SectionStart + Overflow < SectionEnd)
+			{
+				return SectionStart + Overflow;
+			}
+			Overflow -= SectionEnd - SectionStart;
+		}
+	}
+}
+
+UPlayMontageProReplicationComponent::UPlayMontageProReplicationComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+}
+
+UPlayMontageProReplicationComponent* UPlayMontageProReplicationComponent::FindForReplication(const USkeletalMeshComponent* MeshComp)
+{
+	const AActor* Owner = MeshComp ? MeshComp->GetOwner() : nullptr;
+	if (!Owner || !Owner->HasAuthority() || Owner->GetNetMode() == NM_Standalone)
+	{
+		return nullptr;
+	}
+	return Owner->FindComponentByClass<UPlayMontageProReplicationComponent>();
+}
+
+void UPlayMontageProReplicationComponent::ReplicateMontage(USkeletalMeshComponent* InMesh, UAnimMontage* InMontage,
+	int32 SectionIndex, float StartPosition, float PlayRate, float TimeDilation, const FAnimNotifyProEvents& InNotifies)
+{
+	State.Mesh = InMesh;
+	State.Montage = InMontage;
+	State.PlayId++;
+	State.SectionIndex = static_cast<int16>(SectionIndex);
+	State.StartPosition = StartPosition;
+	State.StartServerTime = GetServerWorldTime();
+	State.PlayRate = PlayRate;
+	State.TimeDilation = TimeDilation;
+	State.EndReasons = 0;
+
+	// Every property changes when notifies are gathered
+	State.FiredWords.SetNumZeroed(FMath::DivideAndRoundUp(InNotifies.Num(), 32));
+	PlayMontagePro::CopyFiredWords(State.FiredWords, InNotifies);
+	PlayMontagePro::RecordReplicatedBytes(PlayMontagePro::RepStateHeaderBytes + State.FiredWords.Num() * static_cast<int32>(sizeof(uint32)));
+}
+
+void UPlayMontageProReplicationComponent::ReplicateBroadcast(const UAnimMontage* InMontage, const FAnimNotifyProEvents& InNotifies)
+{
+	if (State.Montage != InMontage || InNotifies.Num() == 0)
+	{
+		return;
+	}
+
+	// Property replication only sends the words that changed since they were last sent
+	const int32 NumChanged = PlayMontagePro::CopyFiredWords(State.FiredWords, InNotifies);
+	PlayMontagePro::RecordReplicatedBytes(NumChanged * static_cast<int32>(sizeof(uint32)));
+}
+
+void UPlayMontageProReplicationComponent::ReplicateTermination(const UAnimMontage* InMontage, EAnimNotifyProEventType EventType, bool bEnded)
+{
+	if (State.Montage == InMontage)
+	{
+		const uint8 EndReasons = State.EndReasons | static_cast<uint8>(EventType) | (bEnded ? PlayMontagePro::MontageEndedFlag : 0);
+		if (EndReasons != State.EndReasons)
+		{
+			State.EndReasons = EndReasons;
+			PlayMontagePro::RecordReplicatedBytes(static_cast<int32>(sizeof(uint8)));
+		}
+	}
+}
+
+bool UPlayMontageProReplicationComponent::IsSignificant() const
+{
+	const UPlayMontageProSubsystem* Subsystem = UPlayMontageProSubsystem::Get(GetWorld());
+	return !Subsystem || Subsystem->IsSignificant(SimulatedMesh.Get());
+}
+
+void UPlayMontageProReplicationComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	// Authority and autonomous proxies run PlayMontagePro themselves
+	DOREPLIFETIME_CONDITION(ThisClass, State, COND_SimulatedOnly);
+}
+
+void UPlayMontageProReplicationComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopSimulation();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UPlayMontageProReplicationComponent::OnRep_State()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProReplicationComponent::OnRep_State);
+	SCOPE_CYCLE_COUNTER(STAT_PlayMontageProReplication);
+
+	if (!State.Montage || !State.Mesh)
+	{
+		StopSimulation();
+		return;
+	}
+
+	if (State.PlayId != SimulatedPlayId || !bReceivedState)
+	{
+		// A different montage started before the previous one's termination was received, it was interrupted by it
+		if (bSimulating && SimulatedMontage.Get() != State.Montage && SimulatedEndReasons == 0)
+		{
+			TerminateSimulation(static_cast<uint8>(EAnimNotifyProEventType::OnInterrupted) | PlayMontagePro::MontageEndedFlag);
+		}
+
+		// A montage that already ended when the actor became relevant is not simulated
+		const bool bInitialState = !bReceivedState;
+		const bool bStale = bInitialState && (State.EndReasons & PlayMontagePro::MontageEndedFlag) != 0;
+		bReceivedState = true;
+		if (bStale)
+		{
+			StopSimulation();
+			SimulatedPlayId = State.PlayId;
+			SimulatedEndReasons = State.EndReasons;
+			return;
+		}
+
+		// Notifies the montage passed before the actor became relevant are skipped, after that they are caught up on
+		StartSimulation(!bInitialState);
+	}
+	else
+	{
+		CatchUpSimulation();
+	}
+
+	TerminateSimulation(State.EndReasons);
+}
+
+void UPlayMontageProReplicationComponent::StartSimulation(bool bTriggerPassedNotifies)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProReplicationComponent::StartSimulation);
+
+	StopSimulation();
+	SimulatedPlayId = State.PlayId;
+	SimulatedEndReasons = 0;
+	SimulatedMontage = State.Montage;
+	SimulatedMesh = State.Mesh;
+
+	// Estimate where the montage is now, the notifies are gathered from there so they are scheduled on the local clock
+	UAnimMontage* MontageToSimulate = State.Montage;
+	const double Elapsed = FMath::Max(0.0, GetServerWorldTime() - State.StartServerTime);
+	float Position = State.StartPosition + static_cast<float>(Elapsed) * State.PlayRate * MontageToSimulate->RateScale * State.TimeDilation;
+
+	// The estimate may have run past the section, e.g. the state arrived late, follow the montage's section links from there
+	int32 SectionIndex = State.SectionIndex;
+	if (MontageToSimulate->IsValidSectionIndex(SectionIndex))
+	{
+		Position = PlayMontagePro::ResolveSectionPosition(MontageToSimulate, SectionIndex, Position);
+	}
+	bEstimateLeftSection = SectionIndex != State.SectionIndex || Position < State.StartPosition;
+
+	const FName Section = MontageToSimulate->IsValidSectionIndex(SectionIndex) ? MontageToSimulate->GetSectionName(SectionIndex) : NAME_None;
+	UPlayMontageProStatics::GatherNotifies(MontageToSimulate, NotifyId, Notifies, Section, Position, State.TimeDilation, State.PlayRate);
+
+	// Only notifies that opted in are triggered here, the others are triggered by the engine or not at all
+	for (int32 NotifyIndex = 0; NotifyIndex < Notifies.Num(); NotifyIndex++)
+	{
+		if (!PlayMontagePro::IsReplicatedNotify(*Notifies.Table, NotifyIndex))
+		{
+			Notifies.Skipped[NotifyIndex] = true;
+		}
+	}
+	UPlayMontageProStatics::SkipInsignificantNotifies(Notifies, this);
+
+	bSimulating = true;
+	const uint32 FirstNotifyId = Notifies.FirstNotifyId;
+	UPlayMontageProStatics::HandleHistoricNotifies(Notifies, bTriggerPassedNotifies, this);
+	if (bSimulating && Notifies.FirstNotifyId == FirstNotifyId)
+	{
+		CatchUpSimulation();
+	}
+	if (bSimulating && Notifies.FirstNotifyId == FirstNotifyId)
+	{
+		UPlayMontageProStatics::SetupNotifyTimers(this, GetWorld(), Notifies);
+	}
+}
+
+void UPlayMontageProReplicationComponent::CatchUpSimulation()
+{
+	// FiredWords describe the pass through the replicated section, not the one the estimate moved on to
+	if (!bSimulating || bEstimateLeftSection || Notifies.Num() == 0)
+	{
+		return;
+	}
+
+	// The server is ahead of the local clock for these, broadcast them now in index order
+	const uint32 FirstNotifyId = Notifies.FirstNotifyId;
+	const int32 NumWords = FMath::Min(State.FiredWords.Num(), FMath::DivideAndRoundUp(Notifies.Num(), 32));
+	for (int32 WordIndex = 0; WordIndex < NumWords; WordIndex++)
+	{
+		uint32 Pending = State.FiredWords[WordIndex] & ~Notifies.HasBroadcast.GetData()[WordIndex] & ~Notifies.Skipped.GetData()[WordIndex];
+		while (Pending != 0)
+		{
+			const int32 NotifyIndex = WordIndex * 32 + FMath::CountTrailingZeros(Pending);
+			Pending &= Pending - 1;
+
+			BroadcastNotifyEvent(NotifyIndex);
+			if (!bSimulating || Notifies.FirstNotifyId != FirstNotifyId)
+			{
+				return;
+			}
+		}
+	}
+}
+
+void UPlayMontageProReplicationComponent::TerminateSimulation(uint8 NewEndReasons)
+{
+	const uint8 PendingReasons = NewEndReasons & ~SimulatedEndReasons;
+	if (!bSimulating || PendingReasons == 0)
+	{
+		return;
+	}
+	SimulatedEndReasons |= PendingReasons;
+
+	// In the order the server terminates in
+	const uint32 FirstNotifyId = Notifies.FirstNotifyId;
+	for (const EAnimNotifyProEventType EventType : { EAnimNotifyProEventType::BlendOut, EAnimNotifyProEventType::OnInterrupted,
+		EAnimNotifyProEventType::OnCompleted, EAnimNotifyProEventType::OnCancelled })
+	{
+		if (PendingReasons & static_cast<uint8>(EventType))
+		{
+			UPlayMontageProStatics::EnsureBroadcastNotifyEvents(EventType, Notifies, this);
+			if (!bSimulating || Notifies.FirstNotifyId != FirstNotifyId)
+			{
+				return;
+			}
+		}
+	}
+
+	// Notifies keep running while the montage blends out
+	if (PendingReasons & PlayMontagePro::MontageEndedFlag)
+	{
+		StopSimulation();
+	}
+}
+
+void UPlayMontageProReplicationComponent::StopSimulation()
+{
+	if (bSimulating)
+	{
+		bSimulating = false;
+		UPlayMontageProStatics::ClearNotifyTimers(GetWorld(), Notifies);
+		if (UPlayMontageProSubsystem* Subsystem = UPlayMontageProSubsystem::Get(GetWorld()))
+		{
+			Subsystem->UnregisterNotifyStateTicks(Notifies);
+		}
+	}
+}
+
+double UPlayMontageProReplicationComponent::GetServerWorldTime() const
+{
+	const UWorld* World = GetWorld();
+	if (!World)
+	{
+		return 0.0;
+	}
+	const AGameStateBase* GameState = World->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : World->GetTimeSeconds();
+}
@@ -4,213 +4,511 @@
 #include "PlayMontageProStatics.h"
 
 #include "AnimNotifyPro.h"
+#include "AnimNotifyProTable.h"
 #include "AnimNotifyStatePro.h"
 #include "PlayMontageProInterface.h"
+#include "PlayMontageProStats.h"
+#include "PlayMontageProSubsystem.h"
+#include "PlayMontageProValidation.h"
+#include "Animation/ActiveMontageInstanceScope.h"
+#include "Animation/AnimInstance.h"
 #include "Animation/AnimMontage.h"
+#include "Animation/AnimNotifyQueue.h"
+#include "Algo/BinarySearch.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "Engine/World.h"
-#include "TimerManager.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(PlayMontageProStatics)
 
-void UPlayMontageProStatics::GatherNotifies(UAnimMontage* Montage, uint32& NotifyId,
-	TArray<FAnimNotifyProEvent>& Notifies, const FName& Section, float StartPosition, float TimeDilation)
+namespace PlayMontagePro
 {
-	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::GatherNotifies);
-
-	const int32 SectionIndex = Montage->GetSectionIndex(Section);
-	
-	Notifies.Reset();
-	TArray<FAnimNotifyEvent>& MontageNotifies = Montage->Notifies;
-	for (FAnimNotifyEvent& MontageNotify : MontageNotifies)
+	/** Sets the notify times and clock once the events point at their section table */
+	static void InitNotifyTimes(UAnimMontage* Montage, FAnimNotifyProEvents& Notifies, float StartPosition, float TimeDilation, float PlayRate)
 	{
-		const float NotifyTime = MontageNotify.GetTime();
-		const float StartTime = (NotifyTime - StartPosition) * TimeDilation;
+		// Times are in montage time, the clock converts them to scheduler time
+		Notifies.Clock.PlayRate = PlayRate * Montage->RateScale;
+		Notifies.Clock.TimeDilation = TimeDilation;
 
-		// Add notify to the list of notifies
-		if (UAnimNotifyPro* Notify = MontageNotify.Notify ? Cast<UAnimNotifyPro>(MontageNotify.Notify) : nullptr)
+		const TArray<float>& Positions = Notifies.Table->Positions;
+		for (int32 NotifyIndex = 0; NotifyIndex < Notifies.Num(); NotifyIndex++)
 		{
-			// Only if section is the same as the one we are playing
-			const int32 SectionIndexAtTime = Montage->GetSectionIndexFromPosition(NotifyTime);
-			if (SectionIndexAtTime != SectionIndex)
-			{
-				continue;
-			}
-			
-			// Create notify event
-			FAnimNotifyProEvent NotifyEvent = { ++NotifyId, Notify->EnsureTriggerNotify,
-				EAnimNotifyProType::Notify, StartTime };
-
-			// Cache notify
-			NotifyEvent.Notify = Notify;
-			
-			Notifies.Add(NotifyEvent);
+			Notifies.Times[NotifyIndex] = Positions[NotifyIndex] - StartPosition;
 		}
+	}
+}
 
-		// Add notify states to the list of notifies
-		if (UAnimNotifyStatePro* Notify = MontageNotify.NotifyStateClass ? Cast<UAnimNotifyStatePro>(MontageNotify.NotifyStateClass) : nullptr)
-		{
-			// Compute end time for the notify end state
-			const float EndTime = StartTime + (MontageNotify.GetDuration() * TimeDilation);
+void UPlayMontageProStatics::GatherNotifies(UAnimMontage* Montage, uint32& NotifyId,
+	FAnimNotifyProEvents& Notifies, const FName& Section, float StartPosition, float TimeDilation, float PlayRate)
+{
+	// The compiled table is shared between every instance of the montage, and already sorted by position
+	GatherNotifies(FAnimNotifyProTableCache::Get(Montage), Montage, NotifyId, Notifies, Section, StartPosition, TimeDilation, PlayRate);
+}
 
-			// Start state notify
-			FAnimNotifyProEvent& NotifyBeginEvent = Notifies.Add_GetRef({ ++NotifyId, Notify->EnsureTriggerNotify,
-				EAnimNotifyProType::NotifyStateBegin, StartTime });
+void UPlayMontageProStatics::GatherNotifies(const TSharedRef<const FAnimNotifyProMontageTable>& MontageTable, UAnimMontage* Montage,
+	uint32& NotifyId, FAnimNotifyProEvents& Notifies, const FName& Section, float StartPosition, float TimeDilation, float PlayRate)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::GatherNotifies);
 
-			// End state notify
-			FAnimNotifyProEvent& NotifyEndEvent = Notifies.Add_GetRef({ ++NotifyId, Notify->EnsureTriggerNotify,
-				EAnimNotifyProType::NotifyStateEnd, EndTime });
+	const FAnimNotifyProSectionTable& Table = MontageTable->GetSection(Montage->GetSectionIndex(Section));
 
-			// Cache notify state
-			NotifyBeginEvent.NotifyState = Notify;
-			NotifyEndEvent.NotifyState = Notify;
+	// Only the runtime state is per instance, reusing the existing allocation when it is large enough
+	Notifies.Init(MontageTable, Table, NotifyId + 1);
+	NotifyId += Table.Num();
 
-			// Mark as end state
-			NotifyEndEvent.bIsEndState = true;
+	PlayMontagePro::InitNotifyTimes(Montage, Notifies, StartPosition, TimeDilation, PlayRate);
+}
 
-			// Pair begin and end states
-			NotifyBeginEvent.NotifyStatePair = &NotifyEndEvent;
-			NotifyEndEvent.NotifyStatePair = &NotifyBeginEvent;
-		}
+int32 UPlayMontageProStatics::GatherSectionNotifies(UAnimMontage* Montage, uint32& NotifyId,
+	FAnimNotifyProEvents& Notifies, float StartPosition, float TimeDilation, float PlayRate)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::GatherSectionNotifies);
+
+	// Keep using the table the montage started with, sections are already sliced from it
+	const TSharedRef<const FAnimNotifyProMontageTable> MontageTable =
+		Notifies.MontageTable.IsValid() && Notifies.MontageTable->Montage == TObjectKey<UAnimMontage>(Montage)
+		? Notifies.MontageTable.ToSharedRef() : FAnimNotifyProTableCache::Get(Montage);
+
+	const int32 SectionIndex = MontageTable->FindSectionIndex(StartPosition);
+	const FAnimNotifyProSectionTable& Table = MontageTable->GetSection(SectionIndex);
+
+	if (Notifies.Table == &Table)
+	{
+		// Same section, e.g. it looped, so only the runtime state needs resetting
+		Notifies.Rearm(NotifyId + 1);
 	}
+	else
+	{
+		Notifies.Init(MontageTable, Table, NotifyId + 1);
+	}
+	NotifyId += Table.Num();
+
+	PlayMontagePro::InitNotifyTimes(Montage, Notifies, StartPosition, TimeDilation, PlayRate);
+	return SectionIndex;
 }
 
-void UPlayMontageProStatics::HandleHistoricNotifies(TArray<FAnimNotifyProEvent>& Notifies,
+void UPlayMontageProStatics::HandleHistoricNotifies(FAnimNotifyProEvents& Notifies,
 	bool bTriggerNotifiesBeforeStartTime, IPlayMontageProInterface* Interface)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::TriggerHistoricNotifies);
 	
 	// Trigger notifies before start time and remove them, if we want to trigger them before the start time
-	for (FAnimNotifyProEvent& Notify : Notifies)
+	for (int32 NotifyIndex = 0; NotifyIndex < Notifies.Num(); NotifyIndex++)
 	{
-		if (Notify.Time <= 0.f)
+		if (Notifies.Times[NotifyIndex] <= 0.f)
 		{
 			if (bTriggerNotifiesBeforeStartTime)
 			{
-				BroadcastNotifyEvent(Notify, Interface);
+				BroadcastNotifyEvent(Notifies, NotifyIndex, Interface);
 			}
 			else
 			{
-				Notify.bNotifySkipped = true;
+				Notifies.Skipped[NotifyIndex] = true;
 			}
 		}
 	}
 }
 
+void UPlayMontageProStatics::SkipInsignificantNotifies(FAnimNotifyProEvents& Notifies, const IPlayMontageProInterface* Interface)
+{
+	if (Notifies.Num() == 0 || !Interface || Interface->IsSignificant())
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::SkipInsignificantNotifies);
+
+	// A word at a time, the mask was baked into the table when it was built
+	const TArray<uint32>& CosmeticMask = Notifies.Table->CosmeticMask;
+	uint32* SkippedWords = Notifies.Skipped.GetData();
+	int32 NumCulled = 0;
+	for (int32 WordIndex = 0; WordIndex < CosmeticMask.Num(); WordIndex++)
+	{
+		NumCulled += FMath::CountBits(CosmeticMask[WordIndex] & ~SkippedWords[WordIndex]);
+		SkippedWords[WordIndex] |= CosmeticMask[WordIndex];
+	}
+	INC_DWORD_STAT_BY(STAT_PlayMontageProNotifiesCulled, NumCulled);
+}
+
 void UPlayMontageProStatics::SetupNotifyTimers(IPlayMontageProInterface* Interface, const UWorld* World,
-	TArray<FAnimNotifyProEvent>& Notifies)
+	FAnimNotifyProEvents& Notifies)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::SetupNotifyTimers);
-	
-	for (FAnimNotifyProEvent& Notify : Notifies)
+
+	UPlayMontageProSubsystem* Scheduler = UPlayMontageProSubsystem::Get(World);
+	if (!Scheduler)
 	{
-		// Set up timer for notify
-		Notify.TimerDelegate = Interface->CreateTimerDelegate(Notify);
-		World->GetTimerManager().SetTimer(Notify.Timer, Notify.TimerDelegate, Notify.Time, false);
+		return;
 	}
+
+	// Start the clock now, notifies at or before the start time are handled by HandleHistoricNotifies
+	Notifies.Clock.Anchor(Scheduler->GetTime(), 0.f);
+	Notifies.NextEventIndex = Algo::UpperBound(Notifies.Times, 0.f);
+	Scheduler->ScheduleNotifies(Interface, Notifies);
 }
 
-void UPlayMontageProStatics::ClearNotifyTimers(const UWorld* World, TArray<FAnimNotifyProEvent>& Notifies)
+void UPlayMontageProStatics::ClearNotifyTimers(const UWorld* World, FAnimNotifyProEvents& Notifies)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::ForfeitNotifyTimers);
-	
-	for (FAnimNotifyProEvent& Notify : Notifies)
+
+	// Remove the pending entry from the scheduler
+	if (UPlayMontageProSubsystem* Scheduler = UPlayMontageProSubsystem::Get(World))
+	{
+		Scheduler->UnscheduleNotifies(Notifies);
+	}
+	Notifies.ClearTimers();
+}
+
+void UPlayMontageProStatics::SetupFixedStepNotifies(FAnimNotifyProEvents& Notifies)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::SetupFixedStepNotifies);
+
+	// Notifies at or before the start time are handled by HandleHistoricNotifies, same as with timers
+	FAnimNotifyProFixedStepClock& FixedStep = Notifies.FixedStep;
+	const int32 FirstEventIndex = Algo::UpperBound(Notifies.Times, 0.f);
+	const float Scale = Notifies.Clock.GetScale();
+
+	FixedStep.CurrentTick = 0;
+	FixedStep.FireTicks.SetNumUninitialized(Notifies.Num(), EAllowShrinking::No);
+	for (int32 NotifyIndex = 0; NotifyIndex < Notifies.Num(); NotifyIndex++)
+	{
+		FixedStep.FireTicks[NotifyIndex] = NotifyIndex < FirstEventIndex ? 0
+			: FAnimNotifyProFixedStepClock::GetTick(Notifies.Times[NotifyIndex], Scale, FixedStep.TickRate);
+	}
+	Notifies.NextEventIndex = FirstEventIndex;
+}
+
+void UPlayMontageProStatics::AdvanceFixedStepNotifies(IPlayMontageProInterface* Interface, FAnimNotifyProEvents& Notifies,
+	int32 NumTicks)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::AdvanceFixedStepNotifies);
+
+	FAnimNotifyProFixedStepClock& FixedStep = Notifies.FixedStep;
+	const int32 TargetTick = static_cast<int32>(FMath::Min<int64>(static_cast<int64>(FixedStep.CurrentTick) + FMath::Max(NumTicks, 0), MAX_int32));
+	FixedStep.CurrentTick = TargetTick;
+
+	const uint32 FirstNotifyId = Notifies.FirstNotifyId;
+	while (Notifies.IsValidIndex(Notifies.NextEventIndex) && FixedStep.FireTicks[Notifies.NextEventIndex] <= TargetTick)
 	{
-		if (Notify.Timer.IsValid())
+		const int32 NotifyIndex = Notifies.NextEventIndex++;
+		if (!Notifies.HasBroadcast[NotifyIndex] && !Notifies.Skipped[NotifyIndex])
 		{
-			// Clear the timer for this notify
-			World->GetTimerManager().ClearTimer(Notify.Timer);
-			Notify.ClearTimers();
+			// Lateness is at most a tick, unless ticks were skipped
+			const float Scale = Notifies.Clock.GetScale();
+			PlayMontagePro::RecordNotifyDispatch(EAnimNotifyProDispatchMode::FixedStep, Notifies.GetNotifyId(NotifyIndex),
+				Notifies.Times[NotifyIndex], static_cast<double>(TargetTick) * Scale / FixedStep.TickRate);
 		}
+		Interface->BroadcastNotifyEvent(NotifyIndex);
+
+		// Stop if the callbacks gathered notifies again, or moved the clock themselves
+		if (Notifies.FirstNotifyId != FirstNotifyId || FixedStep.CurrentTick != TargetTick)
+		{
+			return;
+		}
+
+#if !UE_BUILD_SHIPPING
+		if (PlayMontagePro::Validation::IsEnabled())
+		{
+			PlayMontagePro::Validation::ValidateDispatched(Notifies, NotifyIndex, EAnimNotifyProDispatchMode::FixedStep);
+		}
+#endif
+	}
+}
+
+void UPlayMontageProStatics::RewindFixedStepNotifies(FAnimNotifyProEvents& Notifies, int32 Tick)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::RewindFixedStepNotifies);
+
+	if (Notifies.Num() == 0)
+	{
+		return;
 	}
+
+	// Events are sorted by tick, so the events that have triggered by Tick are a contiguous range after the historic events
+	FAnimNotifyProFixedStepClock& FixedStep = Notifies.FixedStep;
+	FixedStep.CurrentTick = FMath::Max(Tick, 0);
+	const int32 FirstEventIndex = Algo::UpperBound(Notifies.Times, 0.f);
+	const int32 NextEventIndex = FMath::Max(FirstEventIndex, Algo::UpperBound(FixedStep.FireTicks, FixedStep.CurrentTick));
+
+	Notifies.HasBroadcast.SetRange(FirstEventIndex, NextEventIndex - FirstEventIndex, true);
+	Notifies.HasBroadcast.SetRange(NextEventIndex, Notifies.Num() - NextEventIndex, false);
+	Notifies.NextEventIndex = NextEventIndex;
+}
+
+void UPlayMontageProStatics::SeekNotifyCursor(const FAnimNotifyProEvents& Notifies, int32& Cursor, float Position)
+{
+	// Notifies at or before the position are handled by HandleHistoricNotifies, same as with timers
+	Cursor = Notifies.Table ? Algo::UpperBound(Notifies.Table->Positions, Position) : 0;
 }
 
-void UPlayMontageProStatics::BroadcastNotifyEvent(FAnimNotifyProEvent& Event, IPlayMontageProInterface* Interface)
+void UPlayMontageProStatics::HandleMontagePositionNotifies(IPlayMontageProInterface* Interface,
+	FAnimNotifyProEvents& Notifies, int32& Cursor, float PreviousPosition, float CurrentPosition)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::HandleMontagePositionNotifies);
+
+	if (CurrentPosition < PreviousPosition)
+	{
+		// The position moved backwards without a section change, e.g. Montage_SetPosition
+		// Notifies are not triggered in reverse, only move the cursor back so they can be crossed again
+		SeekNotifyCursor(Notifies, Cursor, CurrentPosition);
+		return;
+	}
+
+	// Broadcast every notify crossed since the previous position
+	while (Notifies.IsValidIndex(Cursor))
+	{
+		const int32 NotifyIndex = Cursor;
+		if (Notifies.Table->Positions[NotifyIndex] > CurrentPosition)
+		{
+			break;
+		}
+
+		const uint32 BroadcastNotifyId = Notifies.GetNotifyId(NotifyIndex);
+		if (!Notifies.HasBroadcast[NotifyIndex] && !Notifies.Skipped[NotifyIndex])
+		{
+			PlayMontagePro::RecordNotifyDispatch(EAnimNotifyProDispatchMode::MontagePosition, BroadcastNotifyId,
+				Notifies.Table->Positions[NotifyIndex], CurrentPosition);
+		}
+		Cursor++;
+		Interface->BroadcastNotifyEvent(NotifyIndex);
+
+		// Stop if the notifies were gathered again during the broadcast, e.g. the notify changed section
+		if (!Notifies.IsValidIndex(NotifyIndex) || Notifies.GetNotifyId(NotifyIndex) != BroadcastNotifyId)
+		{
+			break;
+		}
+
+#if !UE_BUILD_SHIPPING
+		if (PlayMontagePro::Validation::IsEnabled())
+		{
+			PlayMontagePro::Validation::ValidateDispatched(Notifies, NotifyIndex, EAnimNotifyProDispatchMode::MontagePosition);
+		}
+#endif
+	}
+}
+
+void UPlayMontageProStatics::BroadcastNotifyEvent(FAnimNotifyProEvents& Notifies, int32 NotifyIndex,
+	IPlayMontageProInterface* Interface)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::BroadcastNotifyEvent);
+
+	if (!Notifies.IsValidIndex(NotifyIndex))
+	{
+		return;
+	}
 	
 	// Ensure we don't broadcast the same event twice
-	if (Event.bHasBroadcast || Event.bNotifySkipped)
+	if (Notifies.HasBroadcast[NotifyIndex] || Notifies.Skipped[NotifyIndex])
 	{
 		return;
 	}
 
 	// Ensure the start state broadcasts first if this is the end state
-	if (Event.bIsEndState && Event.NotifyStatePair)
+	const int32 PairIndex = Notifies.Table->PairIndices[NotifyIndex];
+	if (Notifies.IsEndState(NotifyIndex) && Notifies.IsValidIndex(PairIndex))
 	{
 		// If our start state was skipped, we can't broadcast the end state
-		if (Event.NotifyStatePair->bNotifySkipped)
+		if (Notifies.Skipped[PairIndex])
 		{
 			return;
 		}
 
 		// Broadcast the start state first
-		if (!Event.NotifyStatePair->bHasBroadcast)
+		if (!Notifies.HasBroadcast[PairIndex])
 		{
-			BroadcastNotifyEvent(*Event.NotifyStatePair, Interface);
+			const uint32 NotifyId = Notifies.GetNotifyId(NotifyIndex);
+			BroadcastNotifyEvent(Notifies, PairIndex, Interface);
+
+			// The start state callbacks may have gathered notifies again or already broadcast this event
+			if (!Notifies.IsValidIndex(NotifyIndex) || Notifies.GetNotifyId(NotifyIndex) != NotifyId
+				|| Notifies.HasBroadcast[NotifyIndex] || Notifies.Skipped[NotifyIndex])
+			{
+				return;
+			}
 		}
 	}
 
-	// Mark the event as broadcast and clear timers
-	Event.bHasBroadcast = true;
-	Event.ClearTimers();
+	// Mark the event as broadcast, the scheduler skips it if it is still ahead of the clock
+	Notifies.HasBroadcast[NotifyIndex] = true;
+
+#if !UE_BUILD_SHIPPING
+	if (PlayMontagePro::Validation::IsEnabled())
+	{
+		PlayMontagePro::Validation::ValidateBroadcast(Notifies, NotifyIndex);
+	}
+#endif
+
+	// Callbacks may gather notifies again, so everything is read before any of them run
+	// The event is only built if the interface has listeners for it
+	const EAnimNotifyProType NotifyType = Notifies.Table->Types[NotifyIndex];
+	UAnimNotifyPro* Notify = Notifies.Table->Notifies[NotifyIndex].Get();
+	UAnimNotifyStatePro* NotifyState = Notifies.Table->NotifyStates[NotifyIndex].Get();
+	const bool bWantsEvent = Interface->WantsNotifyEvents();
+	const FAnimNotifyProEvent BroadcastEvent = bWantsEvent ? Notifies.MakeEvent(NotifyIndex) : FAnimNotifyProEvent();
+
+	// Notifies merged from a driven montage are triggered with the driven mesh and montage
+	USkeletalMeshComponent* Mesh = Interface->GetMesh();
+	UAnimMontage* Montage = Interface->GetMontage();
+	if (const uint8 Source = Notifies.Table->Sources[NotifyIndex])
+	{
+		Interface->GetDrivenSource(Source - 1, Mesh, Montage);
+	}
 
 	// Broadcast notify callback
-	switch (Event.NotifyType)
+	switch (NotifyType)
 	{
 	case EAnimNotifyProType::Notify:
-		if (Event.Notify.IsValid())
+		if (Notify)
 		{
-			Event.Notify->NotifyCallback(Interface->GetMesh(), Interface->GetMontage());
-			Interface->NotifyCallback(Event);
+			Notify->NotifyCallback(Mesh, Montage);
+			if (bWantsEvent)
+			{
+				Interface->NotifyCallback(BroadcastEvent);
+			}
 		}
 		break;
 	case EAnimNotifyProType::NotifyStateBegin:
-		if (Event.NotifyState.IsValid())
+		if (NotifyState)
 		{
-			Event.NotifyState->NotifyBeginCallback(Interface->GetMesh(), Interface->GetMontage());
-			Interface->NotifyBeginCallback(Event);
+			// The handle is kept by this montage instance, so another instance of the state on the mesh can't end its tick
+			if (NotifyState->TickRate != EAnimNotifyProTickRate::Disabled && NotifyState->ShouldTriggerNotify(Mesh))
+			{
+				if (UPlayMontageProSubsystem* Subsystem = Mesh ? UPlayMontageProSubsystem::Get(Mesh->GetWorld()) : nullptr)
+				{
+					const uint32 TickHandle = Subsystem->RegisterNotifyStateTick(NotifyState, Mesh, Montage, Notifies.FindTickHandle(NotifyState));
+					Notifies.AddTickHandle(NotifyState, TickHandle);
+				}
+			}
+			NotifyState->NotifyBeginCallback(Mesh, Montage);
+			if (bWantsEvent)
+			{
+				Interface->NotifyBeginCallback(BroadcastEvent);
+			}
 		}
 		break;
 	case EAnimNotifyProType::NotifyStateEnd:
-		if (Event.NotifyState.IsValid())
+		if (NotifyState)
 		{
-			Event.NotifyState->NotifyEndCallback(Interface->GetMesh(), Interface->GetMontage());
-			Interface->NotifyEndCallback(Event);
+			if (const uint32 TickHandle = Notifies.RemoveTickHandle(NotifyState))
+			{
+				if (UPlayMontageProSubsystem* Subsystem = Mesh ? UPlayMontageProSubsystem::Get(Mesh->GetWorld()) : nullptr)
+				{
+					Subsystem->UnregisterNotifyStateTick(TickHandle);
+				}
+			}
+			NotifyState->NotifyEndCallback(Mesh, Montage);
+			if (bWantsEvent)
+			{
+				Interface->NotifyEndCallback(BroadcastEvent);
+			}
 		}
 		break;
 	}
 }
 
 void UPlayMontageProStatics::EnsureBroadcastNotifyEvents(EAnimNotifyProEventType EventType,
-	TArray<FAnimNotifyProEvent>& Notifies, IPlayMontageProInterface* Interface)
+	FAnimNotifyProEvents& Notifies, IPlayMontageProInterface* Interface)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::EnsureBroadcastNotifyEvents);
-	
-	for (FAnimNotifyProEvent& Event : Notifies)
+
+	FAnimNotifyProEnsureIndices NotifyIndices;
+	GatherEnsureNotifyEvents(EventType, Notifies, NotifyIndices);
+	BroadcastEnsureNotifyEvents(EventType, Notifies, NotifyIndices, Interface);
+}
+
+void UPlayMontageProStatics::GatherEnsureNotifyEvents(EAnimNotifyProEventType EventType,
+	const FAnimNotifyProEvents& Notifies, FAnimNotifyProEnsureIndices& OutNotifyIndices)
+{
+	OutNotifyIndices.Reset();
+	if (Notifies.Num() == 0)
+	{
+		return;
+	}
+
+	// Ensure that notifies are triggered if the montage aborts before they're reached when aborted due to these conditions
+	const FAnimNotifyProSectionTable& Table = *Notifies.Table;
+	const uint32 EventFlags = static_cast<uint32>(EventType);
+	auto GetEnsureWord = [&Table, EventFlags](int32 WordIndex)
 	{
-		if (Event.bHasBroadcast)
+		uint32 EnsureWord = 0;
+		for (int32 ReasonIndex = 0; ReasonIndex < FAnimNotifyProSectionTable::NumEnsureReasons; ReasonIndex++)
 		{
-			continue;
+			if (EventFlags & (1u << ReasonIndex))
+			{
+				EnsureWord |= Table.EnsureMasks[ReasonIndex][WordIndex];
+			}
 		}
-		
-		// Ensure that notifies are triggered if the montage aborts before they're reached when aborted due to these conditions
-		const EAnimNotifyProEventType EventFlags = static_cast<EAnimNotifyProEventType>(Event.EnsureTriggerNotify);
-		if (EnumHasAnyFlags(EventFlags, EventType))
+		return EnsureWord;
+	};
+
+	// Only events that ensure this condition, or end states, can need broadcasting, visited 32 at a time in index order
+	for (int32 WordIndex = 0; WordIndex < Table.NumWords(); WordIndex++)
+	{
+		const uint32 EnsureWord = GetEnsureWord(WordIndex);
+		uint32 Candidates = EnsureWord | Table.EndStateMask[WordIndex];
+		while (Candidates != 0)
 		{
-			Interface->BroadcastNotifyEvent(Event);
+			const uint32 Bit = FMath::CountTrailingZeros(Candidates);
+			Candidates &= Candidates - 1;
+
+			const int32 NotifyIndex = WordIndex * 32 + Bit;
+			if (Notifies.HasBroadcast[NotifyIndex] || Notifies.Skipped[NotifyIndex])
+			{
+				continue;
+			}
+
+			if (EnsureWord & (1u << Bit))
+			{
+				OutNotifyIndices.Add(NotifyIndex);
+				continue;
+			}
+
+			// Ensure that the end state is reached if the start state notify was triggered, or is about to be by this condition.
+			// The start state always precedes its end state, so it has already been visited
+			const int32 PairIndex = Table.PairIndices[NotifyIndex];
+			if (Notifies.IsValidIndex(PairIndex) && !Notifies.Skipped[PairIndex])
+			{
+				const bool bPairEnsured = (GetEnsureWord(PairIndex / 32) & (1u << (PairIndex % 32))) != 0;
+				if (Notifies.HasBroadcast[PairIndex] || bPairEnsured)
+				{
+					OutNotifyIndices.Add(NotifyIndex);
+				}
+			}
 		}
-		
-		// Ensure that the end state is reached if the start state notify was triggered
-		if (Event.bIsEndState && Event.NotifyStatePair && Event.NotifyStatePair->bHasBroadcast)
+	}
+}
+
+void UPlayMontageProStatics::BroadcastEnsureNotifyEvents(EAnimNotifyProEventType EventType,
+	FAnimNotifyProEvents& Notifies, TConstArrayView<int32> NotifyIndices, IPlayMontageProInterface* Interface)
+{
+	const uint32 FirstNotifyId = Notifies.FirstNotifyId;
+	for (const int32 NotifyIndex : NotifyIndices)
+	{
+		// Broadcasting an end state also broadcasts its begin state, and callbacks may broadcast events themselves
+		if (!Notifies.IsValidIndex(NotifyIndex) || Notifies.HasBroadcast[NotifyIndex])
 		{
-			Interface->BroadcastNotifyEvent(Event);
+			continue;
 		}
+
+		PlayMontagePro::RecordEnsureBroadcast(EventType);
+		BroadcastNotifyEvent(Notifies, NotifyIndex, Interface);
+
+		// Stop if the callbacks gathered notifies again
+		if (Notifies.FirstNotifyId != FirstNotifyId)
+		{
+			return;
+		}
+	}
+
+#if !UE_BUILD_SHIPPING
+	if (PlayMontagePro::Validation::IsEnabled())
+	{
+		PlayMontagePro::Validation::ValidateEnsureBroadcast(Notifies, EventType);
 	}
+#endif
 }
 
 void UPlayMontageProStatics::HandleTimeDilation(IPlayMontageProInterface* Interface, const USkinnedMeshComponent* MeshComp,
-	float& TimeDilation, TArray<FAnimNotifyProEvent>& Notifies)
+	float& TimeDilation, FAnimNotifyProEvents& Notifies)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProStatics::HandleTimeDilation);
 	
@@ -220,32 +518,39 @@ void UPlayMontageProStatics::HandleTimeDilation(IPlayMontageProInterface* Interf
 		return;
 	}
 	
+	UPlayMontageProSubsystem* Scheduler = UPlayMontageProSubsystem::Get(World);
+	if (!Scheduler)
+	{
+		return;
+	}
+	
 	const float NewTimeDilation = MeshComp->GetOwner()->CustomTimeDilation;
 	if (!FMath::IsNearlyEqual(TimeDilation, NewTimeDilation))
 	{
-		// If time dilation has changed, we need to update the notifies
-		for (FAnimNotifyProEvent& Notify : Notifies)
+		// Notify times are in montage time, so only the clock needs to change
+		// Elapsed time is maintained, and only the remaining time is affected by time dilation changes
+		Scheduler->SetTimeDilation(Interface, Notifies, NewTimeDilation);
+		TimeDilation = NewTimeDilation;
+	}
+}
+
+UAnimMontage* UPlayMontageProStatics::GetNotifyMontage(const USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation,
+	const FAnimNotifyEventReference& EventReference)
+{
+	if (UAnimMontage* Montage = Cast<UAnimMontage>(Animation))
+	{
+		return Montage;
+	}
+
+	// Notifies of a montage's segments are triggered with the segment's sequence, the montage instance is in the context
+	const FAnimNotifyMontageInstanceContext* MontageContext = EventReference.GetContextData<FAnimNotifyMontageInstanceContext>();
+	const UAnimInstance* AnimInstance = MeshComp ? MeshComp->GetAnimInstance() : nullptr;
+	if (MontageContext && AnimInstance)
+	{
+		if (const FAnimMontageInstance* MontageInstance = AnimInstance->GetMontageInstanceForID(MontageContext->MontageInstanceID))
 		{
-			// Any elapsed time should be maintained, and only remaining time should be updated
-			// Then we need to restart the timer based on the new time, without the already elapsed time
-			// So that only the remaining time is affected by time dilation changes
-			if (Notify.IsValid() && !Notify.bNotifySkipped && !Notify.bHasBroadcast && Notify.Timer.IsValid())
-			{
-				const float ElapsedTime = World->GetTimerManager().GetTimerElapsed(Notify.Timer);
-				const float RemainingTime = Notify.Time - ElapsedTime;
-				if (RemainingTime > 0.f)
-				{
-					// Restart the timer with the new time dilation
-					Notify.Time = ElapsedTime + RemainingTime / NewTimeDilation;
-
-					// Clear the previous delegate and bind a new one
-					World->GetTimerManager().ClearTimer(Notify.Timer);
-					Notify.ClearTimers();
-					Notify.TimerDelegate = Interface->CreateTimerDelegate(Notify);
-					World->GetTimerManager().SetTimer(Notify.Timer, Notify.TimerDelegate, Notify.Time, false);
-				}
-			}
+			return MontageInstance->Montage;
 		}
-		TimeDilation = NewTimeDilation;
 	}
+	return nullptr;
 }
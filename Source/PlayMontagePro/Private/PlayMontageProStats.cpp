@@ -0,0 +1,94 @@
+// Copyright (c) Jared Taylor
+
+#include "PlayMontageProStats.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+
+DEFINE_STAT(STAT_PlayMontageProTick);
+DEFINE_STAT(STAT_PlayMontageProActiveProxies);
+DEFINE_STAT(STAT_PlayMontageProPooledProxies);
+DEFINE_STAT(STAT_PlayMontageProPendingNotifies);
+DEFINE_STAT(STAT_PlayMontageProNotifiesScheduled);
+DEFINE_STAT(STAT_PlayMontageProTimeDilationRescales);
+DEFINE_STAT(STAT_PlayMontageProNotifiesDispatched);
+DEFINE_STAT(STAT_PlayMontageProNotifiesLate);
+DEFINE_STAT(STAT_PlayMontageProNotifiesCulled);
+DEFINE_STAT(STAT_PlayMontageProTickingNotifyStates);
+DEFINE_STAT(STAT_PlayMontageProNotifyStateTicks);
+DEFINE_STAT(STAT_PlayMontageProEnsuredOnCompleted);
+DEFINE_STAT(STAT_PlayMontageProEnsuredBlendOut);
+DEFINE_STAT(STAT_PlayMontageProEnsuredOnInterrupted);
+DEFINE_STAT(STAT_PlayMontageProEnsuredOnCancelled);
+DEFINE_STAT(STAT_PlayMontageProReplication);
+DEFINE_STAT(STAT_PlayMontageProReplicatedBytes);
+
+CSV_DEFINE_CATEGORY(PlayMontagePro, true);
+
+UE_TRACE_CHANNEL_DEFINE(PlayMontageProChannel);
+
+#if UE_TRACE_ENABLED
+UE_TRACE_EVENT_BEGIN(PlayMontagePro, NotifyDispatch)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(double, ScheduledTime)
+	UE_TRACE_EVENT_FIELD(double, ActualTime)
+	UE_TRACE_EVENT_FIELD(double, Lateness)
+	UE_TRACE_EVENT_FIELD(uint32, NotifyId)
+	UE_TRACE_EVENT_FIELD(uint8, DispatchMode)
+UE_TRACE_EVENT_END()
+#endif
+
+namespace PlayMontagePro
+{
+	static float LateNotifyThreshold = 0.05f;
+	static FAutoConsoleVariableRef CVarLateNotifyThreshold(
+		TEXT("a.PlayMontagePro.LateNotifyThreshold"),
+		LateNotifyThreshold,
+		TEXT("Notifies triggered more than this many seconds (or montage seconds for MontagePosition dispatch) after they were due are counted as late."),
+		ECVF_Default);
+
+	void RecordNotifyDispatch(EAnimNotifyProDispatchMode DispatchMode, uint32 NotifyId, double ScheduledTime, double ActualTime)
+	{
+		const double Lateness = ActualTime - ScheduledTime;
+
+		INC_DWORD_STAT(STAT_PlayMontageProNotifiesDispatched);
+		CSV_CUSTOM_STAT(PlayMontagePro, NotifiesDispatched, 1, ECsvCustomStatOp::Accumulate);
+		if (Lateness > LateNotifyThreshold)
+		{
+			INC_DWORD_STAT(STAT_PlayMontageProNotifiesLate);
+			CSV_CUSTOM_STAT(PlayMontagePro, NotifiesLate, 1, ECsvCustomStatOp::Accumulate);
+		}
+
+#if UE_TRACE_ENABLED
+		UE_TRACE_LOG(PlayMontagePro, NotifyDispatch, PlayMontageProChannel)
+			<< NotifyDispatch.Cycle(FPlatformTime::Cycles64())
+			<< NotifyDispatch.ScheduledTime(ScheduledTime)
+			<< NotifyDispatch.ActualTime(ActualTime)
+			<< NotifyDispatch.Lateness(Lateness)
+			<< NotifyDispatch.NotifyId(NotifyId)
+			<< NotifyDispatch.DispatchMode(static_cast<uint8>(DispatchMode));
+#endif
+	}
+
+	void RecordEnsureBroadcast(EAnimNotifyProEventType EventType)
+	{
+		switch (EventType)
+		{
+		case EAnimNotifyProEventType::OnCompleted:
+			INC_DWORD_STAT(STAT_PlayMontageProEnsuredOnCompleted);
+			break;
+		case EAnimNotifyProEventType::BlendOut:
+			INC_DWORD_STAT(STAT_PlayMontageProEnsuredBlendOut);
+			break;
+		case EAnimNotifyProEventType::OnInterrupted:
+			INC_DWORD_STAT(STAT_PlayMontageProEnsuredOnInterrupted);
+			break;
+		case EAnimNotifyProEventType::OnCancelled:
+			INC_DWORD_STAT(STAT_PlayMontageProEnsuredOnCancelled);
+			break;
+		default:
+			break;
+		}
+		CSV_CUSTOM_STAT(PlayMontagePro, NotifiesEnsured, 1, ECsvCustomStatOp::Accumulate);
+	}
+}
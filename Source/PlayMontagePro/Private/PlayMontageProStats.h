@@ -0,0 +1,49 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PlayMontageTypes.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+
+DECLARE_STATS_GROUP(TEXT("PlayMontagePro"), STATGROUP_PlayMontagePro, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Subsystem Tick"), STAT_PlayMontageProTick, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Active Proxies"), STAT_PlayMontageProActiveProxies, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pooled Proxies"), STAT_PlayMontageProPooledProxies, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pending Notifies"), STAT_PlayMontageProPendingNotifies, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Notifies Scheduled"), STAT_PlayMontageProNotifiesScheduled, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Time Dilation Rescales"), STAT_PlayMontageProTimeDilationRescales, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Notifies Dispatched"), STAT_PlayMontageProNotifiesDispatched, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Notifies Late"), STAT_PlayMontageProNotifiesLate, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Notifies Culled"), STAT_PlayMontageProNotifiesCulled, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ticking Notify States"), STAT_PlayMontageProTickingNotifyStates, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Notify State Ticks"), STAT_PlayMontageProNotifyStateTicks, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ensured On Completed"), STAT_PlayMontageProEnsuredOnCompleted, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ensured Blend Out"), STAT_PlayMontageProEnsuredBlendOut, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ensured On Interrupted"), STAT_PlayMontageProEnsuredOnInterrupted, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ensured On Cancelled"), STAT_PlayMontageProEnsuredOnCancelled, STATGROUP_PlayMontagePro, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Replicated State"), STAT_PlayMontageProReplication, STATGROUP_PlayMontagePro, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Replicated State Bytes"), STAT_PlayMontageProReplicatedBytes, STATGROUP_PlayMontagePro, );
+
+CSV_DECLARE_CATEGORY_EXTERN(PlayMontagePro);
+
+UE_TRACE_CHANNEL_EXTERN(PlayMontageProChannel);
+
+namespace PlayMontagePro
+{
+	/**
+	 * Records a notify about to be broadcast by the scheduler or by montage position dispatch.
+	 * Counts it, counts it as late if it exceeds a.PlayMontagePro.LateNotifyThreshold, and logs it to the PlayMontagePro trace channel.
+	 * @param DispatchMode How the notify was dispatched, times are in scheduler seconds for Timer and montage position for MontagePosition.
+	 * @param NotifyId The ID of the notify.
+	 * @param ScheduledTime When the notify should have been triggered.
+	 * @param ActualTime When the notify is being triggered.
+	 */
+	void RecordNotifyDispatch(EAnimNotifyProDispatchMode DispatchMode, uint32 NotifyId, double ScheduledTime, double ActualTime);
+
+	/** Records a notify broadcast by EnsureBroadcastNotifyEvents for the EventType condition */
+	void RecordEnsureBroadcast(EAnimNotifyProEventType EventType);
+}
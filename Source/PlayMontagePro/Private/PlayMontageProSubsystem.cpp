@@ -0,0 +1,783 @@
+// Copyright (c) Jared Taylor
+
+#include "PlayMontageProSubsystem.h"
+
+#include "AnimNotifyPro.h"
+#include "AnimNotifyProTable.h"
+#include "AnimNotifyStatePro.h"
+#include "PlayMontageProCallbackProxy.h"
+#include "PlayMontageProInterface.h"
+#include "PlayMontageProStats.h"
+#include "PlayMontageProValidation.h"
+#include "PlayMontageTypes.h"
+#include "Algo/StableSort.h"
+#include "Animation/AnimInstance.h"
+#include "Async/ParallelFor.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "HAL/IConsoleManager.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(PlayMontageProSubsystem)
+
+namespace PlayMontagePro
+{
+	/** Minimum heap size before stale entries are compacted */
+	static constexpr int32 MinHeapSizeForCompaction = 64;
+
+	static int32 MaxPooledProxies = 256;
+	static FAutoConsoleVariableRef CVarMaxPooledProxies(
+		TEXT("a.PlayMontagePro.MaxPooledProxies"),
+		MaxPooledProxies,
+		TEXT("Maximum number of finished PlayMontagePro proxies kept per world for reuse. 0 disables pooling."),
+		ECVF_Default);
+
+	static int32 ThreadSafeNotifyMinBatchSize = 8;
+	static FAutoConsoleVariableRef CVarThreadSafeNotifyMinBatchSize(
+		TEXT("a.PlayMontagePro.ThreadSafeNotifyMinBatchSize"),
+		ThreadSafeNotifyMinBatchSize,
+		TEXT("Minimum number of meshes with thread safe notifies handled by each worker. Smaller batches run on the game thread."),
+		ECVF_Default);
+
+	static float CullCosmeticNotRenderedTime = 0.f;
+	static FAutoConsoleVariableRef CVarCullCosmeticNotRenderedTime(
+		TEXT("a.PlayMontagePro.CullCosmeticNotRenderedTime"),
+		CullCosmeticNotRenderedTime,
+		TEXT("Cosmetic Pro notifies are skipped for meshes not rendered within this many seconds when their notifies are gathered, unless a significance query is bound. 0 disables."),
+		ECVF_Default);
+
+	static int32 TerminationMinBatchSize = 16;
+	static FAutoConsoleVariableRef CVarTerminationMinBatchSize(
+		TEXT("a.PlayMontagePro.TerminationMinBatchSize"),
+		TerminationMinBatchSize,
+		TEXT("Minimum number of terminated montages whose ensured notifies are gathered by each worker. Smaller batches run on the game thread."),
+		ECVF_Default);
+
+	/** Fractional part of the golden ratio, spreads the phase of successive notify state ticks evenly */
+	static constexpr double TickStaggerStep = 0.6180339887498949;
+
+	/** Thread safe notify resolved on the game thread before the batch runs */
+	struct FResolvedThreadSafeNotify
+	{
+		const UAnimNotifyPro* Notify;
+		const UAnimNotifyStatePro* NotifyState;
+		EAnimNotifyProType NotifyType;
+		USkeletalMeshComponent* MeshComp;
+		UAnimMontage* Montage;
+	};
+}
+
+UPlayMontageProSubsystem* UPlayMontageProSubsystem::Get(const UWorld* World)
+{
+	return World ? World->GetSubsystem<UPlayMontageProSubsystem>() : nullptr;
+}
+
+void UPlayMontageProSubsystem::ScheduleNotifies(IPlayMontageProInterface* Interface, FAnimNotifyProEvents& Events)
+{
+	UnscheduleNotifies(Events);
+
+	// Skip anything that was already broadcast out of order, e.g. a begin state broadcast by its end state
+	int32& EventIndex = Events.NextEventIndex;
+	while (Events.IsValidIndex(EventIndex) && (Events.HasBroadcast[EventIndex] || Events.Skipped[EventIndex]))
+	{
+		EventIndex++;
+	}
+
+	// The clock is paused, SetTimeDilation will schedule again once it runs
+	const float Scale = Events.Clock.GetScale();
+	if (!Events.IsValidIndex(EventIndex) || Scale <= 0.f)
+	{
+		return;
+	}
+
+	const float RemainingTime = FMath::Max(0.f, Events.Times[EventIndex] - Events.Clock.GetLocalTime(CurrentTime));
+	Events.ScheduleHandle = ++LastHandle;
+
+	FPlayMontageProScheduledNotify Entry;
+	Entry.FireTime = CurrentTime + RemainingTime / Scale;
+	Entry.Handle = Events.ScheduleHandle;
+	Entry.EventIndex = EventIndex;
+	Entry.Interface = TWeakInterfacePtr<IPlayMontageProInterface>(Interface);
+	if (ScheduleBatchDepth > 0)
+	{
+		// Ordered once by EndScheduleBatch
+		Heap.Add(MoveTemp(Entry));
+		NumBatchedEntries++;
+	}
+	else
+	{
+		Heap.HeapPush(MoveTemp(Entry));
+	}
+
+	INC_DWORD_STAT(STAT_PlayMontageProNotifiesScheduled);
+}
+
+void UPlayMontageProSubsystem::UnscheduleNotifies(FAnimNotifyProEvents& Events)
+{
+	if (Events.IsScheduled())
+	{
+		Events.ScheduleHandle = 0;
+		NumStaleEntries++;
+	}
+}
+
+void UPlayMontageProSubsystem::EndScheduleBatch()
+{
+	check(ScheduleBatchDepth > 0);
+	if (--ScheduleBatchDepth == 0 && NumBatchedEntries > 0)
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProSubsystem::EndScheduleBatch);
+
+		// Linear in the size of the heap, rather than a sift for every entry
+		Heap.Heapify();
+		NumBatchedEntries = 0;
+	}
+}
+
+void UPlayMontageProSubsystem::SetTimeDilation(IPlayMontageProInterface* Interface, FAnimNotifyProEvents& Events,
+	float TimeDilation)
+{
+	INC_DWORD_STAT(STAT_PlayMontageProTimeDilationRescales);
+	CSV_CUSTOM_STAT(PlayMontagePro, TimeDilationRescales, 1, ECsvCustomStatOp::Accumulate);
+
+	Events.Clock.SetTimeDilation(CurrentTime, TimeDilation);
+	ScheduleNotifies(Interface, Events);
+}
+
+void UPlayMontageProSubsystem::RegisterMontagePositionDispatch(IPlayMontageProInterface* Interface)
+{
+	if (Interface)
+	{
+		MontagePositionInstances.AddUnique(TWeakInterfacePtr<IPlayMontageProInterface>(Interface));
+	}
+}
+
+void UPlayMontageProSubsystem::UnregisterMontagePositionDispatch(IPlayMontageProInterface* Interface)
+{
+	// Reset rather than remove, this can be called while dispatching
+	for (TWeakInterfacePtr<IPlayMontageProInterface>& Instance : MontagePositionInstances)
+	{
+		if (Instance.Get() == Interface)
+		{
+			Instance.Reset();
+		}
+	}
+}
+
+void UPlayMontageProSubsystem::RegisterTimeDilation(IPlayMontageProInterface* Interface, const AActor* Actor,
+	float TimeDilation)
+{
+	if (Interface && Actor)
+	{
+		FPlayMontageProTimeDilationWatch& Watch = TimeDilationWatches.AddDefaulted_GetRef();
+		Watch.Actor = Actor;
+		Watch.Interface = TWeakInterfacePtr<IPlayMontageProInterface>(Interface);
+		Watch.TimeDilation = TimeDilation;
+	}
+}
+
+void UPlayMontageProSubsystem::UnregisterTimeDilation(IPlayMontageProInterface* Interface)
+{
+	// Reset rather than remove, same as UnregisterMontagePositionDispatch
+	for (FPlayMontageProTimeDilationWatch& Watch : TimeDilationWatches)
+	{
+		if (Watch.Interface.Get() == Interface)
+		{
+			Watch.Interface.Reset();
+		}
+	}
+}
+
+void UPlayMontageProSubsystem::QueueTermination(IPlayMontageProInterface* Interface, EAnimNotifyProEventType EventType,
+	UPlayMontageProCallbackProxy* ProxyToRelease)
+{
+	check(IsInGameThread());
+
+	FPlayMontageProTermination& Termination = Terminations.AddDefaulted_GetRef();
+	Termination.Interface = TWeakInterfacePtr<IPlayMontageProInterface>(Interface);
+	Termination.EventType = EventType;
+	Termination.FirstNotifyId = Interface ? Interface->GetNotifies().FirstNotifyId : 0;
+	Termination.ProxyToRelease = ProxyToRelease;
+}
+
+void UPlayMontageProSubsystem::QueueThreadSafeNotify(const UAnimNotifyPro* Notify, const UAnimNotifyStatePro* NotifyState,
+	EAnimNotifyProType NotifyType, USkeletalMeshComponent* MeshComp, UAnimMontage* Montage)
+{
+	check(IsInGameThread());
+
+	FPlayMontageProThreadSafeNotify& Entry = ThreadSafeNotifies.AddDefaulted_GetRef();
+	Entry.Notify = Notify;
+	Entry.NotifyState = NotifyState;
+	Entry.NotifyType = NotifyType;
+	Entry.MeshComp = MeshComp;
+	Entry.Montage = Montage;
+}
+
+uint32 UPlayMontageProSubsystem::RegisterNotifyStateTick(UAnimNotifyStatePro* NotifyState, USkeletalMeshComponent* MeshComp,
+	UAnimMontage* Montage, uint32 ExistingHandle)
+{
+	check(IsInGameThread());
+
+	if (!NotifyState || !MeshComp || NotifyState->TickRate == EAnimNotifyProTickRate::Disabled)
+	{
+		return 0;
+	}
+
+	// A state that begins again without having ended, e.g. when its notifies were gathered again, keeps its timing
+	if (const int32* ExistingIndex = ExistingHandle != 0 ? NotifyStateTickIndices.Find(ExistingHandle) : nullptr)
+	{
+		NotifyStateTicks[*ExistingIndex].Montage = Montage;
+		return ExistingHandle;
+	}
+
+	// 0 is never a valid handle
+	const uint32 StaggerIndex = NumNotifyStateTicksRegistered++;
+	const uint32 Handle = NumNotifyStateTicksRegistered != 0 ? NumNotifyStateTicksRegistered : ++NumNotifyStateTicksRegistered;
+	NotifyStateTickIndices.Add(Handle, NotifyStateTicks.Num());
+
+	FPlayMontageProNotifyStateTick& Entry = NotifyStateTicks.AddDefaulted_GetRef();
+	Entry.Handle = Handle;
+	Entry.NotifyState = NotifyState;
+	Entry.MeshComp = MeshComp;
+	Entry.Montage = Montage;
+	Entry.TickRate = NotifyState->TickRate;
+	Entry.LastTickTime = CurrentTime;
+	switch (Entry.TickRate)
+	{
+	case EAnimNotifyProTickRate::Frequency:
+		Entry.TickInterval = 1.f / FMath::Max(NotifyState->TickFrequency, UE_KINDA_SMALL_NUMBER);
+		Entry.NextTickTime = CurrentTime + Entry.TickInterval * FMath::Frac(StaggerIndex * PlayMontagePro::TickStaggerStep);
+		break;
+	case EAnimNotifyProTickRate::EveryNthFrame:
+		Entry.FrameInterval = FMath::Max(1, NotifyState->TickFrameInterval);
+		Entry.FramePhase = static_cast<int32>(StaggerIndex % static_cast<uint32>(Entry.FrameInterval));
+		break;
+	default:
+		break;
+	}
+	return Handle;
+}
+
+void UPlayMontageProSubsystem::UnregisterNotifyStateTick(uint32 Handle)
+{
+	// Reset rather than remove, this can be called while ticking
+	int32 Index = INDEX_NONE;
+	if (Handle != 0 && NotifyStateTickIndices.RemoveAndCopyValue(Handle, Index))
+	{
+		NotifyStateTicks[Index].NotifyState.Reset();
+		NumUnregisteredTicks++;
+	}
+}
+
+void UPlayMontageProSubsystem::UnregisterNotifyStateTicks(FAnimNotifyProEvents& Notifies)
+{
+	for (const TPair<const UAnimNotifyStatePro*, uint32>& TickHandle : Notifies.TickHandles)
+	{
+		UnregisterNotifyStateTick(TickHandle.Value);
+	}
+	Notifies.TickHandles.Reset();
+}
+
+bool UPlayMontageProSubsystem::IsSignificant(const USkeletalMeshComponent* MeshComp) const
+{
+	if (!MeshComp)
+	{
+		return true;
+	}
+
+	if (SignificanceQuery.IsBound())
+	{
+		return SignificanceQuery.Execute(MeshComp);
+	}
+
+	// Dedicated servers never render
+	if (PlayMontagePro::CullCosmeticNotRenderedTime > 0.f && !IsRunningDedicatedServer())
+	{
+		return MeshComp->WasRecentlyRendered(PlayMontagePro::CullCosmeticNotRenderedTime);
+	}
+	return true;
+}
+
+UPlayMontageProCallbackProxy* UPlayMontageProSubsystem::AcquireProxy()
+{
+	while (PooledProxies.Num() > 0)
+	{
+		if (UPlayMontageProCallbackProxy* Proxy = PooledProxies.Pop(EAllowShrinking::No))
+		{
+			NumProxiesReused++;
+			return Proxy;
+		}
+	}
+
+	NumProxiesCreated++;
+	return NewObject<UPlayMontageProCallbackProxy>();
+}
+
+void UPlayMontageProSubsystem::AcquireProxies(int32 Num, TArray<UPlayMontageProCallbackProxy*>& OutProxies)
+{
+	OutProxies.Reserve(OutProxies.Num() + Num);
+	for (int32 Index = 0; Index < Num; Index++)
+	{
+		OutProxies.Add(AcquireProxy());
+	}
+}
+
+void UPlayMontageProSubsystem::RegisterBatch(UPlayMontageProBatchCallbackProxy* Batch)
+{
+	if (Batch)
+	{
+		ActiveBatches.AddUnique(Batch);
+	}
+}
+
+void UPlayMontageProSubsystem::UnregisterBatch(UPlayMontageProBatchCallbackProxy* Batch)
+{
+	ActiveBatches.RemoveSingleSwap(Batch, EAllowShrinking::No);
+}
+
+void UPlayMontageProSubsystem::ReleaseProxy(UPlayMontageProCallbackProxy* Proxy)
+{
+	if (Proxy && PlayMontagePro::MaxPooledProxies > 0)
+	{
+		ReleasedProxies.AddUnique(Proxy);
+	}
+}
+
+FPlayMontageProProxyPoolStats UPlayMontageProSubsystem::GetProxyPoolStats() const
+{
+	FPlayMontageProProxyPoolStats Stats;
+	Stats.NumCreated = NumProxiesCreated;
+	Stats.NumReused = NumProxiesReused;
+	Stats.NumPooled = PooledProxies.Num();
+	Stats.NumPendingRelease = ReleasedProxies.Num();
+	return Stats;
+}
+
+void UPlayMontageProSubsystem::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+	Super::AddReferencedObjects(InThis, Collector);
+
+	// Keep terminated proxies alive until their notifies have been broadcast
+	UPlayMontageProSubsystem* This = CastChecked<UPlayMontageProSubsystem>(InThis);
+	for (FPlayMontageProTermination& Termination : This->Terminations)
+	{
+		Collector.AddReferencedObject(Termination.ProxyToRelease);
+	}
+	for (FPlayMontageProTermination& Termination : This->TerminationBatch)
+	{
+		Collector.AddReferencedObject(Termination.ProxyToRelease);
+	}
+}
+
+void UPlayMontageProSubsystem::Tick(float DeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProSubsystem::Tick);
+	SCOPE_CYCLE_COUNTER(STAT_PlayMontageProTick);
+	CSV_SCOPED_TIMING_STAT(PlayMontagePro, Tick);
+
+	Super::Tick(DeltaTime);
+
+	CurrentTime += DeltaTime;
+
+	RecycleReleasedProxies();
+
+	if (NumStaleEntries > PlayMontagePro::MinHeapSizeForCompaction && NumStaleEntries > Heap.Num() / 2)
+	{
+		CompactHeap();
+	}
+
+	UpdateTimeDilations();
+	DispatchDueNotifies();
+	DispatchMontagePositionNotifies();
+	DispatchTerminations();
+	DispatchThreadSafeNotifies();
+	TickNotifyStates();
+	FrameCounter++;
+
+	SET_DWORD_STAT(STAT_PlayMontageProPendingNotifies, Heap.Num());
+	SET_DWORD_STAT(STAT_PlayMontageProPooledProxies, PooledProxies.Num());
+	SET_DWORD_STAT(STAT_PlayMontageProTickingNotifyStates, NotifyStateTicks.Num());
+	CSV_CUSTOM_STAT(PlayMontagePro, PendingNotifies, Heap.Num(), ECsvCustomStatOp::Set);
+}
+
+TStatId UPlayMontageProSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPlayMontageProSubsystem, STATGROUP_Tickables);
+}
+
+void UPlayMontageProSubsystem::UpdateTimeDilations()
+{
+	if (TimeDilationWatches.Num() == 0)
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProSubsystem::UpdateTimeDilations);
+
+	bool bHasInvalidWatches = false;
+	for (FPlayMontageProTimeDilationWatch& Watch : TimeDilationWatches)
+	{
+		const AActor* Actor = Watch.Actor.Get();
+		IPlayMontageProInterface* Interface = Watch.Interface.Get();
+		if (!Actor || !Interface)
+		{
+			bHasInvalidWatches = true;
+			continue;
+		}
+
+		// Only the clock needs to change, elapsed time is maintained and the pending entry is moved
+		const float NewTimeDilation = Actor->CustomTimeDilation;
+		if (!FMath::IsNearlyEqual(Watch.TimeDilation, NewTimeDilation))
+		{
+			Watch.TimeDilation = NewTimeDilation;
+			SetTimeDilation(Interface, Interface->GetNotifies(), NewTimeDilation);
+		}
+	}
+
+	if (bHasInvalidWatches)
+	{
+		TimeDilationWatches.RemoveAllSwap([](const FPlayMontageProTimeDilationWatch& Watch)
+		{
+			return !Watch.Actor.IsValid() || !Watch.Interface.IsValid();
+		}, EAllowShrinking::No);
+	}
+}
+
+void UPlayMontageProSubsystem::DispatchDueNotifies()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProSubsystem::DispatchDueNotifies);
+
+	// Broadcasting can schedule or clear other notifies, so the entry is always popped before it is dispatched
+	while (Heap.Num() > 0 && Heap.HeapTop().FireTime <= CurrentTime)
+	{
+		FPlayMontageProScheduledNotify Entry;
+		Heap.HeapPop(Entry, EAllowShrinking::No);
+
+		if (!IsEntryValid(Entry))
+		{
+			NumStaleEntries = FMath::Max(0, NumStaleEntries - 1);
+			continue;
+		}
+
+		IPlayMontageProInterface* Interface = Entry.Interface.Get();
+		FAnimNotifyProEvents& Events = Interface->GetNotifies();
+		Events.ScheduleHandle = 0;
+		DispatchScheduledNotifies(Interface, Events, Entry.EventIndex);
+	}
+}
+
+void UPlayMontageProSubsystem::DispatchScheduledNotifies(IPlayMontageProInterface* Interface,
+	FAnimNotifyProEvents& Events, int32 DueIndex)
+{
+	const uint32 FirstNotifyId = Events.FirstNotifyId;
+	const float LocalTime = Events.Clock.GetLocalTime(CurrentTime);
+
+	// Everything up to the scheduled event is due, even if rounding puts the clock just short of it
+	while (Events.IsValidIndex(Events.NextEventIndex)
+		&& (Events.NextEventIndex <= DueIndex || Events.Times[Events.NextEventIndex] <= LocalTime))
+	{
+		const int32 EventIndex = Events.NextEventIndex++;
+		if (!Events.HasBroadcast[EventIndex] && !Events.Skipped[EventIndex])
+		{
+			PlayMontagePro::RecordNotifyDispatch(EAnimNotifyProDispatchMode::Timer, Events.GetNotifyId(EventIndex),
+				Events.Clock.GetTime(Events.Times[EventIndex]), CurrentTime);
+		}
+		Interface->BroadcastNotifyEvent(EventIndex);
+
+		// Stop if the callbacks gathered the notifies again or scheduled them themselves
+		if (Events.FirstNotifyId != FirstNotifyId || Events.IsScheduled())
+		{
+			return;
+		}
+
+#if !UE_BUILD_SHIPPING
+		if (PlayMontagePro::Validation::IsEnabled())
+		{
+			PlayMontagePro::Validation::ValidateDispatched(Events, EventIndex, EAnimNotifyProDispatchMode::Timer);
+		}
+#endif
+	}
+
+	ScheduleNotifies(Interface, Events);
+}
+
+void UPlayMontageProSubsystem::DispatchMontagePositionNotifies()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProSubsystem::DispatchMontagePositionNotifies);
+
+	// Instances registered while dispatching are appended and ticked in the same pass
+	for (int32 InstanceIndex = 0; InstanceIndex < MontagePositionInstances.Num(); InstanceIndex++)
+	{
+		if (IPlayMontageProInterface* Interface = MontagePositionInstances[InstanceIndex].Get())
+		{
+			Interface->TickMontagePosition();
+		}
+	}
+
+	MontagePositionInstances.RemoveAllSwap([](const TWeakInterfacePtr<IPlayMontageProInterface>& Instance)
+	{
+		return !Instance.IsValid();
+	}, EAllowShrinking::No);
+}
+
+void UPlayMontageProSubsystem::DispatchTerminations()
+{
+	if (Terminations.Num() == 0)
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProSubsystem::DispatchTerminations);
+
+	// Callbacks may terminate other montages, those are dispatched in the next pass
+	while (Terminations.Num() > 0)
+	{
+		Swap(Terminations, TerminationBatch);
+
+		// Resolve on the game thread, the gather only reads each instance's own events
+		TArray<FAnimNotifyProEvents*, TInlineAllocator<64>> Events;
+		Events.SetNumUninitialized(TerminationBatch.Num());
+		for (int32 Index = 0; Index < TerminationBatch.Num(); Index++)
+		{
+			const FPlayMontageProTermination& Termination = TerminationBatch[Index];
+			IPlayMontageProInterface* Interface = Termination.EventType != EAnimNotifyProEventType::None ? Termination.Interface.Get() : nullptr;
+			FAnimNotifyProEvents* InstanceEvents = Interface ? &Interface->GetNotifies() : nullptr;
+			Events[Index] = InstanceEvents && InstanceEvents->FirstNotifyId == Termination.FirstNotifyId ? InstanceEvents : nullptr;
+		}
+
+		if (TerminationIndices.Num() < TerminationBatch.Num())
+		{
+			TerminationIndices.SetNum(TerminationBatch.Num());
+		}
+
+		ParallelFor(TEXT("PlayMontagePro.Terminations"), TerminationBatch.Num(), PlayMontagePro::TerminationMinBatchSize,
+			[this, &Events](int32 Index)
+		{
+			if (Events[Index])
+			{
+				UPlayMontageProStatics::GatherEnsureNotifyEvents(TerminationBatch[Index].EventType, *Events[Index], TerminationIndices[Index]);
+			}
+			else
+			{
+				TerminationIndices[Index].Reset();
+			}
+		});
+
+		// Broadcast in the order the montages terminated
+		for (int32 Index = 0; Index < TerminationBatch.Num(); Index++)
+		{
+			const FPlayMontageProTermination& Termination = TerminationBatch[Index];
+			if (TerminationIndices[Index].Num() > 0)
+			{
+				// An earlier termination's callbacks may have destroyed the owner, changed its section or reset it
+				IPlayMontageProInterface* Interface = Termination.Interface.Get();
+				if (Interface && Interface->GetNotifies().FirstNotifyId == Termination.FirstNotifyId)
+				{
+					UPlayMontageProStatics::BroadcastEnsureNotifyEvents(Termination.EventType, Interface->GetNotifies(),
+						TerminationIndices[Index], Interface);
+				}
+			}
+
+			// Nothing else will be broadcast, the proxy can be reused
+			if (Termination.ProxyToRelease)
+			{
+				ReleaseProxy(Termination.ProxyToRelease);
+			}
+		}
+
+		TerminationBatch.Reset();
+	}
+}
+
+void UPlayMontageProSubsystem::DispatchThreadSafeNotifies()
+{
+	if (ThreadSafeNotifies.Num() > 0)
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProSubsystem::DispatchThreadSafeNotifies);
+
+		using namespace PlayMontagePro;
+
+		// Resolve on the game thread, and group by mesh so each mesh's callbacks keep their order on a single worker
+		TArray<FResolvedThreadSafeNotify, TInlineAllocator<64>> Resolved;
+		Resolved.Reserve(ThreadSafeNotifies.Num());
+		for (const FPlayMontageProThreadSafeNotify& Entry : ThreadSafeNotifies)
+		{
+			const UAnimNotifyPro* Notify = Entry.Notify.Get();
+			const UAnimNotifyStatePro* NotifyState = Entry.NotifyState.Get();
+			if (Notify || NotifyState)
+			{
+				Resolved.Add({ Notify, NotifyState, Entry.NotifyType, Entry.MeshComp.Get(), Entry.Montage.Get() });
+			}
+		}
+		ThreadSafeNotifies.Reset();
+
+		Algo::StableSortBy(Resolved, [](const FResolvedThreadSafeNotify& Entry) { return reinterpret_cast<UPTRINT>(Entry.MeshComp); });
+
+		TArray<int32, TInlineAllocator<64>> GroupStarts;
+		for (int32 Index = 0; Index < Resolved.Num(); Index++)
+		{
+			if (Index == 0 || Resolved[Index].MeshComp != Resolved[Index - 1].MeshComp)
+			{
+				GroupStarts.Add(Index);
+			}
+		}
+		GroupStarts.Add(Resolved.Num());
+
+		ParallelFor(TEXT("PlayMontagePro.ThreadSafeNotifies"), GroupStarts.Num() - 1, ThreadSafeNotifyMinBatchSize,
+			[this, &Resolved, &GroupStarts](int32 GroupIndex)
+		{
+			for (int32 Index = GroupStarts[GroupIndex]; Index < GroupStarts[GroupIndex + 1]; Index++)
+			{
+				const FResolvedThreadSafeNotify& Entry = Resolved[Index];
+				switch (Entry.NotifyType)
+				{
+				case EAnimNotifyProType::Notify:
+					Entry.Notify->OnNotifyAnyThread(Entry.MeshComp, Entry.Montage, this);
+					break;
+				case EAnimNotifyProType::NotifyStateBegin:
+					Entry.NotifyState->OnNotifyBeginAnyThread(Entry.MeshComp, Entry.Montage, this);
+					break;
+				case EAnimNotifyProType::NotifyStateEnd:
+					Entry.NotifyState->OnNotifyEndAnyThread(Entry.MeshComp, Entry.Montage, this);
+					break;
+				}
+			}
+		});
+	}
+
+	// Follow-up work, queued by the batch or from other threads since the last tick
+	TUniqueFunction<void()> Task;
+	while (GameThreadTasks.Dequeue(Task))
+	{
+		Task();
+	}
+}
+
+void UPlayMontageProSubsystem::TickNotifyStates()
+{
+	if (NotifyStateTicks.Num() == 0)
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProSubsystem::TickNotifyStates);
+
+	// States registered by a tick are appended and first ticked next frame, as no time has passed for them yet
+	const int32 NumTicks = NotifyStateTicks.Num();
+	int32 NumTicked = 0;
+	for (int32 TickIndex = 0; TickIndex < NumTicks; TickIndex++)
+	{
+		// Not used once the state ticks, which may grow the array
+		FPlayMontageProNotifyStateTick& Entry = NotifyStateTicks[TickIndex];
+		bool bDue = false;
+		switch (Entry.TickRate)
+		{
+		case EAnimNotifyProTickRate::EveryFrame:
+			bDue = true;
+			break;
+		case EAnimNotifyProTickRate::Frequency:
+			if (CurrentTime >= Entry.NextTickTime)
+			{
+				// Catch up without ticking more than once per frame
+				Entry.NextTickTime = FMath::Max(Entry.NextTickTime + Entry.TickInterval, CurrentTime);
+				bDue = true;
+			}
+			break;
+		case EAnimNotifyProTickRate::EveryNthFrame:
+			bDue = (FrameCounter + Entry.FramePhase) % Entry.FrameInterval == 0;
+			break;
+		default:
+			break;
+		}
+
+		const float DeltaTime = static_cast<float>(CurrentTime - Entry.LastTickTime);
+		if (!bDue || DeltaTime <= 0.f)
+		{
+			continue;
+		}
+
+		UAnimNotifyStatePro* NotifyState = Entry.NotifyState.Get();
+		USkeletalMeshComponent* MeshComp = Entry.MeshComp.Get();
+		UAnimMontage* Montage = Entry.Montage.Get();
+
+		// The state's end may never be broadcast if its montage stopped without ensuring it, so stop with the montage
+		const UAnimInstance* AnimInstance = MeshComp ? MeshComp->GetAnimInstance() : nullptr;
+		if (!NotifyState || !AnimInstance || !Montage || !AnimInstance->Montage_IsActive(Montage))
+		{
+			NotifyStateTickIndices.Remove(Entry.Handle);
+			Entry.NotifyState.Reset();
+			NumUnregisteredTicks++;
+			continue;
+		}
+
+		Entry.LastTickTime = CurrentTime;
+		NotifyState->OnNotifyTick(MeshComp, Montage, DeltaTime);
+		NumTicked++;
+	}
+
+	INC_DWORD_STAT_BY(STAT_PlayMontageProNotifyStateTicks, NumTicked);
+
+	// Includes states unregistered by the ticks themselves
+	// Walked backwards so every entry swapped into a removed one's place has already been kept
+	if (NumUnregisteredTicks > 0)
+	{
+		for (int32 TickIndex = NotifyStateTicks.Num() - 1; TickIndex >= 0; TickIndex--)
+		{
+			if (!NotifyStateTicks[TickIndex].NotifyState.IsValid())
+			{
+				NotifyStateTickIndices.Remove(NotifyStateTicks[TickIndex].Handle);
+				NotifyStateTicks.RemoveAtSwap(TickIndex, 1, EAllowShrinking::No);
+				if (NotifyStateTicks.IsValidIndex(TickIndex))
+				{
+					NotifyStateTickIndices.FindChecked(NotifyStateTicks[TickIndex].Handle) = TickIndex;
+				}
+			}
+		}
+		NumUnregisteredTicks = 0;
+	}
+}
+
+void UPlayMontageProSubsystem::CompactHeap()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProSubsystem::CompactHeap);
+
+	Heap.RemoveAllSwap([](const FPlayMontageProScheduledNotify& Entry)
+	{
+		return !IsEntryValid(Entry);
+	}, EAllowShrinking::No);
+
+	Heap.Heapify();
+	NumStaleEntries = 0;
+}
+
+void UPlayMontageProSubsystem::RecycleReleasedProxies()
+{
+	if (ReleasedProxies.Num() == 0)
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPlayMontageProSubsystem::RecycleReleasedProxies);
+
+	for (UPlayMontageProCallbackProxy* Proxy : ReleasedProxies)
+	{
+		if (Proxy && PooledProxies.Num() < PlayMontagePro::MaxPooledProxies)
+		{
+			Proxy->ResetProxy();
+			PooledProxies.Add(Proxy);
+		}
+	}
+	ReleasedProxies.Reset();
+}
+
+bool UPlayMontageProSubsystem::IsEntryValid(const FPlayMontageProScheduledNotify& Entry)
+{
+	IPlayMontageProInterface* Interface = Entry.Interface.Get();
+	if (!Interface)
+	{
+		return false;
+	}
+
+	const FAnimNotifyProEvents& Notifies = Interface->GetNotifies();
+	return Notifies.IsValidIndex(Entry.EventIndex) && Notifies.ScheduleHandle == Entry.Handle;
+}
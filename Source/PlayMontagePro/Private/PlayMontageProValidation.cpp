@@ -0,0 +1,83 @@
+// Copyright (c) Jared Taylor
+
+#include "PlayMontageProValidation.h"
+
+#include "AnimNotifyProTable.h"
+#include "PlayMontagePro.h"
+#include "Animation/AnimSequenceBase.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/ObjectKey.h"
+
+#if !UE_BUILD_SHIPPING
+namespace PlayMontagePro::Validation
+{
+	static bool bValidateNotifies = false;
+	static FAutoConsoleVariableRef CVarValidateNotifies(
+		TEXT("a.PlayMontagePro.ValidateNotifies"),
+		bValidateNotifies,
+		TEXT("Checks the ordering guarantees of Pro notifies as they are dispatched: begin before end, nothing left pending once crossed, and ensured notifies triggered on termination."),
+		ECVF_Cheat);
+
+	/** @return Whether the event can no longer be broadcast */
+	static bool IsResolved(const FAnimNotifyProEvents& Notifies, int32 NotifyIndex)
+	{
+		if (Notifies.HasBroadcast[NotifyIndex] || Notifies.Skipped[NotifyIndex])
+		{
+			return true;
+		}
+
+		// End states are never broadcast once their begin state was skipped
+		const int32 PairIndex = Notifies.Table->PairIndices[NotifyIndex];
+		return Notifies.IsEndState(NotifyIndex) && Notifies.IsValidIndex(PairIndex) && Notifies.Skipped[PairIndex];
+	}
+
+	bool IsEnabled()
+	{
+		return bValidateNotifies;
+	}
+
+	void ValidateBroadcast(const FAnimNotifyProEvents& Notifies, int32 NotifyIndex)
+	{
+		const int32 PairIndex = Notifies.Table->PairIndices[NotifyIndex];
+		if (Notifies.IsEndState(NotifyIndex) && Notifies.IsValidIndex(PairIndex))
+		{
+			ensureMsgf(Notifies.HasBroadcast[PairIndex], TEXT("Pro notify state end %u was broadcast before its begin state %u"),
+				Notifies.GetNotifyId(NotifyIndex), Notifies.GetNotifyId(PairIndex));
+		}
+	}
+
+	void ValidateDispatched(const FAnimNotifyProEvents& Notifies, int32 NotifyIndex, EAnimNotifyProDispatchMode DispatchMode)
+	{
+		ensureMsgf(IsResolved(Notifies, NotifyIndex), TEXT("Pro notify %u was dispatched by %s but is still pending"),
+			Notifies.GetNotifyId(NotifyIndex), *UEnum::GetValueAsString(DispatchMode));
+	}
+
+	void ValidateEnsureBroadcast(const FAnimNotifyProEvents& Notifies, EAnimNotifyProEventType EventType)
+	{
+		for (int32 NotifyIndex = 0; NotifyIndex < Notifies.Num(); NotifyIndex++)
+		{
+			const bool bEnsureTrigger = EnumHasAnyFlags(static_cast<EAnimNotifyProEventType>(Notifies.Table->EnsureTriggerNotify[NotifyIndex]), EventType);
+			const int32 PairIndex = Notifies.Table->PairIndices[NotifyIndex];
+			const bool bEnsureEndState = Notifies.IsEndState(NotifyIndex) && Notifies.IsValidIndex(PairIndex) && Notifies.HasBroadcast[PairIndex];
+			if (bEnsureTrigger || bEnsureEndState)
+			{
+				ensureMsgf(IsResolved(Notifies, NotifyIndex), TEXT("Pro notify %u was not triggered for %s"),
+					Notifies.GetNotifyId(NotifyIndex), *UEnum::GetValueAsString(EventType));
+			}
+		}
+	}
+
+	void WarnOutsideMontage(const UObject* Notify, const UAnimSequenceBase* Animation)
+	{
+		// Anim notifies are dispatched on the game thread
+		static TSet<FObjectKey> WarnedNotifies;
+		bool bAlreadyWarned = false;
+		WarnedNotifies.Add(FObjectKey(Notify), &bAlreadyWarned);
+		if (!bAlreadyWarned)
+		{
+			UE_LOG(LogPlayMontagePro, Warning, TEXT("Pro notify %s was triggered by %s outside of a montage, it is only triggered on simulated proxies with Legacy behavior. Play the animation with PlayMontagePro instead."),
+				*GetPathNameSafe(Notify), *GetNameSafe(Animation));
+		}
+	}
+}
+#endif
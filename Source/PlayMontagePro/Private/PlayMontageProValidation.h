@@ -0,0 +1,35 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PlayMontageTypes.h"
+
+class UAnimSequenceBase;
+struct FAnimNotifyProEvents;
+
+#if !UE_BUILD_SHIPPING
+/**
+ * Runtime checks for the ordering guarantees of the Pro notify pipeline, enabled with a.PlayMontagePro.ValidateNotifies.
+ * Each check raises an ensure when violated, so they can be left on in stress and soak runs.
+ */
+namespace PlayMontagePro::Validation
+{
+	bool IsEnabled();
+
+	/** A notify state end must never be broadcast before its begin state */
+	void ValidateBroadcast(const FAnimNotifyProEvents& Notifies, int32 NotifyIndex);
+
+	/** An event that was dispatched must have been broadcast or skipped, never left pending */
+	void ValidateDispatched(const FAnimNotifyProEvents& Notifies, int32 NotifyIndex, EAnimNotifyProDispatchMode DispatchMode);
+
+	/** Every event that ensures EventType, and every end state whose begin state was broadcast, must have been broadcast */
+	void ValidateEnsureBroadcast(const FAnimNotifyProEvents& Notifies, EAnimNotifyProEventType EventType);
+
+	/**
+	 * Warns once per notify that it was triggered by an animation playing outside of a montage, where it is never scheduled.
+	 * Not gated by a.PlayMontagePro.ValidateNotifies, as the notify silently does nothing on authority and the autonomous proxy.
+	 */
+	void WarnOutsideMontage(const UObject* Notify, const UAnimSequenceBase* Animation);
+}
+#endif
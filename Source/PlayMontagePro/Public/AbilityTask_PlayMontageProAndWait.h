@@ -0,0 +1,165 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnimNotifyProTable.h"
+#include "PlayMontageProCallbackProxy.h"
+#include "PlayMontageProInterface.h"
+#include "Abilities/Tasks/AbilityTask.h"
+#include "Animation/AnimInstance.h"
+#include "AbilityTask_PlayMontageProAndWait.generated.h"
+
+class UAnimMontage;
+class USkeletalMeshComponent;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FPlayMontageProWaitSimpleDelegate);
+
+/**
+ * Ability task that plays a montage through the ability system component and triggers Pro notifies, without a separate proxy.
+ * The montage is played like UAbilityTask_PlayMontageAndWait, so it is predicted on the owning client and replicated by the
+ * ability system component. Pro notifies are gathered once from the shared compiled table and scheduled from the predicted start.
+ * The predicted start is never corrected: the owning client doesn't receive the server's montage position, so its notifies keep
+ * the timing of the local montage even if the server started it later.
+ * Notifies are dispatched with EAnimNotifyProDispatchMode::Timer.
+ */
+UCLASS()
+class PLAYMONTAGEPRO_API UAbilityTask_PlayMontageProAndWait : public UAbilityTask, public IPlayMontageProInterface
+{
+	GENERATED_UCLASS_BODY()
+
+	UPROPERTY(BlueprintAssignable)
+	FPlayMontageProWaitSimpleDelegate OnCompleted;
+
+	UPROPERTY(BlueprintAssignable)
+	FPlayMontageProWaitSimpleDelegate OnBlendOut;
+
+	UPROPERTY(BlueprintAssignable)
+	FPlayMontageProWaitSimpleDelegate OnInterrupted;
+
+	UPROPERTY(BlueprintAssignable)
+	FPlayMontageProWaitSimpleDelegate OnCancelled;
+
+	UPROPERTY(BlueprintAssignable)
+	FOnMontagePlayNotifyDelegate OnNotify;
+
+	UPROPERTY(BlueprintAssignable)
+	FOnMontagePlayNotifyDelegate OnNotifyStateBegin;
+
+	UPROPERTY(BlueprintAssignable)
+	FOnMontagePlayNotifyDelegate OnNotifyStateEnd;
+
+	/**
+	 * Start playing an animation montage on the avatar actor and wait for it to finish, triggering Pro notifies along the way.
+	 * @param TaskInstanceName Set to override the name of this task, for later querying.
+	 * @param MontageToPlay The montage to play on the character.
+	 * @param Rate Change to play the montage faster or slower.
+	 * @param StartSection If not empty, named montage section to start from.
+	 * @param bStopWhenAbilityEnds If true, this montage will be aborted if the ability ends normally. It is always stopped when the ability is explicitly cancelled.
+	 * @param AnimRootMotionTranslationScale Change to modify size of root motion or set to 0 to block it entirely.
+	 * @param StartTimeSeconds Starting time offset in montage, this will be overridden by StartSection if that is also set.
+	 * @param bAllowInterruptAfterBlendOut If true, you can receive OnInterrupted after an OnBlendOut started (otherwise OnInterrupted will not fire when interrupted, but you will not get OnComplete).
+	 * @param bTriggerNotifiesBeforeStartTime Whether to trigger notifies before the starting position.
+	 * @param bEnableCustomTimeDilation Whether the notifies follow the avatar's CustomTimeDilation, picked up once per frame by UPlayMontageProSubsystem.
+	 */
+	UFUNCTION(BlueprintCallable, Category="Ability|Tasks", meta = (DisplayName="PlayMontageProAndWait",
+		HidePin = "OwningAbility", DefaultToSelf = "OwningAbility", BlueprintInternalUseOnly = "TRUE"))
+	static UAbilityTask_PlayMontageProAndWait* CreatePlayMontageProAndWaitProxy(UGameplayAbility* OwningAbility,
+		FName TaskInstanceName,
+		UAnimMontage* MontageToPlay,
+		float Rate = 1.f,
+		FName StartSection = NAME_None,
+		bool bStopWhenAbilityEnds = true,
+		float AnimRootMotionTranslationScale = 1.f,
+		float StartTimeSeconds = 0.f,
+		bool bAllowInterruptAfterBlendOut = false,
+		bool bTriggerNotifiesBeforeStartTime = false,
+		bool bEnableCustomTimeDilation = false);
+
+	// Begin UGameplayTask
+	virtual void Activate() override;
+	virtual void ExternalCancel() override;
+	virtual FString GetDebugString() const override;
+	// ~End UGameplayTask
+
+	// Begin IPlayMontageProInterface
+	virtual void BroadcastNotifyEvent(int32 NotifyIndex) override { UPlayMontageProStatics::BroadcastNotifyEvent(Notifies, NotifyIndex, this); }
+	virtual void NotifyCallback(const FAnimNotifyProEvent& Event) override;
+	virtual void NotifyBeginCallback(const FAnimNotifyProEvent& Event) override;
+	virtual void NotifyEndCallback(const FAnimNotifyProEvent& Event) override;
+	virtual bool WantsNotifyEvents() const override;
+
+	virtual UAnimMontage* GetMontage() const override final { return MontageToPlay; }
+	virtual USkeletalMeshComponent* GetMesh() const override final { return MeshComp.Get(); }
+
+	virtual FAnimNotifyProEvents& GetNotifies() override final { return Notifies; }
+	virtual bool IsSignificant() const override;
+	// ~End IPlayMontageProInterface
+
+protected:
+	virtual void OnDestroy(bool bInOwnerFinished) override;
+
+	void OnMontageBlendingOut(UAnimMontage* Montage, bool bInterrupted);
+	void OnMontageEnded(UAnimMontage* Montage, bool bInterrupted);
+	void OnGameplayAbilityCancelled();
+
+	UFUNCTION()
+	void OnMontageSectionChanged(UAnimMontage* Montage, FName SectionName, bool bLooped);
+
+	/** Gathers the notifies of the section at Position and schedules them */
+	void GatherAndScheduleNotifies(bool bTriggerPassedNotifies);
+
+	/** Stops dispatching notifies and ensures the ones that must trigger for EventType, inline since the task is destroyed right after */
+	void StopNotifies(EAnimNotifyProEventType EventType);
+
+	/** Checks if the ability is playing a montage and stops that montage, returns true if a montage was stopped, false if not. */
+	bool StopPlayingMontage();
+
+	FOnMontageBlendingOutStarted BlendingOutDelegate;
+	FOnMontageEnded MontageEndedDelegate;
+	FDelegateHandle InterruptedHandle;
+
+	UPROPERTY()
+	TObjectPtr<UAnimMontage> MontageToPlay;
+
+	TWeakObjectPtr<USkeletalMeshComponent> MeshComp;
+	TWeakObjectPtr<UAnimInstance> AnimInstancePtr;
+
+	UPROPERTY()
+	float Rate;
+
+	UPROPERTY()
+	FName StartSection;
+
+	UPROPERTY()
+	float AnimRootMotionTranslationScale;
+
+	UPROPERTY()
+	float StartTimeSeconds;
+
+	UPROPERTY()
+	bool bStopWhenAbilityEnds;
+
+	UPROPERTY()
+	bool bAllowInterruptAfterBlendOut;
+
+	UPROPERTY()
+	bool bTriggerNotifiesBeforeStartTime;
+
+	UPROPERTY()
+	bool bEnableCustomTimeDilation;
+
+	/** Runtime state of the notifies in the current section */
+	FAnimNotifyProEvents Notifies;
+
+	uint32 NotifyId = 0;
+
+	/** Time dilation the notifies' clock is running at */
+	float TimeDilation = 1.f;
+
+	/** Whether the notifies' clock follows the avatar's CustomTimeDilation */
+	bool bFollowTimeDilation = false;
+
+	/** Whether the notifies have stopped, nothing is dispatched or ensured after this */
+	bool bNotifiesStopped = true;
+};
@@ -7,10 +7,16 @@
 #include "Animation/AnimNotifies/AnimNotify.h"
 #include "AnimNotifyPro.generated.h"
 
+class UPlayMontageProSubsystem;
+
 /**
  * Base class for anim notifies that can be used with PlayMontagePro.
  * Uses timers to ensure that notifies are triggered at the correct time.
  * Unlike Epic's UAnimNotify, which is not guaranteed to trigger.
+ *
+ * Only montages played with PlayMontagePro schedule these. On a sequence they trigger when the sequence is played by the
+ * montage's first slot track, a sequence played directly, e.g. by an anim graph, never triggers them on authority or the
+ * autonomous proxy, only on simulated proxies with the Legacy SimulatedProxyBehavior. A warning is logged when that happens.
  */
 UCLASS(Abstract, Blueprintable, const)
 class PLAYMONTAGEPRO_API UAnimNotifyPro : public UAnimNotify
@@ -30,6 +36,21 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=AnimNotify)
 	EAnimNotifyLegacyType SimulatedProxyBehavior = EAnimNotifyLegacyType::Legacy;
 
+	/**
+	 * Cosmetic notifies are not scheduled for montages whose owner is not significant when the notifies are gathered,
+	 * see UPlayMontageProSubsystem::SignificanceQuery. Notifies that ensure they are triggered are never skipped.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=AnimNotify, AdvancedDisplay)
+	EAnimNotifyProSignificance Significance = EAnimNotifyProSignificance::Critical;
+
+	/**
+	 * Call OnNotifyAnyThread instead of OnNotify, batched with every other thread safe notify and run on task graph workers.
+	 * Only for native notifies, anything that must run on the game thread can be queued with UPlayMontageProSubsystem::EnqueueGameThreadTask.
+	 * Blueprint notifies fail validation with this enabled, as K2_OnNotify would never be called.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=AnimNotify, AdvancedDisplay)
+	bool bThreadSafeCallback = false;
+
 #if WITH_EDITORONLY_DATA
 
 protected:
@@ -52,14 +73,33 @@ public:
 	
 	virtual void NotifyCallback(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage);
 	virtual void OnNotify(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage);
+
+	/**
+	 * Called instead of OnNotify when bThreadSafeCallback is enabled, may run on any thread.
+	 * Notifies of the same mesh run in order on the same thread.
+	 * MeshComp and Montage must only be read, the game thread and other notifies may be using them at the same time.
+	 * @param Subsystem The subsystem that dispatched the notify, null if it was called inline on the game thread.
+	 */
+	virtual void OnNotifyAnyThread(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage, UPlayMontageProSubsystem* Subsystem) const {}
 	
 	UFUNCTION(BlueprintImplementableEvent, meta=(DisplayName="On Notify"))
 	bool K2_OnNotify(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage) const;
 
+protected:
+	void QueueThreadSafeCallback(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage) const;
+
+	/** @return Whether K2_OnNotify is implemented in Blueprint, calling it otherwise only goes through reflection to do nothing */
+	bool ImplementsK2OnNotify() const;
+
+private:
+	/** Looked up on first use, the Blueprint class may not be fully linked yet when the notify is constructed */
+	mutable uint8 bCachedImplementsK2OnNotify : 1;
+	mutable uint8 bImplementsK2OnNotify : 1;
+
+public:
+
 #if WITH_EDITOR
-	virtual bool CanBePlaced(UAnimSequenceBase* Animation) const override
-	{
-		return Animation && Animation->IsA(UAnimMontage::StaticClass());
-	}
+	/** Montages, and sequences played by a montage's slot segments, whose notifies are flattened into the montage's notify table */
+	virtual bool CanBePlaced(UAnimSequenceBase* Animation) const override;
 #endif
 };
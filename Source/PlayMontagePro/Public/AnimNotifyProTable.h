@@ -0,0 +1,308 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PlayMontageTypes.h"
+#include "UObject/ObjectKey.h"
+
+class UAnimMontage;
+class UAnimSequenceBase;
+class UAnimNotifyPro;
+class UAnimNotifyStatePro;
+
+/**
+ * Compiled Pro notify events for a single montage section, stored as sorted parallel arrays.
+ * Notify states are included in every section, notifies only in the section they are placed in.
+ * Immutable once built and shared between every instance playing the montage.
+ */
+struct PLAYMONTAGEPRO_API FAnimNotifyProSectionTable
+{
+	/** Montage position of each event, sorted ascending */
+	TArray<float> Positions;
+
+	/** Type of each event */
+	TArray<EAnimNotifyProType> Types;
+
+	/** Index of the paired begin or end state event, INDEX_NONE for notifies */
+	TArray<int32> PairIndices;
+
+	/** EAnimNotifyProEventType conditions that ensure each event is triggered if the montage aborts before it is reached */
+	TArray<uint8> EnsureTriggerNotify;
+
+	/** Notify for each event, null for notify states */
+	TArray<TWeakObjectPtr<UAnimNotifyPro>> Notifies;
+
+	/** Notify state for each event, null for notifies */
+	TArray<TWeakObjectPtr<UAnimNotifyStatePro>> NotifyStates;
+
+	/** Montage each event was gathered from, 0 for the table's own montage, otherwise 1 + the index of the driven montage it was merged from */
+	TArray<uint8> Sources;
+
+	/** Number of EAnimNotifyProEventType conditions, excluding None */
+	static constexpr int32 NumEnsureReasons = 4;
+
+	/** Bit per event, 32 events per word, set if the event ensures it is triggered for the EAnimNotifyProEventType with that bit index */
+	TArray<uint32> EnsureMasks[NumEnsureReasons];
+
+	/** Bit per event, 32 events per word, set for notify state end events */
+	TArray<uint32> EndStateMask;
+
+	/** Bit per event, 32 events per word, set for cosmetic events that do not ensure they are triggered */
+	TArray<uint32> CosmeticMask;
+
+	int32 Num() const { return Positions.Num(); }
+	int32 NumWords() const { return EndStateMask.Num(); }
+};
+
+/**
+ * Driven montage whose notifies are merged into a driver montage's table.
+ * @see FAnimNotifyProTableCache::GetMerged
+ */
+struct PLAYMONTAGEPRO_API FAnimNotifyProDrivenSource
+{
+	const UAnimMontage* Montage = nullptr;
+
+	/** Driver montage position per driven montage position, i.e. the driver's length over the driven length when their durations are matched */
+	float PositionScale = 1.f;
+};
+
+/**
+ * Compiled Pro notify events for every section of a montage.
+ * Built once by FAnimNotifyProTableCache and invalidated when the montage is edited.
+ * Notifies placed in the animations played by the montage's first slot track are flattened in at the montage position they are reached at.
+ * A table may also contain the notifies of driven montages, placed at the driver montage position they are reached at.
+ */
+struct PLAYMONTAGEPRO_API FAnimNotifyProMontageTable
+{
+	/** One table per montage section, indexed by section index */
+	TArray<FAnimNotifyProSectionTable> Sections;
+
+	/** Table used when the section is not valid, contains only notify states */
+	FAnimNotifyProSectionTable InvalidSection;
+
+	/** Start time of every section, sorted ascending */
+	TArray<float> SectionStartTimes;
+
+	/** Section index for each entry in SectionStartTimes */
+	TArray<int32> SortedSectionIndices;
+
+	/** Montage the table was built from */
+	TObjectKey<UAnimMontage> Montage;
+
+	/** Driven montages merged into the table, indexed by event source - 1 */
+	TArray<TObjectKey<UAnimMontage>> DrivenMontages;
+
+	/** FAnimNotifyProDrivenSource::PositionScale for each of DrivenMontages */
+	TArray<float> DrivenPositionScales;
+
+	/** Animations played by the montages' segments whose notifies were flattened into the table, which is invalidated when they are edited */
+	TArray<TObjectKey<UAnimSequenceBase>> Animations;
+
+	const FAnimNotifyProSectionTable& GetSection(int32 SectionIndex) const
+	{
+		return Sections.IsValidIndex(SectionIndex) ? Sections[SectionIndex] : InvalidSection;
+	}
+
+	/** @return Index of the section containing Position, found by binary search on the section start times, or INDEX_NONE */
+	int32 FindSectionIndex(float Position) const;
+
+	/** @return Whether the table was built from Montage and exactly these driven montages */
+	bool Matches(const UAnimMontage* InMontage, TConstArrayView<FAnimNotifyProDrivenSource> DrivenSources) const;
+
+	/** Builds the table from the montage's notifies, merging in the notifies of any driven montages */
+	static TSharedRef<FAnimNotifyProMontageTable> Build(const UAnimMontage* Montage, TConstArrayView<FAnimNotifyProDrivenSource> DrivenSources = {});
+};
+
+/**
+ * Maps scheduler time to montage time for a single playing montage.
+ * Event times are stored in montage time, so changing the rate only re-anchors the clock instead of rescheduling every event.
+ */
+struct PLAYMONTAGEPRO_API FAnimNotifyProClock
+{
+	/** Scheduler time at which the clock was last anchored */
+	double AnchorTime = 0.0;
+
+	/** Montage time elapsed at AnchorTime */
+	float AnchorLocalTime = 0.f;
+
+	/** Play rate of the montage, including the montage's rate scale */
+	float PlayRate = 1.f;
+
+	/** Custom time dilation of the owning actor */
+	float TimeDilation = 1.f;
+
+	/** @return Montage seconds elapsed per scheduler second, the clock is paused if this is not positive */
+	float GetScale() const { return PlayRate * TimeDilation; }
+
+	/** @return Montage time elapsed at the scheduler time */
+	float GetLocalTime(double Time) const { return AnchorLocalTime + static_cast<float>(Time - AnchorTime) * GetScale(); }
+
+	/** @return Scheduler time at which the montage time is reached, only meaningful while the scale is positive */
+	double GetTime(float LocalTime) const { return AnchorTime + (LocalTime - AnchorLocalTime) / GetScale(); }
+
+	void Anchor(double Time, float LocalTime)
+	{
+		AnchorTime = Time;
+		AnchorLocalTime = LocalTime;
+	}
+
+	/** Changes the time dilation from the scheduler time onwards, montage time already elapsed is unaffected */
+	void SetTimeDilation(double Time, float NewTimeDilation)
+	{
+		Anchor(Time, GetLocalTime(Time));
+		TimeDilation = NewTimeDilation;
+	}
+};
+
+/**
+ * Integer tick clock for EAnimNotifyProDispatchMode::FixedStep, advanced by the owner rather than the world.
+ * Events trigger on whole ticks, so they land on the same tick wherever the montage is simulated regardless of frame rate.
+ */
+struct PLAYMONTAGEPRO_API FAnimNotifyProFixedStepClock
+{
+	static constexpr int32 DefaultTickRate = 60;
+
+	/** Ticks per second */
+	int32 TickRate = DefaultTickRate;
+
+	/** Tick the clock was last advanced or rewound to, events up to and including it have triggered */
+	int32 CurrentTick = 0;
+
+	/** Tick on which each event triggers, sorted ascending, 0 for events handled by HandleHistoricNotifies */
+	TArray<int32> FireTicks;
+
+	/** @return First tick at which LocalTime of montage time has elapsed, at Scale montage seconds per second */
+	static int32 GetTick(float LocalTime, float Scale, int32 TickRate);
+};
+
+/**
+ * Runtime state of the Pro notify events of a single playing montage section.
+ * Everything static is read from the shared FAnimNotifyProSectionTable, only the per-instance state is stored here
+ * as packed arrays indexed like the table, so scanning it touches a few bytes per event.
+ * The Blueprint-facing FAnimNotifyProEvent is only built by MakeEvent when a callback is broadcast.
+ */
+struct PLAYMONTAGEPRO_API FAnimNotifyProEvents
+{
+	/** Compiled table of the montage, keeps Table alive while it is in use */
+	TSharedPtr<const FAnimNotifyProMontageTable> MontageTable;
+
+	/** Section table the events were gathered from */
+	const FAnimNotifyProSectionTable* Table = nullptr;
+
+	/** NotifyId of the first event, every event has a unique ID so a regather can be detected */
+	uint32 FirstNotifyId = 0;
+
+	/** Montage time until each event is triggered, from when it was gathered, sorted ascending */
+	TArray<float> Times;
+
+	/** Whether each event has been broadcast */
+	TBitArray<> HasBroadcast;
+
+	/** Whether each event was skipped due to the start position */
+	TBitArray<> Skipped;
+
+	/** Clock that Times are measured on */
+	FAnimNotifyProClock Clock;
+
+	/** Tick clock that Times are converted to, only used with EAnimNotifyProDispatchMode::FixedStep */
+	FAnimNotifyProFixedStepClock FixedStep;
+
+	/** Index of the next event to be dispatched by UPlayMontageProSubsystem */
+	int32 NextEventIndex = 0;
+
+	/** Handle of the single pending entry in UPlayMontageProSubsystem, 0 if not scheduled */
+	uint64 ScheduleHandle = 0;
+
+	/**
+	 * Tick handles from UPlayMontageProSubsystem::RegisterNotifyStateTick of the ticking states that have begun and not ended.
+	 * Kept when the events are gathered again, as a state may end in a later section than it began in.
+	 */
+	TArray<TPair<const UAnimNotifyStatePro*, uint32>> TickHandles;
+
+	/**
+	 * Points the events at a section table and resets the runtime state of every event.
+	 * Existing allocations are reused when they are large enough.
+	 */
+	void Init(const TSharedRef<const FAnimNotifyProMontageTable>& InMontageTable, const FAnimNotifyProSectionTable& InTable, uint32 InFirstNotifyId);
+
+	/**
+	 * Resets the runtime state of every event without changing the section table, e.g. when a section loops.
+	 * Times are left as they are.
+	 */
+	void Rearm(uint32 InFirstNotifyId);
+
+	/** Clears every event and releases the table, keeping allocations. Tick handles must be unregistered first */
+	void Reset();
+
+	int32 Num() const { return Times.Num(); }
+	bool IsValidIndex(int32 Index) const { return Times.IsValidIndex(Index); }
+
+	uint32 GetNotifyId(int32 Index) const { return FirstNotifyId + Index; }
+	bool IsScheduled() const { return ScheduleHandle != 0; }
+	bool IsEndState(int32 Index) const { return Table->Types[Index] == EAnimNotifyProType::NotifyStateEnd; }
+
+	/** Stops dispatching, any pending entry for these events will be discarded by the scheduler */
+	void ClearTimers()
+	{
+		ScheduleHandle = 0;
+		NextEventIndex = Num();
+	}
+
+	/** @return The Blueprint-facing event for Index */
+	FAnimNotifyProEvent MakeEvent(int32 Index) const;
+
+	/** @return Tick handle of the notify state if it began and is ticking, 0 otherwise */
+	uint32 FindTickHandle(const UAnimNotifyStatePro* NotifyState) const;
+
+	/** Stores the tick handle of a notify state that began, replacing any previous one */
+	void AddTickHandle(const UAnimNotifyStatePro* NotifyState, uint32 Handle);
+
+	/** @return Tick handle of the notify state that is ending, 0 if it wasn't ticking */
+	uint32 RemoveTickHandle(const UAnimNotifyStatePro* NotifyState);
+};
+
+/**
+ * Caches the compiled notify table of every montage played with PlayMontagePro.
+ * Tables are built lazily on first use, purged when their montage is garbage collected,
+ * and invalidated in the editor when the montage or one of its notifies is modified.
+ * Game thread only.
+ */
+class PLAYMONTAGEPRO_API FAnimNotifyProTableCache
+{
+public:
+	/** @return The compiled notify table for the montage, building it if it is not cached */
+	static TSharedRef<const FAnimNotifyProMontageTable> Get(const UAnimMontage* Montage);
+
+	/** @return The compiled notify table for the montage with the driven montages' notifies merged in, building it if it is not cached */
+	static TSharedRef<const FAnimNotifyProMontageTable> GetMerged(const UAnimMontage* Montage, TConstArrayView<FAnimNotifyProDrivenSource> DrivenSources);
+
+	/** Discards the cached tables for the montage or sequence that is, or owns, Object, including any it is merged or flattened into */
+	static void Invalidate(const UObject* Object);
+
+	/** Discards every cached table */
+	static void Reset();
+
+	/** Registers the delegates used to purge and invalidate tables, called by the module */
+	static void Startup();
+	static void Shutdown();
+
+private:
+	static void OnPostGarbageCollect();
+
+#if WITH_EDITOR
+	static void OnObjectModified(UObject* Object);
+	static void OnObjectPropertyChanged(UObject* Object, struct FPropertyChangedEvent& PropertyChangedEvent);
+#endif
+
+	static TMap<TObjectKey<UAnimMontage>, TSharedRef<const FAnimNotifyProMontageTable>> Tables;
+
+	/** Tables with driven montages merged in, only a handful of driver and driven combinations are ever played so they are searched linearly */
+	static TArray<TSharedRef<const FAnimNotifyProMontageTable>> MergedTables;
+	static FDelegateHandle PostGarbageCollectHandle;
+
+#if WITH_EDITOR
+	static FDelegateHandle ObjectModifiedHandle;
+	static FDelegateHandle ObjectPropertyChangedHandle;
+#endif
+};
@@ -7,10 +7,16 @@
 #include "Animation/AnimNotifies/AnimNotifyState.h"
 #include "AnimNotifyStatePro.generated.h"
 
+class UPlayMontageProSubsystem;
+
 /**
  * Base class for anim notify states that can be used with PlayMontagePro.
  * Uses timers to ensure that notify states are triggered at the correct time.
  * Unlike Epic's UAnimNotifyState, which is not guaranteed to trigger.
+ *
+ * Only montages played with PlayMontagePro schedule these. On a sequence they trigger when the sequence is played by the
+ * montage's first slot track, a sequence played directly, e.g. by an anim graph, never triggers them on authority or the
+ * autonomous proxy, only on simulated proxies with the Legacy SimulatedProxyBehavior. A warning is logged when that happens.
  */
 UCLASS(Abstract, EditInlineNew, Blueprintable, const)
 class PLAYMONTAGEPRO_API UAnimNotifyStatePro : public UAnimNotifyState
@@ -30,6 +36,37 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=AnimNotify)
 	EAnimNotifyLegacyType SimulatedProxyBehavior = EAnimNotifyLegacyType::Legacy;
 
+	/**
+	 * Cosmetic notifies are not scheduled for montages whose owner is not significant when the notifies are gathered,
+	 * see UPlayMontageProSubsystem::SignificanceQuery. Notifies that ensure they are triggered are never skipped.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=AnimNotify, AdvancedDisplay)
+	EAnimNotifyProSignificance Significance = EAnimNotifyProSignificance::Critical;
+
+	/**
+	 * Call OnNotifyBeginAnyThread and OnNotifyEndAnyThread instead of OnNotifyBegin and OnNotifyEnd, batched with every other
+	 * thread safe notify and run on task graph workers.
+	 * Only for native notifies, anything that must run on the game thread can be queued with UPlayMontageProSubsystem::EnqueueGameThreadTask.
+	 * Blueprint notifies fail validation with this enabled, as K2_OnNotifyBegin and K2_OnNotifyEnd would never be called.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=AnimNotify, AdvancedDisplay)
+	bool bThreadSafeCallback = false;
+
+	/**
+	 * Whether OnNotifyTick is called while the state is active, and how often.
+	 * Every ticking state in the world is ticked in one pass by UPlayMontageProSubsystem, on the game thread.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=AnimNotify)
+	EAnimNotifyProTickRate TickRate = EAnimNotifyProTickRate::Disabled;
+
+	/** Ticks per second when TickRate is Frequency */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=AnimNotify, meta=(EditCondition="TickRate==EAnimNotifyProTickRate::Frequency", EditConditionHides, ClampMin="0.01", UIMin="1", ForceUnits="Hz"))
+	float TickFrequency = 10.f;
+
+	/** Frames between ticks when TickRate is EveryNthFrame */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=AnimNotify, meta=(EditCondition="TickRate==EAnimNotifyProTickRate::EveryNthFrame", EditConditionHides, ClampMin="1", UIMin="1"))
+	int32 TickFrameInterval = 4;
+
 #if WITH_EDITORONLY_DATA
 
 protected:
@@ -64,17 +101,54 @@ public:
 	
 	virtual void OnNotifyBegin(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage);
 	virtual void OnNotifyEnd(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage);
+
+	/**
+	 * Called at TickRate between OnNotifyBegin and OnNotifyEnd, always on the game thread.
+	 * @param DeltaTime World time elapsed since the state began or was last ticked.
+	 */
+	virtual void OnNotifyTick(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage, float DeltaTime);
+
+	/**
+	 * Called instead of OnNotifyBegin and OnNotifyEnd when bThreadSafeCallback is enabled, may run on any thread.
+	 * Notifies of the same mesh run in order on the same thread, so begin always runs before end.
+	 * MeshComp and Montage must only be read, the game thread and other notifies may be using them at the same time.
+	 * @param Subsystem The subsystem that dispatched the notify, null if it was called inline on the game thread.
+	 */
+	virtual void OnNotifyBeginAnyThread(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage, UPlayMontageProSubsystem* Subsystem) const {}
+	virtual void OnNotifyEndAnyThread(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage, UPlayMontageProSubsystem* Subsystem) const {}
 	
+protected:
+	void QueueThreadSafeCallback(EAnimNotifyProType NotifyType, USkeletalMeshComponent* MeshComp, UAnimMontage* Montage) const;
+
+public:
 	UFUNCTION(BlueprintImplementableEvent, meta=(DisplayName="On Notify Begin"))
 	bool K2_OnNotifyBegin(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage) const;
 
 	UFUNCTION(BlueprintImplementableEvent, meta=(DisplayName="On Notify End"))
 	bool K2_OnNotifyEnd(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage) const;
 
+	UFUNCTION(BlueprintImplementableEvent, meta=(DisplayName="On Notify Tick"))
+	bool K2_OnNotifyTick(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage, float DeltaTime) const;
+
+protected:
+	/** @return Whether K2_OnNotifyBegin, K2_OnNotifyEnd and K2_OnNotifyTick are implemented in Blueprint, they are skipped otherwise */
+	bool ImplementsK2OnNotifyBegin() const { CacheImplementsK2Events(); return bImplementsK2OnNotifyBegin; }
+	bool ImplementsK2OnNotifyEnd() const { CacheImplementsK2Events(); return bImplementsK2OnNotifyEnd; }
+	bool ImplementsK2OnNotifyTick() const { CacheImplementsK2Events(); return bImplementsK2OnNotifyTick; }
+
+private:
+	void CacheImplementsK2Events() const;
+
+	/** Looked up on first use, the Blueprint class may not be fully linked yet when the notify state is constructed */
+	mutable uint8 bCachedImplementsK2Events : 1;
+	mutable uint8 bImplementsK2OnNotifyBegin : 1;
+	mutable uint8 bImplementsK2OnNotifyEnd : 1;
+	mutable uint8 bImplementsK2OnNotifyTick : 1;
+
+public:
+
 #if WITH_EDITOR
-	virtual bool CanBePlaced(UAnimSequenceBase* Animation) const override
-	{
-		return Animation && Animation->IsA(UAnimMontage::StaticClass());
-	}
+	/** Montages, and sequences played by a montage's slot segments, whose notifies are flattened into the montage's notify table */
+	virtual bool CanBePlaced(UAnimSequenceBase* Animation) const override;
 #endif
 };
@@ -2,8 +2,11 @@
 
 #pragma once
 
+#include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
 
+PLAYMONTAGEPRO_API DECLARE_LOG_CATEGORY_EXTERN(LogPlayMontagePro, Log, All);
+
 class FPlayMontageProModule : public IModuleInterface
 {
 public:
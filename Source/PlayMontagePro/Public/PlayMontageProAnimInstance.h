@@ -0,0 +1,102 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
+#include "UObject/WeakInterfacePtr.h"
+#include "PlayMontageProAnimInstance.generated.h"
+
+class IPlayMontageProInterface;
+struct FAnimNotifyProMontageTable;
+struct FAnimNotifyProSectionTable;
+
+/**
+ * Montage played with EAnimNotifyProDispatchMode::MontagePosition on a UPlayMontageProAnimInstance.
+ */
+struct FPlayMontageProPositionWatch
+{
+	/** Owner of the notifies, reset when unregistered */
+	TWeakInterfacePtr<IPlayMontageProInterface> Interface;
+
+	TWeakObjectPtr<UAnimMontage> Montage;
+
+	/** Keeps Table alive while the worker reads it */
+	TSharedPtr<const FAnimNotifyProMontageTable> MontageTable;
+
+	/** Section table the owner's notifies pointed at before the update */
+	const FAnimNotifyProSectionTable* Table = nullptr;
+
+	/** FirstNotifyId of the owner's notifies before the update, a change means they were gathered again */
+	uint32 FirstNotifyId = 0;
+
+	/** Montage position at the end of the last update */
+	float LastPosition = 0.f;
+
+	/** Set by the worker if a notify position was crossed, or the montage moved backwards */
+	bool bCrossed = false;
+};
+
+/**
+ * Anim instance proxy that checks for crossed Pro notify positions during the worker thread update.
+ * Watches are copied in on the game thread before the update and handed back to the anim instance after it,
+ * the worker only writes to its own copy so nothing needs to be locked.
+ */
+struct PLAYMONTAGEPRO_API FPlayMontageProAnimInstanceProxy : public FAnimInstanceProxy
+{
+	FPlayMontageProAnimInstanceProxy() = default;
+	FPlayMontageProAnimInstanceProxy(UAnimInstance* InAnimInstance)
+		: FAnimInstanceProxy(InAnimInstance)
+	{}
+
+	// Begin FAnimInstanceProxy
+	virtual void PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds) override;
+	virtual void Update(float DeltaSeconds) override;
+	virtual void PostUpdate(UAnimInstance* InAnimInstance) const override;
+	// ~End FAnimInstanceProxy
+
+protected:
+	/** Copy of the anim instance's watches for the current update */
+	TArray<FPlayMontageProPositionWatch> PositionWatches;
+};
+
+/**
+ * Anim instance that tracks Pro notifies dispatched by montage position as part of its animation update.
+ * Without it, UPlayMontageProSubsystem polls every such montage on the game thread once per frame.
+ * With it, the parallel anim update finds which montages crossed a notify and the game thread only visits those
+ * once the update completes, so meshes that crossed nothing cost nothing on the game thread.
+ */
+UCLASS()
+class PLAYMONTAGEPRO_API UPlayMontageProAnimInstance : public UAnimInstance
+{
+	GENERATED_BODY()
+
+	friend struct FPlayMontageProAnimInstanceProxy;
+
+public:
+	/**
+	 * Calls IPlayMontageProInterface::TickMontagePosition after each animation update in which the montage crossed a notify,
+	 * moved backwards, or had its notifies gathered again.
+	 * @param Interface The interface that owns the notifies.
+	 * @param Montage The montage the notifies were gathered from.
+	 * @param Position The montage position notifies have been dispatched up to.
+	 */
+	void RegisterMontagePositionDispatch(IPlayMontageProInterface* Interface, UAnimMontage* Montage, float Position);
+	void UnregisterMontagePositionDispatch(IPlayMontageProInterface* Interface);
+
+protected:
+	// Begin UAnimInstance
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override;
+	virtual void DestroyAnimInstanceProxy(FAnimInstanceProxy* InProxy) override;
+	// ~End UAnimInstance
+
+	/** Refreshes the watches from their owners' notifies and copies them to the proxy, on the game thread before the update */
+	void CopyPositionWatches(TArray<FPlayMontageProPositionWatch>& OutWatches);
+
+	/** Ticks the owners whose watch was crossed during the update, on the game thread after it */
+	void DispatchPositionWatches(const TArray<FPlayMontageProPositionWatch>& UpdatedWatches);
+
+	/** Montages dispatched by position, entries are reset when unregistered and removed before the next update */
+	TArray<FPlayMontageProPositionWatch> PositionWatches;
+};
@@ -0,0 +1,91 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PlayMontageTypes.h"
+#include "UObject/Object.h"
+#include "PlayMontageProBatchCallbackProxy.generated.h"
+
+class UAnimMontage;
+class UPlayMontageProCallbackProxy;
+class UPlayMontageProSubsystem;
+class USkeletalMeshComponent;
+
+/**
+ * How the montage played on one mesh of a batch finished.
+ */
+USTRUCT(BlueprintType)
+struct PLAYMONTAGEPRO_API FPlayMontageProBatchResult
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category=Animation)
+	TObjectPtr<USkeletalMeshComponent> Mesh = nullptr;
+
+	UPROPERTY(BlueprintReadOnly, Category=Animation)
+	EPlayMontageProResult Result = EPlayMontageProResult::FailedToPlay;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnMontageProBatchDelegate, const TArray<FPlayMontageProBatchResult>&, Results);
+
+/**
+ * Plays the same montage on many meshes at once, e.g. a crowd or a squad emote.
+ * Every mesh gets its own pooled UPlayMontageProCallbackProxy, the compiled notify table is shared between all of them
+ * and their first notifies are added to the scheduler with a single heapify rather than one insert each.
+ */
+UCLASS()
+class PLAYMONTAGEPRO_API UPlayMontageProBatchCallbackProxy : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Called once the montage has ended on every mesh, with the result for each mesh in the order they were passed */
+	UPROPERTY(BlueprintAssignable)
+	FOnMontageProBatchDelegate OnAllEnded;
+
+	// Called to perform the query internally
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"))
+	static UPlayMontageProBatchCallbackProxy* CreateProxyObjectForPlayMontageProBatch(
+		const TArray<USkeletalMeshComponent*>& InSkeletalMeshComponents,
+		UAnimMontage* MontageToPlay,
+		float PlayRate = 1.f,
+		float StartingPosition = 0.f,
+		FName StartingSection = NAME_None,
+		bool bTriggerNotifiesBeforeStartTime = false,
+		bool bEnableCustomTimeDilation = false,
+		bool bShouldStopAllMontages = true,
+		EAnimNotifyProDispatchMode DispatchMode = EAnimNotifyProDispatchMode::Timer);
+
+	/** @return The proxy playing the montage on each mesh, null once that montage has ended */
+	UFUNCTION(BlueprintPure, Category=Animation)
+	TArray<UPlayMontageProCallbackProxy*> GetProxies() const;
+
+	/** @return The results so far, meshes whose montage is still playing have FailedToPlay */
+	const TArray<FPlayMontageProBatchResult>& GetResults() const { return Results; }
+
+protected:
+	void OnProxyEnded(UPlayMontageProCallbackProxy* Proxy, EPlayMontageProResult Result, int32 Index);
+
+	/** Broadcasts OnAllEnded and lets the subsystem release the batch, on the next tick if no montage was left playing by the factory */
+	void Finish();
+
+	/**
+	 * Proxy for each mesh, kept alive while its montage plays as nothing else references it.
+	 * Cleared when its montage ends as the proxy returns to the pool.
+	 */
+	UPROPERTY()
+	TArray<TObjectPtr<UPlayMontageProCallbackProxy>> Proxies;
+
+	UPROPERTY()
+	TArray<FPlayMontageProBatchResult> Results;
+
+	/** Subsystem keeping the batch alive while montages are playing */
+	TWeakObjectPtr<UPlayMontageProSubsystem> Subsystem;
+
+	/** Number of montages that have not ended yet */
+	int32 NumPending = 0;
+
+	/** Whether the montages are still being started */
+	bool bStarting = false;
+};
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "AnimNotifyProTable.h"
 #include "PlayMontageProInterface.h"
 #include "PlayMontageProStatics.h"
 #include "PlayMontageTypes.h"
@@ -14,17 +15,30 @@
 class UAnimNotifyStatePro;
 class UAnimNotifyPro;
 class UAnimMontage;
+class UPlayMontageProReplicationComponent;
 class USkeletalMeshComponent;
 struct FBranchingPointNotifyPayload;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnMontagePlayDelegate, FName, NotifyName);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnMontagePlayNotifyDelegate, const FAnimNotifyProEvent&, Event);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnMontageProNotifyNative, const FAnimNotifyProEvent& /*Event*/);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnMontageProEndedNative, UPlayMontageProCallbackProxy* /*Proxy*/, EPlayMontageProResult /*Result*/);
 
+/**
+ * Plays a montage and broadcasts its Pro notifies.
+ * Proxies are pooled by UPlayMontageProSubsystem: once the montage has ended or failed to play and its ensured notifies have been
+ * broadcast, the proxy is reset and may be handed out for another montage. Don't keep a pointer to it, or a delegate bound to it,
+ * past OnCompleted, OnInterrupted or OnEndedNative.
+ * Proxies played with EAnimNotifyProDispatchMode::FixedStep are never pooled, as their owner keeps driving them with
+ * AdvanceFixedStep, RewindFixedStep and ResimulateFixedStep and those calls do nothing once the montage has ended.
+ */
 UCLASS()
 class PLAYMONTAGEPRO_API UPlayMontageProCallbackProxy : public UObject, public IPlayMontageProInterface
 {
 	GENERATED_UCLASS_BODY()
 
+	friend class UPlayMontageProBatchCallbackProxy;
+
 	// Called when Montage finished playing and wasn't interrupted
 	UPROPERTY(BlueprintAssignable)
 	FOnMontagePlayDelegate OnCompleted;
@@ -46,6 +60,17 @@ class PLAYMONTAGEPRO_API UPlayMontageProCallbackProxy : public UObject, public I
 	UPROPERTY(BlueprintAssignable)
 	FOnMontagePlayNotifyDelegate OnNotifyStateEnd;
 
+	/** Called once when the montage ends or fails to play, cleared when the proxy returns to the pool */
+	FOnMontageProEndedNative OnEndedNative;
+
+	/**
+	 * Native counterparts of OnNotify, OnNotifyStateBegin and OnNotifyStateEnd, called before them without going through reflection.
+	 * Cleared when the proxy returns to the pool.
+	 */
+	FOnMontageProNotifyNative OnNotifyNative;
+	FOnMontageProNotifyNative OnNotifyStateBeginNative;
+	FOnMontageProNotifyNative OnNotifyStateEndNative;
+
 	UPROPERTY()
 	uint32 NotifyId = 0;
 
@@ -55,8 +80,8 @@ class PLAYMONTAGEPRO_API UPlayMontageProCallbackProxy : public UObject, public I
 	UPROPERTY()
 	TWeakObjectPtr<USkeletalMeshComponent> MeshComp;
 	
-	UPROPERTY()
-	TArray<FAnimNotifyProEvent> Notifies;
+	/** Runtime state of the notifies in the current section */
+	FAnimNotifyProEvents Notifies;
 	
 	// Called to perform the query internally
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"))
@@ -68,20 +93,67 @@ class PLAYMONTAGEPRO_API UPlayMontageProCallbackProxy : public UObject, public I
 		FName StartingSection = NAME_None,
 		bool bTriggerNotifiesBeforeStartTime = false,
 		bool bEnableCustomTimeDilation = false,
-		bool bShouldStopAllMontages = true);
+		bool bShouldStopAllMontages = true,
+		EAnimNotifyProDispatchMode DispatchMode = EAnimNotifyProDispatchMode::Timer);
+
+	/**
+	 * Plays a driver montage and starts the driven montages on their own meshes alongside it, e.g. a third-person reload driving
+	 * the weapon and first-person meshes. Only the driver montage gathers and schedules notifies, the driven montages' Pro notifies
+	 * are suppressed or merged into that schedule according to InDrivenNotifyPolicy.
+	 * Driven montages follow the driver's section changes and are stopped if the driver is interrupted.
+	 * Merged notifies are not replicated by UPlayMontageProReplicationComponent, driven montages are local to this machine.
+	 */
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"))
+	static UPlayMontageProCallbackProxy* CreateProxyObjectForPlayMontageProDriven(
+		USkeletalMeshComponent* InSkeletalMeshComponent,
+		UAnimMontage* MontageToPlay,
+		const TArray<FPlayMontageProDrivenMontage>& InDrivenMontages,
+		EPlayMontageProDrivenNotifyPolicy InDrivenNotifyPolicy = EPlayMontageProDrivenNotifyPolicy::Suppress,
+		float PlayRate = 1.f,
+		float StartingPosition = 0.f,
+		FName StartingSection = NAME_None,
+		bool bTriggerNotifiesBeforeStartTime = false,
+		bool bEnableCustomTimeDilation = false,
+		bool bShouldStopAllMontages = true,
+		EAnimNotifyProDispatchMode DispatchMode = EAnimNotifyProDispatchMode::Timer);
 
 public:
 	// Begin IPlayMontageProInterface
-	virtual void BroadcastNotifyEvent(FAnimNotifyProEvent& Event) override { UPlayMontageProStatics::BroadcastNotifyEvent(Event, this); }
-	virtual void NotifyCallback(const FAnimNotifyProEvent& Event) override { OnNotify.Broadcast(Event); }
-	virtual void NotifyBeginCallback(const FAnimNotifyProEvent& Event) override { OnNotifyStateBegin.Broadcast(Event); }
-	virtual void NotifyEndCallback(const FAnimNotifyProEvent& Event) override { OnNotifyStateEnd.Broadcast(Event); }
+	virtual void BroadcastNotifyEvent(int32 NotifyIndex) override;
+	virtual void NotifyCallback(const FAnimNotifyProEvent& Event) override;
+	virtual void NotifyBeginCallback(const FAnimNotifyProEvent& Event) override;
+	virtual void NotifyEndCallback(const FAnimNotifyProEvent& Event) override;
+	virtual bool WantsNotifyEvents() const override;
 
 	virtual UAnimMontage* GetMontage() const override final { return Montage.IsValid() ? Montage.Get() : nullptr; }
 	virtual USkeletalMeshComponent* GetMesh() const override final { return MeshComp.IsValid() ? MeshComp.Get() : nullptr; }
+	virtual void GetDrivenSource(int32 DrivenIndex, USkeletalMeshComponent*& OutMesh, UAnimMontage*& OutMontage) const override;
 
-	virtual FTimerDelegate CreateTimerDelegate(FAnimNotifyProEvent& Event) override { return FTimerDelegate::CreateUObject(this, &IPlayMontageProInterface::OnNotifyTimer, &Event); }
+	virtual FAnimNotifyProEvents& GetNotifies() override final { return Notifies; }
+	virtual void TickMontagePosition() override;
+	virtual bool IsSignificant() const override;
 	// ~End IPlayMontageProInterface
+
+	// Fixed-step clock, used when played with EAnimNotifyProDispatchMode::FixedStep, e.g. by a rollback simulation
+	// The clock starts at tick 0 when the montage starts or changes section and only moves when the owner moves it
+	// Rewinding and resimulating are limited to the current section and do not allocate
+
+	/** Changes the ticks per second, FAnimNotifyProFixedStepClock::DefaultTickRate until set. Elapsed time carries over */
+	void SetFixedStepTickRate(int32 TickRate);
+
+	/** Advances the clock, broadcasting every notify whose tick is reached */
+	void AdvanceFixedStep(int32 NumTicks = 1);
+
+	/** Moves the clock to Tick, restoring which notifies have triggered without broadcasting anything */
+	void RewindFixedStep(int32 Tick);
+
+	/** Rewinds to FromTick then advances to ToTick, broadcasting the notifies in between again */
+	void ResimulateFixedStep(int32 FromTick, int32 ToTick);
+
+	int32 GetFixedStepTick() const { return Notifies.FixedStep.CurrentTick; }
+
+	/** Unbinds everything and clears per-montage state so the proxy can be reused by UPlayMontageProSubsystem */
+	void ResetProxy();
 	
 protected:
 	UFUNCTION()
@@ -93,16 +165,66 @@ protected:
 	UFUNCTION()
 	void OnMontageSectionChanged(UAnimMontage* InMontage, FName SectionName, bool bLooped);
 
+	/**
+	 * Replicates the termination and queues the notifies that ensure they are triggered for the event type on UPlayMontageProSubsystem.
+	 * Called after the proxy's own delegates, as the notifies have always been broadcast after them.
+	 * Without a subsystem the notifies are broadcast immediately.
+	 * @param bEnded Whether the montage ended, rather than started blending out. The proxy is returned to the pool once the notifies are broadcast.
+	 */
+	void EnsureBroadcastNotifyEvents(EAnimNotifyProEventType EventType, bool bEnded);
+
+	/** @return The compiled notify table to gather from, with the driven montages' notifies merged in if requested */
+	TSharedRef<const FAnimNotifyProMontageTable> GetNotifyTable(const UAnimMontage* MontageToPlay) const;
+
+	/** Starts the driven montages at the driver position, with their play rate scaled to match the driver's duration */
+	void PlayDrivenMontages(const UAnimMontage* MontageToPlay, float PlayRate, float DriverPosition, bool bShouldStopAllMontages);
+
+	/** Moves the driven montages to the driver position and play rate, e.g. after the driver changed section */
+	void SyncDrivenMontages(float DriverPosition, float PlayRate);
+
+	/** Stops the driven montages that are still playing, e.g. when the driver is interrupted */
+	void StopDrivenMontages();
+
+	/** Driven montages started alongside the montage, entries without a mesh or montage are discarded */
+	UPROPERTY()
+	TArray<FPlayMontageProDrivenMontage> DrivenMontages;
+
+	/** Driver montage position per driven montage position, for each of DrivenMontages */
+	TArray<float> DrivenPositionScales;
+
+	/** Whether the driven montages' notifies are merged into the montage's schedule */
+	EPlayMontageProDrivenNotifyPolicy DrivenNotifyPolicy = EPlayMontageProDrivenNotifyPolicy::Suppress;
+
 	bool bFinished = false;
 	
-	FDelegateHandle TickPoseHandle;
+	/** Whether the notifies' clock follows the owner's CustomTimeDilation, checked by UPlayMontageProSubsystem */
+	bool bFollowTimeDilation = false;
 
 	float TimeDilation = 1.f;
+
+	/** Play rate of the montage when notifies were last gathered */
+	float MontagePlayRate = 1.f;
+
+	/** How notifies are dispatched for this montage */
+	EAnimNotifyProDispatchMode NotifyDispatchMode = EAnimNotifyProDispatchMode::Timer;
+
+	/** Index of the next notify to broadcast, used by EAnimNotifyProDispatchMode::MontagePosition */
+	int32 NotifyCursor = 0;
+
+	/** Montage position when notifies were last dispatched */
+	float LastMontagePosition = 0.f;
+
+	/** Section the notifies were gathered from */
+	int32 SectionIndex = INDEX_NONE;
+
+	/** Replicates the notifies to simulated proxies, only set on a networked server */
+	TWeakObjectPtr<UPlayMontageProReplicationComponent> ReplicationComponent;
 	
-	UFUNCTION()
-	void OnTickPose(USkinnedMeshComponent* SkinnedMeshComponent, float DeltaTime, bool NeedsValidRootMotion);
+	/** Returns this proxy to the world's pool once the montage has finished */
+	void ReleaseToPool();
 
-	virtual void BeginDestroy() override;
+	/** @return Whether the proxy may be reused once the montage has finished, FixedStep proxies stay with their owner */
+	bool CanReturnToPool() const { return NotifyDispatchMode != EAnimNotifyProDispatchMode::FixedStep; }
 	
 private:
 	TWeakObjectPtr<UAnimInstance> AnimInstancePtr;
@@ -122,8 +244,10 @@ protected:
 	 * @param StartingPosition The position in the montage to start playing from.
 	 * @param StartingSection The section of the montage to start playing from.
 	 * @param bTriggerNotifiesBeforeStartTime Whether to trigger notifies before the starting position.
-	 * @param bEnableCustomTimeDilation Whether to enable custom time dilation for the montage. Requires the mesh component to tick pose. May have additional performance overhead.
+	 * @param bEnableCustomTimeDilation Whether to enable custom time dilation for the montage. Changes are picked up once per frame by UPlayMontageProSubsystem.
 	 * @param bShouldStopAllMontages Whether to stop all other montages before playing this one.
+	 * @param InDispatchMode How notifies are dispatched. MontagePosition follows the montage and ignores bEnableCustomTimeDilation.
+	 * FixedStep waits for AdvanceFixedStep and only applies the time dilation at the start.
 	 * @return True if the montage was played successfully, false otherwise.
 	 */
 	bool PlayMontagePro(
@@ -134,5 +258,6 @@ protected:
 		FName StartingSection = NAME_None,
 		bool bTriggerNotifiesBeforeStartTime = false,
 		bool bEnableCustomTimeDilation = false,
-		bool bShouldStopAllMontages = true);
+		bool bShouldStopAllMontages = true,
+		EAnimNotifyProDispatchMode InDispatchMode = EAnimNotifyProDispatchMode::Timer);
 };
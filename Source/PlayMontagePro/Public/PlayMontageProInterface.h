@@ -8,8 +8,9 @@
 #include "PlayMontageProInterface.generated.h"
 
 class UAnimMontage;
+struct FAnimNotifyProEvents;
 
-UINTERFACE()
+UINTERFACE(MinimalAPI)
 class UPlayMontageProInterface : public UInterface
 {
 	GENERATED_BODY()
@@ -24,15 +25,37 @@ class PLAYMONTAGEPRO_API IPlayMontageProInterface
 	GENERATED_BODY()
 
 public:
-	virtual void BroadcastNotifyEvent(FAnimNotifyProEvent& Event) = 0;
+	/** Broadcasts the notify at NotifyIndex in GetNotifies() */
+	virtual void BroadcastNotifyEvent(int32 NotifyIndex) = 0;
 	
 	virtual void NotifyCallback(const FAnimNotifyProEvent& Event) = 0;
 	virtual void NotifyBeginCallback(const FAnimNotifyProEvent& Event) = 0;
 	virtual void NotifyEndCallback(const FAnimNotifyProEvent& Event) = 0;
 
+	/** Whether anything listens to the callbacks above, if not the event is neither built nor passed to them */
+	virtual bool WantsNotifyEvents() const { return true; }
+
 	virtual UAnimMontage* GetMontage() const = 0;
 	virtual USkeletalMeshComponent* GetMesh() const = 0;
 
-	virtual FTimerDelegate CreateTimerDelegate(FAnimNotifyProEvent& Event) = 0;
-	void OnNotifyTimer(FAnimNotifyProEvent* Event) { BroadcastNotifyEvent(*Event); }
+	/**
+	 * Mesh and montage of the driven montage that a merged notify was gathered from, see EPlayMontageProDrivenNotifyPolicy::Merge.
+	 * Left as the driver's mesh and montage if the interface has no driven montages.
+	 */
+	virtual void GetDrivenSource(int32 DrivenIndex, USkeletalMeshComponent*& OutMesh, UAnimMontage*& OutMontage) const {}
+
+	/** Notifies owned by this interface, indexed by UPlayMontageProSubsystem when scheduled notifies are due */
+	virtual FAnimNotifyProEvents& GetNotifies() = 0;
+
+	/**
+	 * Called once per frame by UPlayMontageProSubsystem while registered for EAnimNotifyProDispatchMode::MontagePosition,
+	 * or by UPlayMontageProAnimInstance after an animation update that crossed one of the notifies.
+	 */
+	virtual void TickMontagePosition() {}
+
+	/**
+	 * Whether the owner is significant enough for its cosmetic notifies to be triggered, checked whenever notifies are gathered.
+	 * @see EAnimNotifyProSignificance
+	 */
+	virtual bool IsSignificant() const { return true; }
 };
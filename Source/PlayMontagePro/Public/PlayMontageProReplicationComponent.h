@@ -0,0 +1,178 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnimNotifyProTable.h"
+#include "PlayMontageProCallbackProxy.h"
+#include "PlayMontageProInterface.h"
+#include "Components/ActorComponent.h"
+#include "PlayMontageProReplicationComponent.generated.h"
+
+class UAnimMontage;
+class USkeletalMeshComponent;
+
+/**
+ * Pro notify state of the montage last played with PlayMontagePro on the server, replicated to simulated proxies.
+ * Replicated per property, so after the montage starts only the words of FiredWords that changed are sent.
+ */
+USTRUCT()
+struct PLAYMONTAGEPRO_API FPlayMontageProRepState
+{
+	GENERATED_BODY()
+
+	/** Mesh the montage is playing on */
+	UPROPERTY()
+	TObjectPtr<USkeletalMeshComponent> Mesh = nullptr;
+
+	UPROPERTY()
+	TObjectPtr<UAnimMontage> Montage = nullptr;
+
+	/** Incremented every time notifies are gathered on the server, i.e. the montage starts, changes section or loops */
+	UPROPERTY()
+	uint8 PlayId = 0;
+
+	UPROPERTY()
+	int16 SectionIndex = INDEX_NONE;
+
+	/** Montage position notifies were gathered from */
+	UPROPERTY()
+	float StartPosition = 0.f;
+
+	/** Server world time at which the montage was at StartPosition */
+	UPROPERTY()
+	double StartServerTime = 0.0;
+
+	UPROPERTY()
+	float PlayRate = 1.f;
+
+	UPROPERTY()
+	float TimeDilation = 1.f;
+
+	/** EAnimNotifyProEventType conditions the montage terminated with so far, None while playing */
+	UPROPERTY()
+	uint8 EndReasons = 0;
+
+	/** Bit per event of the section, 32 events per word, set once the server has broadcast it */
+	UPROPERTY()
+	TArray<uint32> FiredWords;
+};
+
+/**
+ * Lets simulated proxies run Pro notifies instead of falling back to the engine's notifies.
+ * Add it to the actor that plays montages with PlayMontagePro. On the server it records which montage and section is playing,
+ * when it started, and which notifies have been broadcast. Simulated proxies schedule the same notifies from that state,
+ * skip the ones the server already broadcast, catch up on any they missed, and ensure notifies when the montage terminates.
+ * Only notifies with SimulatedProxyBehavior set to Replicated are triggered this way.
+ */
+UCLASS(ClassGroup=Animation, meta=(BlueprintSpawnableComponent))
+class PLAYMONTAGEPRO_API UPlayMontageProReplicationComponent : public UActorComponent, public IPlayMontageProInterface
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(BlueprintAssignable)
+	FOnMontagePlayNotifyDelegate OnNotify;
+
+	UPROPERTY(BlueprintAssignable)
+	FOnMontagePlayNotifyDelegate OnNotifyStateBegin;
+
+	UPROPERTY(BlueprintAssignable)
+	FOnMontagePlayNotifyDelegate OnNotifyStateEnd;
+
+public:
+	UPlayMontageProReplicationComponent(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	/** @return The component on the owner of MeshComp if it should replicate montages played on it, i.e. on a networked server */
+	static UPlayMontageProReplicationComponent* FindForReplication(const USkeletalMeshComponent* MeshComp);
+
+	/**
+	 * Replicates notifies that were just gathered on the server.
+	 * @param InMesh The mesh the montage is playing on.
+	 * @param InMontage The montage the notifies were gathered from.
+	 * @param SectionIndex The section the notifies were gathered from.
+	 * @param StartPosition The montage position the notifies were gathered from.
+	 * @param PlayRate The play rate of the montage.
+	 * @param TimeDilation The time dilation the notifies' clock is running at.
+	 * @param Notifies The gathered notifies, including any broadcast as historic notifies.
+	 */
+	void ReplicateMontage(USkeletalMeshComponent* InMesh, UAnimMontage* InMontage, int32 SectionIndex, float StartPosition,
+		float PlayRate, float TimeDilation, const FAnimNotifyProEvents& Notifies);
+
+	/** Replicates which notifies of InMontage have been broadcast on the server */
+	void ReplicateBroadcast(const UAnimMontage* InMontage, const FAnimNotifyProEvents& Notifies);
+
+	/**
+	 * Replicates that InMontage is terminating on the server, simulated proxies ensure notifies for EventType.
+	 * @param InMontage The montage that is terminating.
+	 * @param EventType The condition notifies are ensured for, None if they already were.
+	 * @param bEnded Whether the montage ended, rather than started blending out, simulated proxies stop their notifies.
+	 */
+	void ReplicateTermination(const UAnimMontage* InMontage, EAnimNotifyProEventType EventType, bool bEnded);
+
+	// Begin IPlayMontageProInterface
+	virtual void BroadcastNotifyEvent(int32 NotifyIndex) override { UPlayMontageProStatics::BroadcastNotifyEvent(Notifies, NotifyIndex, this); }
+	virtual void NotifyCallback(const FAnimNotifyProEvent& Event) override { OnNotify.Broadcast(Event); }
+	virtual void NotifyBeginCallback(const FAnimNotifyProEvent& Event) override { OnNotifyStateBegin.Broadcast(Event); }
+	virtual void NotifyEndCallback(const FAnimNotifyProEvent& Event) override { OnNotifyStateEnd.Broadcast(Event); }
+	virtual bool WantsNotifyEvents() const override { return OnNotify.IsBound() || OnNotifyStateBegin.IsBound() || OnNotifyStateEnd.IsBound(); }
+
+	virtual UAnimMontage* GetMontage() const override final { return SimulatedMontage.Get(); }
+	virtual USkeletalMeshComponent* GetMesh() const override final { return SimulatedMesh.Get(); }
+
+	virtual FAnimNotifyProEvents& GetNotifies() override final { return Notifies; }
+	virtual bool IsSignificant() const override;
+	// ~End IPlayMontageProInterface
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+protected:
+	UFUNCTION()
+	void OnRep_State();
+
+	/**
+	 * Gathers the notifies for the replicated montage and section and schedules them from the estimated montage position.
+	 * @param bTriggerPassedNotifies Whether to broadcast notifies before the estimated position, rather than skip them.
+	 */
+	void StartSimulation(bool bTriggerPassedNotifies);
+
+	/** Broadcasts every notify the server has broadcast that has not been broadcast locally yet */
+	void CatchUpSimulation();
+
+	/** Ensures notifies for every end reason that has not been handled yet */
+	void TerminateSimulation(uint8 NewEndReasons);
+
+	/** Stops dispatching the simulated notifies */
+	void StopSimulation();
+
+	/** @return Server world time, synchronized on clients by the game state */
+	double GetServerWorldTime() const;
+
+	UPROPERTY(ReplicatedUsing=OnRep_State)
+	FPlayMontageProRepState State;
+
+	/** Notifies simulated on simulated proxies */
+	FAnimNotifyProEvents Notifies;
+
+	uint32 NotifyId = 0;
+
+	/** Montage and mesh the simulated notifies were gathered for */
+	TWeakObjectPtr<UAnimMontage> SimulatedMontage;
+	TWeakObjectPtr<USkeletalMeshComponent> SimulatedMesh;
+
+	/** PlayId the simulated notifies were gathered for */
+	uint8 SimulatedPlayId = 0;
+
+	/** End reasons already handled by the simulation */
+	uint8 SimulatedEndReasons = 0;
+
+	/** Whether notifies are being simulated */
+	bool bSimulating = false;
+
+	/** Whether the estimated position moved past the replicated section, so the server's FiredWords don't apply to Notifies */
+	bool bEstimateLeftSection = false;
+
+	/** Whether the state has been received since the actor became relevant */
+	bool bReceivedState = false;
+};
@@ -8,7 +8,15 @@
 #include "PlayMontageProStatics.generated.h"
 
 class UAnimMontage;
+class UAnimSequenceBase;
+class USkeletalMeshComponent;
 class IPlayMontageProInterface;
+struct FAnimNotifyEventReference;
+struct FAnimNotifyProEvents;
+struct FAnimNotifyProMontageTable;
+
+/** Indices of the events to broadcast when a montage terminates, see UPlayMontageProStatics::GatherEnsureNotifyEvents */
+using FAnimNotifyProEnsureIndices = TArray<int32, TInlineAllocator<32>>;
 
 /**
  * Common utility functions for PlayMontagePro shared between different PlayMontage nodes.
@@ -20,61 +28,161 @@ class PLAYMONTAGEPRO_API UPlayMontageProStatics : public UBlueprintFunctionLibra
 
 public:
 	/**
-	 * Gathers notifies from the montage and returns them in the Notifies array.
+	 * Gathers notifies from the montage's compiled notify table and resets the runtime state in Notifies, sorted by position.
 	 * @param Montage The montage to gather notifies from.
 	 * @param NotifyId The current notify ID, which will be incremented for each notify found.
-	 * @param Notifies The array to store the gathered notifies.
+	 * @param Notifies The notify events to initialize from the section table.
 	 * @param Section The section of the montage to gather notifies from.
 	 * @param StartPosition The starting position of the montage, used to calculate notify times.
-	 * @param TimeDilation The time dilation factor to apply to the notify times.
+	 * @param TimeDilation The time dilation of the notifies' clock.
+	 * @param PlayRate The play rate of the montage, the notifies' clock also applies the montage's rate scale.
+	 */
+	static void GatherNotifies(UAnimMontage* Montage, uint32& NotifyId, FAnimNotifyProEvents& Notifies, const FName& Section, float StartPosition, float TimeDilation, float PlayRate = 1.f);
+
+	/**
+	 * Gathers notifies from a compiled notify table of the montage, e.g. one with driven montages merged in.
+	 * @see FAnimNotifyProTableCache::GetMerged
+	 */
+	static void GatherNotifies(const TSharedRef<const FAnimNotifyProMontageTable>& MontageTable, UAnimMontage* Montage, uint32& NotifyId, FAnimNotifyProEvents& Notifies, const FName& Section, float StartPosition, float TimeDilation, float PlayRate = 1.f);
+
+	/**
+	 * Gathers the notifies of the section containing StartPosition, for when the montage changes section.
+	 * Reuses the montage table Notifies already references, and only re-arms the events if the section is the same, e.g. when it loops.
+	 * @param Montage The montage to gather notifies from.
+	 * @param NotifyId The current notify ID, which will be incremented for each notify found.
+	 * @param Notifies The notify events to initialize from the section table.
+	 * @param StartPosition The position of the montage in the new section, used to find the section and calculate notify times.
+	 * @param TimeDilation The time dilation of the notifies' clock.
+	 * @param PlayRate The play rate of the montage, the notifies' clock also applies the montage's rate scale.
+	 * @return The index of the section the notifies were gathered from.
 	 */
-	static void GatherNotifies(UAnimMontage* Montage, uint32& NotifyId, TArray<FAnimNotifyProEvent>& Notifies, const FName& Section, float StartPosition, float TimeDilation);
+	static int32 GatherSectionNotifies(UAnimMontage* Montage, uint32& NotifyId, FAnimNotifyProEvents& Notifies, float StartPosition, float TimeDilation, float PlayRate = 1.f);
 
 	/**
 	 * Handles historic notifies, triggering them before the start time if specified, or marking them as skipped.
-	 * @param Notifies The array of notifies to handle.
+	 * @param Notifies The notify events to handle.
 	 * @param bTriggerNotifiesBeforeStartTime Whether to trigger notifies before the start time.
 	 * @param Interface The interface to use for broadcasting notify events.
 	 */
-	static void HandleHistoricNotifies(TArray<FAnimNotifyProEvent>& Notifies, bool bTriggerNotifiesBeforeStartTime, IPlayMontageProInterface* Interface);
+	static void HandleHistoricNotifies(FAnimNotifyProEvents& Notifies, bool bTriggerNotifiesBeforeStartTime, IPlayMontageProInterface* Interface);
+
+	/**
+	 * Marks the cosmetic notifies as skipped if the interface is not significant, so they are never scheduled or broadcast.
+	 * Call after gathering, before the notifies are handled or scheduled. Notifies that ensure they are triggered are kept.
+	 * @param Notifies The notify events that were just gathered.
+	 * @param Interface The interface that owns the notifies.
+	 */
+	static void SkipInsignificantNotifies(FAnimNotifyProEvents& Notifies, const IPlayMontageProInterface* Interface);
+
+	/**
+	 * Starts the notifies' clock and schedules them with the world's UPlayMontageProSubsystem.
+	 * @param Interface The interface that owns the notifies and will broadcast them when they are due.
+	 * @param World The world whose scheduler the notifies are registered with.
+	 * @param Notifies The notify events to schedule.
+	 */
+	static void SetupNotifyTimers(IPlayMontageProInterface* Interface, const UWorld* World, FAnimNotifyProEvents& Notifies);
+
+	/**
+	 * Removes the notifies in Notifies from the world's UPlayMontageProSubsystem.
+	 * @param World The world whose scheduler the notifies are registered with.
+	 * @param Notifies The notify events to unschedule.
+	 */
+	static void ClearNotifyTimers(const UWorld* World, FAnimNotifyProEvents& Notifies);
+
+	/**
+	 * Converts the notify times to ticks of the fixed-step clock at its tick rate and starts the clock at tick 0.
+	 * Existing allocations are reused, so this can be called whenever the notifies are gathered.
+	 * @param Notifies The notify events to convert.
+	 */
+	static void SetupFixedStepNotifies(FAnimNotifyProEvents& Notifies);
+
+	/**
+	 * Advances the fixed-step clock, broadcasting every event whose tick is reached, in order.
+	 * @param Interface The interface to use for broadcasting notify events.
+	 * @param Notifies The notify events.
+	 * @param NumTicks The number of ticks to advance.
+	 */
+	static void AdvanceFixedStepNotifies(IPlayMontageProInterface* Interface, FAnimNotifyProEvents& Notifies, int32 NumTicks);
 
 	/**
-	 * Sets up timers for the notifies in the Notifies array, using the provided interface to create timer delegates.
-	 * @param Interface The interface to use for creating timer delegates.
-	 * @param World The world context to use for setting up timers.
-	 * @param Notifies The array of notifies to set up timers for.
+	 * Moves the fixed-step clock to Tick and marks exactly the events up to it as broadcast, without broadcasting anything.
+	 * Events handled by HandleHistoricNotifies are unaffected. Does not allocate.
+	 * @param Notifies The notify events.
+	 * @param Tick The tick to rewind, or fast forward, to.
 	 */
-	static void SetupNotifyTimers(IPlayMontageProInterface* Interface, const UWorld* World, TArray<FAnimNotifyProEvent>& Notifies);
+	static void RewindFixedStepNotifies(FAnimNotifyProEvents& Notifies, int32 Tick);
 
 	/**
-	 * Clears the timers for the notifies in the Notifies array.
-	 * @param World The world context to use for clearing timers.
-	 * @param Notifies The array of notifies to clear timers for.
+	 * Moves the cursor to the first notify after Position without broadcasting anything.
+	 * @param Notifies The notify events, sorted by position.
+	 * @param Cursor The cursor to move.
+	 * @param Position The montage position to seek to.
 	 */
-	static void ClearNotifyTimers(const UWorld* World, TArray<FAnimNotifyProEvent>& Notifies);
+	static void SeekNotifyCursor(const FAnimNotifyProEvents& Notifies, int32& Cursor, float Position);
+
+	/**
+	 * Broadcasts every notify whose montage position lies within (PreviousPosition, CurrentPosition].
+	 * Cost is proportional to the number of notifies crossed, not the number of notifies in the montage.
+	 * @param Interface The interface to use for broadcasting notify events.
+	 * @param Notifies The notify events, sorted by position.
+	 * @param Cursor Index of the next notify to broadcast, advanced past every broadcast notify.
+	 * @param PreviousPosition The montage position when this was last called.
+	 * @param CurrentPosition The current montage position.
+	 */
+	static void HandleMontagePositionNotifies(IPlayMontageProInterface* Interface, FAnimNotifyProEvents& Notifies,
+		int32& Cursor, float PreviousPosition, float CurrentPosition);
 
 	/**
 	 * Broadcasts a notify event using the provided interface.
-	 * @param Event The notify event to broadcast.
+	 * If the event is a notify state end, its begin state is broadcast first.
+	 * @param Notifies The notify events containing the event and its pair.
+	 * @param NotifyIndex The index of the notify event to broadcast.
 	 * @param Interface The interface to use for broadcasting the event.
 	 */
-	static void BroadcastNotifyEvent(FAnimNotifyProEvent& Event, IPlayMontageProInterface* Interface);
+	static void BroadcastNotifyEvent(FAnimNotifyProEvents& Notifies, int32 NotifyIndex, IPlayMontageProInterface* Interface);
 
 	/**
 	 * Ensures that broadcast notify events are triggered for the specified event type.
 	 * @param EventType The type of event to ensure is broadcasted.
-	 * @param Notifies The array of notifies to check and broadcast.
+	 * @param Notifies The notify events to check and broadcast.
+	 * @param Interface The interface to use for broadcasting the events.
+	 */
+	static void EnsureBroadcastNotifyEvents(EAnimNotifyProEventType EventType, FAnimNotifyProEvents& Notifies, IPlayMontageProInterface* Interface);
+
+	/**
+	 * Gathers the events EnsureBroadcastNotifyEvents would broadcast for the event type, in index order, without broadcasting them.
+	 * Only reads the events, so it can run on any thread while the events are not modified.
+	 * @param EventType The type of event to ensure is broadcasted.
+	 * @param Notifies The notify events to check.
+	 * @param OutNotifyIndices Receives the indices of the events to broadcast.
+	 */
+	static void GatherEnsureNotifyEvents(EAnimNotifyProEventType EventType, const FAnimNotifyProEvents& Notifies, FAnimNotifyProEnsureIndices& OutNotifyIndices);
+
+	/**
+	 * Broadcasts events gathered by GatherEnsureNotifyEvents, skipping any that were broadcast since.
+	 * The events must not have been gathered again since, i.e. FAnimNotifyProEvents::FirstNotifyId must still match.
+	 * @param EventType The type of event the events were gathered for.
+	 * @param Notifies The notify events to broadcast.
+	 * @param NotifyIndices The indices gathered by GatherEnsureNotifyEvents.
 	 * @param Interface The interface to use for broadcasting the events.
 	 */
-	static void EnsureBroadcastNotifyEvents(EAnimNotifyProEventType EventType, TArray<FAnimNotifyProEvent>& Notifies, IPlayMontageProInterface* Interface);
+	static void BroadcastEnsureNotifyEvents(EAnimNotifyProEventType EventType, FAnimNotifyProEvents& Notifies,
+		TConstArrayView<int32> NotifyIndices, IPlayMontageProInterface* Interface);
 
 	/**
-	 * Handles time dilation for the montage, adjusting the TimeDilation factor and triggering notifies as needed.
-	 * Requires that the mesh component is ticking pose.
+	 * Handles time dilation for the montage, adjusting the TimeDilation factor and rescaling the notifies' clock as needed.
+	 * UPlayMontageProSubsystem::RegisterTimeDilation does this for every registered montage in a single pass per frame.
 	 * @param Interface The interface to use for broadcasting notify events.
 	 * @param MeshComp The skinned mesh component associated with the montage.
 	 * @param TimeDilation The current time dilation factor to adjust.
-	 * @param Notifies The array of notifies to handle.
+	 * @param Notifies The notify events to handle.
+	 */
+	static void HandleTimeDilation(IPlayMontageProInterface* Interface, const USkinnedMeshComponent* MeshComp, float& TimeDilation, FAnimNotifyProEvents& Notifies);
+
+	/**
+	 * Resolves the montage that triggered a notify through the anim notify system, from the montage instance in the event reference.
+	 * Notifies of a sequence played by one of the montage's slot segments resolve to the montage.
+	 * @return The montage, or null if the notify was triggered by an animation playing outside of a montage.
 	 */
-	static void HandleTimeDilation(IPlayMontageProInterface* Interface, const USkinnedMeshComponent* MeshComp, float& TimeDilation, TArray<FAnimNotifyProEvent>& Notifies);
+	static UAnimMontage* GetNotifyMontage(const USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation, const FAnimNotifyEventReference& EventReference);
 };
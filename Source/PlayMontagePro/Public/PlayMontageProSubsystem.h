@@ -0,0 +1,420 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PlayMontageProStatics.h"
+#include "PlayMontageTypes.h"
+#include "Containers/Queue.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/WeakInterfacePtr.h"
+#include "PlayMontageProSubsystem.generated.h"
+
+class AActor;
+class IPlayMontageProInterface;
+class UAnimMontage;
+class UAnimNotifyPro;
+class UAnimNotifyStatePro;
+class USkeletalMeshComponent;
+class UPlayMontageProBatchCallbackProxy;
+class UPlayMontageProCallbackProxy;
+struct FAnimNotifyProEvents;
+
+/**
+ * Pending notify in the scheduler heap, each instance only has an entry for its next due event.
+ * Entries are not removed when an instance is rescheduled or cleared, the handle simply stops matching
+ * and the entry is discarded once it reaches the top of the heap.
+ */
+struct FPlayMontageProScheduledNotify
+{
+	/** Scheduler time at which the notify should be triggered */
+	double FireTime = 0.0;
+
+	/** Unique handle, must match FAnimNotifyProEvents::ScheduleHandle for the entry to be dispatched */
+	uint64 Handle = 0;
+
+	/** Index of the event the entry was scheduled for, every event up to and including it is due */
+	int32 EventIndex = INDEX_NONE;
+
+	/** Owner of the notify */
+	TWeakInterfacePtr<IPlayMontageProInterface> Interface;
+
+	bool operator<(const FPlayMontageProScheduledNotify& Other) const
+	{
+		// Earliest fire time first, then in the order they were scheduled
+		return FireTime < Other.FireTime || (FireTime == Other.FireTime && Handle < Other.Handle);
+	}
+};
+
+/**
+ * Instance whose notify clock follows the CustomTimeDilation of an actor.
+ */
+struct FPlayMontageProTimeDilationWatch
+{
+	/** Actor whose CustomTimeDilation is followed */
+	TWeakObjectPtr<const AActor> Actor;
+
+	/** Owner of the notifies, reset when unregistered */
+	TWeakInterfacePtr<IPlayMontageProInterface> Interface;
+
+	/** Time dilation the notifies' clock is running at */
+	float TimeDilation = 1.f;
+};
+
+/**
+ * Montage instance that terminated, waiting for its ensured notifies to be broadcast with the rest of the frame's terminations.
+ */
+struct FPlayMontageProTermination
+{
+	/** Owner of the notifies */
+	TWeakInterfacePtr<IPlayMontageProInterface> Interface;
+
+	/** Condition the montage terminated with, None if no notifies need to be ensured */
+	EAnimNotifyProEventType EventType = EAnimNotifyProEventType::None;
+
+	/** FAnimNotifyProEvents::FirstNotifyId when queued, the termination is skipped if the notifies were gathered again or reset since */
+	uint32 FirstNotifyId = 0;
+
+	/** Proxy returned to the pool once the ensured notifies have been broadcast, referenced by the subsystem until then */
+	TObjectPtr<UPlayMontageProCallbackProxy> ProxyToRelease;
+};
+
+/**
+ * Callback of a notify with bThreadSafeCallback, waiting to run with the rest of the frame's batch.
+ */
+struct FPlayMontageProThreadSafeNotify
+{
+	/** Notify to call, null for notify states */
+	TWeakObjectPtr<const UAnimNotifyPro> Notify;
+
+	/** Notify state to call, null for notifies */
+	TWeakObjectPtr<const UAnimNotifyStatePro> NotifyState;
+
+	EAnimNotifyProType NotifyType = EAnimNotifyProType::Notify;
+
+	TWeakObjectPtr<USkeletalMeshComponent> MeshComp;
+	TWeakObjectPtr<UAnimMontage> Montage;
+};
+
+/**
+ * Active notify state with a tick rate, ticked by the subsystem until its end is broadcast.
+ */
+struct FPlayMontageProNotifyStateTick
+{
+	/** Returned by UPlayMontageProSubsystem::RegisterNotifyStateTick, never 0 */
+	uint32 Handle = 0;
+
+	TWeakObjectPtr<UAnimNotifyStatePro> NotifyState;
+	TWeakObjectPtr<USkeletalMeshComponent> MeshComp;
+	TWeakObjectPtr<UAnimMontage> Montage;
+
+	/** Scheduler time the state began or was last ticked at */
+	double LastTickTime = 0.0;
+
+	/** Scheduler time of the next tick, used by EAnimNotifyProTickRate::Frequency */
+	double NextTickTime = 0.0;
+
+	/** Seconds between ticks for EAnimNotifyProTickRate::Frequency, frames between ticks for EAnimNotifyProTickRate::EveryNthFrame */
+	float TickInterval = 0.f;
+	int32 FrameInterval = 1;
+
+	/** Frame offset for EAnimNotifyProTickRate::EveryNthFrame, so states that begin on the same frame are spread out */
+	int32 FramePhase = 0;
+
+	EAnimNotifyProTickRate TickRate = EAnimNotifyProTickRate::Disabled;
+};
+
+/** @return Whether the owner of the mesh is significant enough for cosmetic Pro notifies to be triggered */
+DECLARE_DELEGATE_RetVal_OneParam(bool, FPlayMontageProSignificanceQuery, const USkeletalMeshComponent* /*MeshComp*/);
+
+/**
+ * Statistics for the UPlayMontageProCallbackProxy pool of a world.
+ */
+USTRUCT(BlueprintType)
+struct PLAYMONTAGEPRO_API FPlayMontageProProxyPoolStats
+{
+	GENERATED_BODY()
+
+	/** Number of proxies that had to be created because the pool was empty */
+	UPROPERTY(BlueprintReadOnly, Category=Animation)
+	int32 NumCreated = 0;
+
+	/** Number of proxies that were taken from the pool instead of being created */
+	UPROPERTY(BlueprintReadOnly, Category=Animation)
+	int32 NumReused = 0;
+
+	/** Number of proxies waiting in the pool */
+	UPROPERTY(BlueprintReadOnly, Category=Animation)
+	int32 NumPooled = 0;
+
+	/** Number of proxies that finished this frame and will be returned to the pool */
+	UPROPERTY(BlueprintReadOnly, Category=Animation)
+	int32 NumPendingRelease = 0;
+};
+
+/**
+ * Schedules Pro notifies for every PlayMontagePro instance in the world.
+ * Every instance has a montage time clock and a single entry in a min-heap keyed on the fire time of its next event.
+ * Due notifies are dispatched in one batched pass per frame, and rescaling an instance's clock only replaces its one entry.
+ * Also pools UPlayMontageProCallbackProxy objects so that playing a montage does not create a new UObject every time.
+ */
+UCLASS()
+class PLAYMONTAGEPRO_API UPlayMontageProSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UPlayMontageProSubsystem* Get(const UWorld* World);
+
+	/**
+	 * Schedules the next event from Events.NextEventIndex that has not been broadcast or skipped, based on the events' clock.
+	 * Events are dispatched in order from there, each time scheduling the next one.
+	 * @param Interface The interface that owns the events and will broadcast them.
+	 * @param Events The interface's notify events, receive the schedule handle.
+	 */
+	void ScheduleNotifies(IPlayMontageProInterface* Interface, FAnimNotifyProEvents& Events);
+
+	/** Removes the events from the schedule, they will not be broadcast by the scheduler */
+	void UnscheduleNotifies(FAnimNotifyProEvents& Events);
+
+	/**
+	 * Defers ordering the heap until the matching EndScheduleBatch, so scheduling many instances at once is a single heapify.
+	 * Nothing may be dispatched from the heap in between, batches are meant to be opened and closed within one call.
+	 * @see FPlayMontageProScopedScheduleBatch
+	 */
+	void BeginScheduleBatch() { ScheduleBatchDepth++; }
+	void EndScheduleBatch();
+
+	/**
+	 * Changes the time dilation of the events' clock from now on and moves their pending entry accordingly.
+	 * Cost is independent of the number of events.
+	 */
+	void SetTimeDilation(IPlayMontageProInterface* Interface, FAnimNotifyProEvents& Events, float TimeDilation);
+
+	/**
+	 * Follows the CustomTimeDilation of Actor until unregistered, rescaling the interface's notify clock when it changes.
+	 * Every registered actor is checked in a single pass per frame, so unchanged dilation costs a compare and nothing is bound to the actor.
+	 * @param Interface The interface that owns the notifies.
+	 * @param Actor The actor whose CustomTimeDilation is followed.
+	 * @param TimeDilation The time dilation the notifies' clock is currently running at.
+	 */
+	void RegisterTimeDilation(IPlayMontageProInterface* Interface, const AActor* Actor, float TimeDilation);
+	void UnregisterTimeDilation(IPlayMontageProInterface* Interface);
+
+	/** Calls IPlayMontageProInterface::TickMontagePosition once per frame until unregistered */
+	void RegisterMontagePositionDispatch(IPlayMontageProInterface* Interface);
+	void UnregisterMontagePositionDispatch(IPlayMontageProInterface* Interface);
+
+	/**
+	 * Queues the termination of a montage instance, its ensured notifies are broadcast with every other termination once per frame.
+	 * Which notifies must be ensured is computed for every terminated instance in parallel, then they are broadcast in the order
+	 * the terminations were queued. If the interface's notifies are gathered again or reset before then, the termination is skipped.
+	 * The broadcast is deferred to the subsystem's tick, after the montage delegates. If a delegate plays another montage on the same
+	 * mesh, its notifies that trigger at its start do so before these end.
+	 * @param Interface The interface that owns the notifies.
+	 * @param EventType The condition the montage terminated with, None to only release the proxy.
+	 * @param ProxyToRelease Optional proxy returned to the pool once the notifies have been broadcast.
+	 */
+	void QueueTermination(IPlayMontageProInterface* Interface, EAnimNotifyProEventType EventType,
+		UPlayMontageProCallbackProxy* ProxyToRelease = nullptr);
+
+	/**
+	 * Queues the callback of a notify with bThreadSafeCallback, every queued callback is run in parallel once per frame.
+	 * Callbacks of the same mesh run in the order they were queued.
+	 * Notifies whose mesh has no world, and so no subsystem, call their any thread callback inline on the game thread instead.
+	 */
+	void QueueThreadSafeNotify(const UAnimNotifyPro* Notify, const UAnimNotifyStatePro* NotifyState, EAnimNotifyProType NotifyType,
+		USkeletalMeshComponent* MeshComp, UAnimMontage* Montage);
+
+	/**
+	 * Ticks the notify state on the mesh at its TickRate until its handle is unregistered, or its montage stops.
+	 * Every ticking state is kept in one dense array and ticked in a single pass per frame, after the frame's notifies.
+	 * @param ExistingHandle Handle of the state's previous begin, if it is still registered only its montage is updated.
+	 * @return Handle to unregister the tick with, 0 if the state doesn't tick.
+	 */
+	uint32 RegisterNotifyStateTick(UAnimNotifyStatePro* NotifyState, USkeletalMeshComponent* MeshComp, UAnimMontage* Montage,
+		uint32 ExistingHandle = 0);
+	void UnregisterNotifyStateTick(uint32 Handle);
+
+	/** Unregisters every tick still held by the events, e.g. when they are reset without their states having ended */
+	void UnregisterNotifyStateTicks(FAnimNotifyProEvents& Notifies);
+
+	/** @return Number of notify states currently ticking, including any unregistered this frame */
+	int32 GetNumTickingNotifyStates() const { return NotifyStateTicks.Num(); }
+
+	/**
+	 * Queues work to run on the game thread after the frame's thread safe notifies. Can be called from any thread.
+	 */
+	void EnqueueGameThreadTask(TUniqueFunction<void()>&& Task) { GameThreadTasks.Enqueue(MoveTemp(Task)); }
+
+	/**
+	 * Whether the owner of the mesh is significant enough for its cosmetic notifies to be triggered.
+	 * Asks SignificanceQuery if bound, otherwise meshes not rendered within a.PlayMontagePro.CullCosmeticNotRenderedTime are not significant.
+	 */
+	bool IsSignificant(const USkeletalMeshComponent* MeshComp) const;
+
+	/** Bind to decide which meshes are significant, e.g. from the game's significance manager or LOD */
+	FPlayMontageProSignificanceQuery SignificanceQuery;
+
+	/** @return A proxy from the pool, or a new proxy if the pool is empty */
+	UPlayMontageProCallbackProxy* AcquireProxy();
+
+	/** Appends Num proxies to OutProxies, taken from the pool first and created for the rest */
+	void AcquireProxies(int32 Num, TArray<UPlayMontageProCallbackProxy*>& OutProxies);
+
+	/** Keeps the batch alive until it is unregistered, i.e. until every montage in it has ended */
+	void RegisterBatch(UPlayMontageProBatchCallbackProxy* Batch);
+	void UnregisterBatch(UPlayMontageProBatchCallbackProxy* Batch);
+
+	/**
+	 * Returns a proxy to the pool once it has finished.
+	 * The proxy is reset and made available on the next tick, so that anything still bound to it this frame is unaffected.
+	 */
+	void ReleaseProxy(UPlayMontageProCallbackProxy* Proxy);
+
+	/** @return Statistics for the proxy pool of this world */
+	UFUNCTION(BlueprintPure, Category=Animation)
+	FPlayMontageProProxyPoolStats GetProxyPoolStats() const;
+
+	/** @return Current scheduler time */
+	double GetTime() const { return CurrentTime; }
+
+	/** @return Number of entries in the heap, including stale entries that have not been discarded yet */
+	int32 GetNumScheduled() const { return Heap.Num(); }
+
+	static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
+
+	// Begin FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	// ~End FTickableGameObject
+
+protected:
+	/** Rescales the clock of every registered instance whose actor's CustomTimeDilation changed */
+	void UpdateTimeDilations();
+
+	/** Broadcasts every notify whose fire time has been reached */
+	void DispatchDueNotifies();
+
+	/** Broadcasts the events of one instance up to DueIndex and any others already reached by its clock, then schedules the next */
+	void DispatchScheduledNotifies(IPlayMontageProInterface* Interface, FAnimNotifyProEvents& Events, int32 DueIndex);
+
+	/** Lets every instance using EAnimNotifyProDispatchMode::MontagePosition broadcast the notifies it crossed */
+	void DispatchMontagePositionNotifies();
+
+	/** Broadcasts the ensured notifies of every queued termination, then releases their proxies */
+	void DispatchTerminations();
+
+	/** Runs the queued thread safe notifies in parallel, then the game thread tasks they queued */
+	void DispatchThreadSafeNotifies();
+
+	/** Ticks every registered notify state that is due this frame */
+	void TickNotifyStates();
+
+	/** Rebuilds the heap without stale entries */
+	void CompactHeap();
+
+	/** Resets proxies released since the last tick and returns them to the pool */
+	void RecycleReleasedProxies();
+
+	static bool IsEntryValid(const FPlayMontageProScheduledNotify& Entry);
+
+protected:
+	/** Min-heap of pending notifies */
+	TArray<FPlayMontageProScheduledNotify> Heap;
+
+	/** Instances driven by their montage position, entries are reset when unregistered and removed after dispatch */
+	TArray<TWeakInterfacePtr<IPlayMontageProInterface>> MontagePositionInstances;
+
+	/** Instances following their actor's time dilation, entries are reset when unregistered and removed after checking */
+	TArray<FPlayMontageProTimeDilationWatch> TimeDilationWatches;
+
+	/** Accumulated (dilated) world time, advanced each tick */
+	double CurrentTime = 0.0;
+
+	/** Last handle that was assigned */
+	uint64 LastHandle = 0;
+
+	/** Number of entries known to be stale, used to decide when to compact the heap */
+	int32 NumStaleEntries = 0;
+
+	/** Depth of nested schedule batches, entries are appended without ordering the heap while above 0 */
+	int32 ScheduleBatchDepth = 0;
+
+	/** Number of entries appended by the current schedule batch */
+	int32 NumBatchedEntries = 0;
+
+	/** Terminations queued since the last dispatch */
+	TArray<FPlayMontageProTermination> Terminations;
+
+	/** Terminations being dispatched, swapped with Terminations so that callbacks can queue more */
+	TArray<FPlayMontageProTermination> TerminationBatch;
+
+	/** Ensured notify indices for each termination in the batch, kept to reuse their allocations */
+	TArray<FAnimNotifyProEnsureIndices> TerminationIndices;
+
+	/** Thread safe notifies queued since the last dispatch */
+	TArray<FPlayMontageProThreadSafeNotify> ThreadSafeNotifies;
+
+	/** Notify states with a tick rate, entries are reset when unregistered and removed after ticking */
+	TArray<FPlayMontageProNotifyStateTick> NotifyStateTicks;
+
+	/** Frames ticked, used by EAnimNotifyProTickRate::EveryNthFrame */
+	uint32 FrameCounter = 0;
+
+	/** Index in NotifyStateTicks of each registered handle, updated when entries are compacted */
+	TMap<uint32, int32> NotifyStateTickIndices;
+
+	/** Notify state ticks registered so far, used as the handle of the next one and staggers its phase */
+	uint32 NumNotifyStateTicksRegistered = 0;
+
+	/** Number of reset entries in NotifyStateTicks, removed after the next tick pass */
+	int32 NumUnregisteredTicks = 0;
+
+	/** Work queued by thread safe notifies, or any other thread, for the game thread */
+	TQueue<TUniqueFunction<void()>, EQueueMode::Mpsc> GameThreadTasks;
+
+	/** Proxies available for reuse */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UPlayMontageProCallbackProxy>> PooledProxies;
+
+	/** Proxies that finished since the last tick */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UPlayMontageProCallbackProxy>> ReleasedProxies;
+
+	/** Batches with montages still playing */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UPlayMontageProBatchCallbackProxy>> ActiveBatches;
+
+	/** Lifetime counters for the proxy pool */
+	int32 NumProxiesCreated = 0;
+	int32 NumProxiesReused = 0;
+};
+
+/**
+ * Opens a schedule batch on the subsystem for its scope, see UPlayMontageProSubsystem::BeginScheduleBatch.
+ */
+struct FPlayMontageProScopedScheduleBatch
+{
+	explicit FPlayMontageProScopedScheduleBatch(UPlayMontageProSubsystem* InSubsystem)
+		: Subsystem(InSubsystem)
+	{
+		if (Subsystem)
+		{
+			Subsystem->BeginScheduleBatch();
+		}
+	}
+
+	~FPlayMontageProScopedScheduleBatch()
+	{
+		if (Subsystem)
+		{
+			Subsystem->EndScheduleBatch();
+		}
+	}
+
+	UE_NONCOPYABLE(FPlayMontageProScopedScheduleBatch);
+
+private:
+	UPlayMontageProSubsystem* Subsystem;
+};
@@ -3,24 +3,26 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "Engine/TimerHandle.h"
-#include "TimerManager.h"
 #include "PlayMontageTypes.generated.h"
 
+class UAnimMontage;
 class UAnimNotifyStatePro;
 class UAnimNotifyPro;
+class USkeletalMeshComponent;
 
 /**
  * Legacy behavior for anim notifies on simulated proxies.
  * This enum is used to determine how anim notifies should behave on simulated proxies.
  * If set to Legacy, the notify will be triggered on simulated proxies no different to the old system.
  * If set to Disabled, the notify will not be triggered on simulated proxies, only on authority and local clients.
+ * If set to Replicated, the notify is triggered on simulated proxies by the Pro notify system from the state replicated by UPlayMontageProReplicationComponent.
  */
 UENUM(BlueprintType)
 enum class EAnimNotifyLegacyType : uint8
 {
 	Legacy			UMETA(ToolTip="Legacy behavior, notify will be triggered on simulated proxies no different to the old system"),
 	Disabled		UMETA(ToolTip="Notify will not be triggered on simulated proxies, only on authority and local clients"),
+	Replicated		UMETA(ToolTip="Notify is triggered on simulated proxies by the Pro notify system, requires a PlayMontageProReplicationComponent on the actor"),
 };
 
 /**
@@ -38,6 +40,85 @@ enum class EAnimNotifyProEventType : uint8
 };
 ENUM_CLASS_FLAGS(EAnimNotifyProEventType)
 
+/**
+ * How Pro notifies are dispatched while the montage is playing.
+ * Used by UPlayMontageProCallbackProxy.
+ */
+UENUM(BlueprintType)
+enum class EAnimNotifyProDispatchMode : uint8
+{
+	Timer				UMETA(ToolTip="Notifies are scheduled from their montage position when the montage starts or changes section, independent of the animation update"),
+	MontagePosition		UMETA(ToolTip="Notifies are triggered when the montage position crosses them, keeping them in sync with the pose, play rate and any hitches or pauses"),
+	FixedStep			UMETA(Hidden, ToolTip="Notifies are triggered on integer ticks of a fixed-step clock advanced by the owner in C++, so they trigger on the same tick on server, client and replays"),
+};
+
+/**
+ * How a montage played with PlayMontagePro finished.
+ * Used by UPlayMontageProBatchCallbackProxy.
+ */
+UENUM(BlueprintType)
+enum class EPlayMontageProResult : uint8
+{
+	Completed		UMETA(ToolTip="Montage finished playing and wasn't interrupted"),
+	Interrupted		UMETA(ToolTip="Montage was interrupted"),
+	FailedToPlay	UMETA(ToolTip="Montage could not be played, e.g. the mesh has no anim instance"),
+};
+
+/**
+ * How often an active Pro notify state is ticked.
+ * Used by UAnimNotifyStatePro, ticks are batched by UPlayMontageProSubsystem.
+ */
+UENUM(BlueprintType)
+enum class EAnimNotifyProTickRate : uint8
+{
+	Disabled		UMETA(ToolTip="Notify state is not ticked"),
+	EveryFrame		UMETA(ToolTip="Notify state is ticked every frame"),
+	Frequency		UMETA(ToolTip="Notify state is ticked TickFrequency times per second, staggered so states that begin together tick at different times"),
+	EveryNthFrame	UMETA(ToolTip="Notify state is ticked every TickFrameInterval frames, staggered so states that begin together tick on different frames"),
+};
+
+/**
+ * What happens to the Pro notifies of driven montages.
+ * Used by UPlayMontageProCallbackProxy when playing a driver montage with driven montages.
+ */
+UENUM(BlueprintType)
+enum class EPlayMontageProDrivenNotifyPolicy : uint8
+{
+	Suppress		UMETA(ToolTip="Only the driver montage's notifies are triggered, driven montages only play their animation"),
+	Merge			UMETA(ToolTip="Driven montages' notifies are merged into the driver's schedule and triggered with the driven mesh and montage"),
+};
+
+/**
+ * A montage played on another mesh that follows a driver montage, e.g. the weapon or first-person arms following a third-person reload.
+ * Used by UPlayMontageProCallbackProxy.
+ */
+USTRUCT(BlueprintType)
+struct PLAYMONTAGEPRO_API FPlayMontageProDrivenMontage
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Animation)
+	TObjectPtr<USkeletalMeshComponent> Mesh = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Animation)
+	TObjectPtr<UAnimMontage> Montage = nullptr;
+
+	/** Scale the play rate so the driven montage lasts as long as the driver montage, otherwise it plays at the driver's play rate */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Animation)
+	bool bMatchDriverDuration = true;
+};
+
+/**
+ * How important a Pro notify is when its owner is not significant, e.g. distant or off-screen.
+ * Used by UAnimNotifyPro and UAnimNotifyStatePro.
+ */
+UENUM(BlueprintType)
+enum class EAnimNotifyProSignificance : uint8
+{
+	Critical		UMETA(ToolTip="Notify is always triggered"),
+	Cosmetic		UMETA(ToolTip="Notify is skipped when its owner is not significant, unless it ensures it is triggered for any condition"),
+};
+
 /**
  * Type of anim notify event, used to determine which callback to use.
  * Used by FAnimNotifyProEvent.
@@ -52,22 +133,23 @@ enum class EAnimNotifyProType : uint8
 /**
  * Struct representing an anim notify event.
  * Contains information about the notify, such as its ID, time, and whether it has been broadcast.
- * Used by PlayMontagePro to handle anim notifies and notify states.
+ * Built from FAnimNotifyProEvents when a notify is broadcast, PlayMontagePro does not store these while playing.
  */
 USTRUCT()
 struct PLAYMONTAGEPRO_API FAnimNotifyProEvent
 {
 	GENERATED_BODY()
 	
-	FAnimNotifyProEvent(uint32 InNotifyId = 0, int32 InEnsureTriggerNotify = 0, EAnimNotifyProType InNotifyType = EAnimNotifyProType::Notify, float InTime = 0.f)
+	FAnimNotifyProEvent(uint32 InNotifyId = 0, int32 InEnsureTriggerNotify = 0, EAnimNotifyProType InNotifyType = EAnimNotifyProType::Notify, float InTime = 0.f, float InPosition = 0.f)
 		: EnsureTriggerNotify(InEnsureTriggerNotify)
 		, bEnsureEndStateIfTriggered(true)
 		, Time(InTime)
+		, Position(InPosition)
 		, NotifyId(InNotifyId)
 		, bHasBroadcast(false)
 		, bIsEndState(false)
 		, bNotifySkipped(false)
-		, NotifyStatePair(nullptr)
+		, NotifyStatePairIndex(INDEX_NONE)
 		, NotifyType(InNotifyType)
 	{}
 
@@ -83,6 +165,10 @@ struct PLAYMONTAGEPRO_API FAnimNotifyProEvent
 	UPROPERTY()
 	float Time;
 
+	/** Position in the montage at which the notify should be triggered */
+	UPROPERTY()
+	float Position;
+
 	/** Unique ID for the notify, used to identify it in the list of notifies */
 	UPROPERTY()
 	uint32 NotifyId;
@@ -99,18 +185,13 @@ struct PLAYMONTAGEPRO_API FAnimNotifyProEvent
 	UPROPERTY()
 	bool bNotifySkipped;
 
-	/** Pointer to the paired notify state, used for notify states to link begin and end states */
-	TObjectPtr<FAnimNotifyProEvent> NotifyStatePair;
+	/** Index of the paired notify state in the same notify array, used for notify states to link begin and end states */
+	UPROPERTY()
+	int32 NotifyStatePairIndex;
 
 	/** Type of the notify, used to determine which callback to use */
 	EAnimNotifyProType NotifyType;
 
-	/** Timer handle for the notify */
-	FTimerHandle Timer;
-
-	/** Delegate to call when the timer expires */
-	FTimerDelegate TimerDelegate;
-
 	/** Weak pointer to the notify object, used to call the notify callback */
 	UPROPERTY()
 	TWeakObjectPtr<UAnimNotifyPro> Notify;
@@ -119,16 +200,6 @@ struct PLAYMONTAGEPRO_API FAnimNotifyProEvent
 	UPROPERTY()
 	TWeakObjectPtr<UAnimNotifyStatePro> NotifyState;
 
-	/** Function to call when the timer expires, used to trigger the notify */
-	void OnTimer();
-
-	/** Clears the timer and delegate, used to clean up the notify when it is no longer needed */
-	void ClearTimers()
-	{
-		if (Timer.IsValid())			{ Timer.Invalidate(); }
-		if (TimerDelegate.IsBound())	{ TimerDelegate.Unbind(); }
-	}
-
 	bool IsValid() const { return NotifyId > 0 && (Notify.IsValid() || NotifyState.IsValid()); }
 
 	bool operator==(const FAnimNotifyProEvent& Other) const
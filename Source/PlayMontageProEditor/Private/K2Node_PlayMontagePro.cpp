@@ -48,6 +48,7 @@ void UK2Node_PlayMontagePro::GetPinHoverText(const UEdGraphPin& Pin, FString& Ho
 	static const FName NAME_TriggerNotifiesBeforeStartTime = FName(TEXT("bTriggerNotifiesBeforeStartTime"));
 	static const FName NAME_EnableCustomTimeDilation = FName(TEXT("bEnableCustomTimeDilation"));
 	static const FName NAME_ShouldStopAllMontages = FName(TEXT("bShouldStopAllMontages"));
+	static const FName NAME_DispatchMode = FName(TEXT("DispatchMode"));
 	static const FName NAME_OnNotify = FName(TEXT("OnNotify"));
 	static const FName NAME_OnNotifyBegin = FName(TEXT("OnNotifyStateBegin"));
 	static const FName NAME_OnNotifyEnd = FName(TEXT("OnNotifyStateEnd"));
@@ -84,7 +85,7 @@ void UK2Node_PlayMontagePro::GetPinHoverText(const UEdGraphPin& Pin, FString& Ho
 	}
 	if (Pin.PinName == NAME_EnableCustomTimeDilation)
 	{
-		const FText ToolTipText = LOCTEXT("K2Node_PlayMontagePro_EnableCustomTimeDilation_Tooltip", "Whether to enable custom time dilation for the montage. Requires the mesh component to tick pose. May have additional performance overhead.");
+		const FText ToolTipText = LOCTEXT("K2Node_PlayMontagePro_EnableCustomTimeDilation_Tooltip", "Whether to enable custom time dilation for the montage. Changes are picked up once per frame by UPlayMontageProSubsystem.");
 		HoverTextOut = FString::Printf(TEXT("%s\n%s"), *ToolTipText.ToString(), *HoverTextOut);
 	}
 	else if (Pin.PinName == NAME_ShouldStopAllMontages)
@@ -92,6 +93,11 @@ void UK2Node_PlayMontagePro::GetPinHoverText(const UEdGraphPin& Pin, FString& Ho
 		const FText ToolTipText = LOCTEXT("K2Node_PlayMontagePro_ShouldStopAllMontages_Tooltip", "Whether to stop all other montages before playing this one.");
 		HoverTextOut = FString::Printf(TEXT("%s\n%s"), *ToolTipText.ToString(), *HoverTextOut);
 	}
+	else if (Pin.PinName == NAME_DispatchMode)
+	{
+		const FText ToolTipText = LOCTEXT("K2Node_PlayMontagePro_DispatchMode_Tooltip", "How notifies are dispatched. Timer schedules them when the montage starts or changes section. MontagePosition triggers them when the montage position crosses them, following play rate and time dilation.");
+		HoverTextOut = FString::Printf(TEXT("%s\n%s"), *ToolTipText.ToString(), *HoverTextOut);
+	}
 	else if (Pin.PinName == NAME_OnNotify)
 	{
 		const FText ToolTipText = LOCTEXT("K2Node_PlayMontagePro_OnNotify_Tooltip", "Event called when using a UAnimNotifyPro Notify in a Montage.");
@@ -0,0 +1,52 @@
+// Copyright (c) Jared Taylor
+
+#include "K2Node_PlayMontageProBatch.h"
+
+#include "EdGraph/EdGraphPin.h"
+#include "PlayMontageProBatchCallbackProxy.h"
+
+#define LOCTEXT_NAMESPACE "K2Node"
+
+UK2Node_PlayMontageProBatch::UK2Node_PlayMontageProBatch(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	ProxyFactoryFunctionName = GET_FUNCTION_NAME_CHECKED(UPlayMontageProBatchCallbackProxy, CreateProxyObjectForPlayMontageProBatch);
+	ProxyFactoryClass = UPlayMontageProBatchCallbackProxy::StaticClass();
+	ProxyClass = UPlayMontageProBatchCallbackProxy::StaticClass();
+}
+
+FText UK2Node_PlayMontageProBatch::GetTooltipText() const
+{
+	return LOCTEXT("K2Node_PlayMontageProBatch_Tooltip", "Plays the same Montage on many SkeletalMeshComponents at once with custom notify support using UAnimNotifyPro and UAnimNotifyStatePro.");
+}
+
+FText UK2Node_PlayMontageProBatch::GetNodeTitle(ENodeTitleType::Type TitleType) const
+{
+	return LOCTEXT("PlayMontageProBatch", "Play Montage Pro (Batch)");
+}
+
+FText UK2Node_PlayMontageProBatch::GetMenuCategory() const
+{
+	return LOCTEXT("PlayMontageProCategory", "Animation|Montage");
+}
+
+void UK2Node_PlayMontageProBatch::GetPinHoverText(const UEdGraphPin& Pin, FString& HoverTextOut) const
+{
+	Super::GetPinHoverText(Pin, HoverTextOut);
+
+	static const FName NAME_InSkeletalMeshComponents = FName(TEXT("InSkeletalMeshComponents"));
+	static const FName NAME_OnAllEnded = FName(TEXT("OnAllEnded"));
+
+	if (Pin.PinName == NAME_InSkeletalMeshComponents)
+	{
+		const FText ToolTipText = LOCTEXT("K2Node_PlayMontageProBatch_InSkeletalMeshComponents_Tooltip", "The SkeletalMeshComponents to play the montage on.");
+		HoverTextOut = FString::Printf(TEXT("%s\n%s"), *ToolTipText.ToString(), *HoverTextOut);
+	}
+	else if (Pin.PinName == NAME_OnAllEnded)
+	{
+		const FText ToolTipText = LOCTEXT("K2Node_PlayMontageProBatch_OnAllEnded_Tooltip", "Event called once the montage has ended on every mesh, with how it ended on each of them.");
+		HoverTextOut = FString::Printf(TEXT("%s\n%s"), *ToolTipText.ToString(), *HoverTextOut);
+	}
+}
+
+#undef LOCTEXT_NAMESPACE
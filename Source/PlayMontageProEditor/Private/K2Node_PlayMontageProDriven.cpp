@@ -0,0 +1,47 @@
+// Copyright (c) Jared Taylor
+
+#include "K2Node_PlayMontageProDriven.h"
+
+#include "EdGraph/EdGraphPin.h"
+#include "PlayMontageProCallbackProxy.h"
+
+#define LOCTEXT_NAMESPACE "K2Node"
+
+UK2Node_PlayMontageProDriven::UK2Node_PlayMontageProDriven(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	ProxyFactoryFunctionName = GET_FUNCTION_NAME_CHECKED(UPlayMontageProCallbackProxy, CreateProxyObjectForPlayMontageProDriven);
+	ProxyFactoryClass = UPlayMontageProCallbackProxy::StaticClass();
+	ProxyClass = UPlayMontageProCallbackProxy::StaticClass();
+}
+
+FText UK2Node_PlayMontageProDriven::GetTooltipText() const
+{
+	return LOCTEXT("K2Node_PlayMontageProDriven_Tooltip", "Plays a driver Montage on a SkeletalMeshComponent and driven Montages on other meshes alongside it, with a single schedule for the custom notifies using UAnimNotifyPro and UAnimNotifyStatePro.");
+}
+
+FText UK2Node_PlayMontageProDriven::GetNodeTitle(ENodeTitleType::Type TitleType) const
+{
+	return LOCTEXT("PlayMontageProDriven", "Play Montage Pro (Driven)");
+}
+
+void UK2Node_PlayMontageProDriven::GetPinHoverText(const UEdGraphPin& Pin, FString& HoverTextOut) const
+{
+	Super::GetPinHoverText(Pin, HoverTextOut);
+
+	static const FName NAME_InDrivenMontages = FName(TEXT("InDrivenMontages"));
+	static const FName NAME_InDrivenNotifyPolicy = FName(TEXT("InDrivenNotifyPolicy"));
+
+	if (Pin.PinName == NAME_InDrivenMontages)
+	{
+		const FText ToolTipText = LOCTEXT("K2Node_PlayMontageProDriven_InDrivenMontages_Tooltip", "Montages to play on other meshes alongside the driver montage, optionally matching its duration. They follow its section changes and are stopped if it is interrupted.");
+		HoverTextOut = FString::Printf(TEXT("%s\n%s"), *ToolTipText.ToString(), *HoverTextOut);
+	}
+	else if (Pin.PinName == NAME_InDrivenNotifyPolicy)
+	{
+		const FText ToolTipText = LOCTEXT("K2Node_PlayMontageProDriven_InDrivenNotifyPolicy_Tooltip", "Whether the driven montages' Pro notifies are suppressed, or merged into the driver montage's schedule. Merged notifies are not replicated.");
+		HoverTextOut = FString::Printf(TEXT("%s\n%s"), *ToolTipText.ToString(), *HoverTextOut);
+	}
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,27 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "K2Node_BaseAsyncTask.h"
+#include "UObject/ObjectMacros.h"
+
+#include "K2Node_PlayMontageProBatch.generated.h"
+
+class UEdGraphPin;
+
+UCLASS()
+class UK2Node_PlayMontageProBatch : public UK2Node_BaseAsyncTask
+{
+	GENERATED_UCLASS_BODY()
+
+	//~ Begin UEdGraphNode Interface
+	virtual FText GetTooltipText() const override;
+	virtual FText GetNodeTitle(ENodeTitleType::Type TitleType) const override;
+	virtual void GetPinHoverText(const UEdGraphPin& Pin, FString& HoverTextOut) const override;
+	//~ End UEdGraphNode Interface
+
+	//~ Begin UK2Node Interface
+	virtual FText GetMenuCategory() const override;
+	//~ End UK2Node Interface
+};
@@ -0,0 +1,23 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "K2Node_PlayMontagePro.h"
+#include "UObject/ObjectMacros.h"
+
+#include "K2Node_PlayMontageProDriven.generated.h"
+
+class UEdGraphPin;
+
+UCLASS()
+class UK2Node_PlayMontageProDriven : public UK2Node_PlayMontagePro
+{
+	GENERATED_UCLASS_BODY()
+
+	//~ Begin UEdGraphNode Interface
+	virtual FText GetTooltipText() const override;
+	virtual FText GetNodeTitle(ENodeTitleType::Type TitleType) const override;
+	virtual void GetPinHoverText(const UEdGraphPin& Pin, FString& HoverTextOut) const override;
+	//~ End UEdGraphNode Interface
+};
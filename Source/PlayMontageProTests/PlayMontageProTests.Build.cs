@@ -0,0 +1,28 @@
+// Copyright (c) Jared Taylor
+
+using UnrealBuildTool;
+
+public class PlayMontageProTests : ModuleRules
+{
+	public PlayMontageProTests(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+			}
+			);
+			
+		
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"CoreUObject",
+				"Engine",
+				"PlayMontagePro",
+			}
+			);
+	}
+}
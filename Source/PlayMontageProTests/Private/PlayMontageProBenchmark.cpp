@@ -0,0 +1,359 @@
+// Copyright (c) Jared Taylor
+
+#include "AnimNotifyProTable.h"
+#include "PlayMontageProInterface.h"
+#include "PlayMontageProStatics.h"
+#include "PlayMontageProTestHelpers.h"
+#include "PlayMontageProTestNotifies.h"
+#include "Animation/AnimMontage.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformTLS.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/OutputDevice.h"
+#include "UObject/StrongObjectPtr.h"
+#include "UObject/UObjectGlobals.h"
+
+#if !UE_BUILD_SHIPPING
+namespace PlayMontageProBenchmark
+{
+	/** Owns the notifies being measured, callbacks only reach the stub notify objects */
+	class FBenchmarkInterface final : public IPlayMontageProInterface
+	{
+	public:
+		FAnimNotifyProEvents Notifies;
+		UAnimMontage* Montage = nullptr;
+
+		virtual void BroadcastNotifyEvent(int32 NotifyIndex) override { UPlayMontageProStatics::BroadcastNotifyEvent(Notifies, NotifyIndex, this); }
+		virtual void NotifyCallback(const FAnimNotifyProEvent& Event) override {}
+		virtual void NotifyBeginCallback(const FAnimNotifyProEvent& Event) override {}
+		virtual void NotifyEndCallback(const FAnimNotifyProEvent& Event) override {}
+
+		virtual UAnimMontage* GetMontage() const override { return Montage; }
+		virtual USkeletalMeshComponent* GetMesh() const override { return nullptr; }
+
+		virtual FAnimNotifyProEvents& GetNotifies() override { return Notifies; }
+	};
+
+	/**
+	 * Forwards to the allocator it replaces, counting what the game thread allocates while counting is enabled.
+	 * Installed in place of GMalloc only while counting, and never destroyed, as another thread may still be calling through it.
+	 */
+	class FCountingMalloc final : public FMalloc
+	{
+	public:
+		static FCountingMalloc& Get()
+		{
+			static FCountingMalloc Counter(GMalloc);
+			return Counter;
+		}
+
+		void Begin()
+		{
+			check(IsInGameThread());
+			NumAllocations = 0;
+			NumBytes = 0;
+			GMalloc = this;
+			bCounting = true;
+		}
+
+		void End()
+		{
+			bCounting = false;
+			GMalloc = Inner;
+		}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			Record(Count);
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			// Reallocating to zero frees
+			if (Count > 0)
+			{
+				Record(Count);
+			}
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+		int64 NumAllocations = 0;
+		int64 NumBytes = 0;
+
+	private:
+		explicit FCountingMalloc(FMalloc* InInner)
+			: Inner(InInner)
+			, GameThreadId(FPlatformTLS::GetCurrentThreadId())
+		{
+		}
+
+		void Record(SIZE_T Count)
+		{
+			if (bCounting && FPlatformTLS::GetCurrentThreadId() == GameThreadId)
+			{
+				NumAllocations++;
+				NumBytes += Count;
+			}
+		}
+
+		FMalloc* Inner;
+		uint32 GameThreadId;
+		bool bCounting = false;
+	};
+
+	/** Average cost of one call */
+	struct FMeasurement
+	{
+		double Nanoseconds = 0.0;
+		double Allocations = 0.0;
+		double Bytes = 0.0;
+
+		FMeasurement operator-(const FMeasurement& Other) const
+		{
+			return { Nanoseconds - Other.Nanoseconds, Allocations - Other.Allocations, Bytes - Other.Bytes };
+		}
+	};
+
+	/** @return Average cost per call of Func, which makes NumCalls calls, once the first run has warmed up any allocations */
+	template<typename FuncType>
+	static FMeasurement Measure(int32 Iterations, int32 NumCalls, FuncType&& Func)
+	{
+		Func();
+		const double NumTotalCalls = static_cast<double>(Iterations) * FMath::Max(1, NumCalls);
+
+		FMeasurement Result;
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			Func();
+		}
+		Result.Nanoseconds = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) * 1000000.0 / NumTotalCalls;
+
+		// Counted separately, so the counting isn't part of the time
+		FCountingMalloc& Counter = FCountingMalloc::Get();
+		Counter.Begin();
+		for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			Func();
+		}
+		Counter.End();
+		Result.Allocations = Counter.NumAllocations / NumTotalCalls;
+		Result.Bytes = Counter.NumBytes / NumTotalCalls;
+		return Result;
+	}
+
+	static SIZE_T GetAllocatedSize(const FAnimNotifyProSectionTable& Table)
+	{
+		SIZE_T Size = Table.Positions.GetAllocatedSize() + Table.Types.GetAllocatedSize() + Table.PairIndices.GetAllocatedSize()
+			+ Table.EnsureTriggerNotify.GetAllocatedSize() + Table.Notifies.GetAllocatedSize() + Table.NotifyStates.GetAllocatedSize()
+			+ Table.Sources.GetAllocatedSize() + Table.EndStateMask.GetAllocatedSize() + Table.CosmeticMask.GetAllocatedSize();
+		for (const TArray<uint32>& EnsureMask : Table.EnsureMasks)
+		{
+			Size += EnsureMask.GetAllocatedSize();
+		}
+		return Size;
+	}
+
+	static SIZE_T GetAllocatedSize(const FAnimNotifyProMontageTable& Table)
+	{
+		SIZE_T Size = GetAllocatedSize(Table.InvalidSection);
+		for (const FAnimNotifyProSectionTable& Section : Table.Sections)
+		{
+			Size += GetAllocatedSize(Section);
+		}
+		return Size;
+	}
+
+	/** Replaces every notify and notify state of the section with the stubs */
+	static void StubSection(FAnimNotifyProSectionTable& Section, UAnimNotifyProTest* Notify, UAnimNotifyStateProTest* NotifyState)
+	{
+		for (int32 Index = 0; Index < Section.Num(); Index++)
+		{
+			if (Section.Notifies[Index].IsValid())
+			{
+				Section.Notifies[Index] = Notify;
+			}
+			if (Section.NotifyStates[Index].IsValid())
+			{
+				Section.NotifyStates[Index] = NotifyState;
+			}
+		}
+	}
+
+	/** Costs of playing every section of a montage */
+	struct FMontageMeasurement
+	{
+		FMeasurement Build;
+		FMeasurement Gather;
+		FMeasurement Historic;
+		FMeasurement Ensure;
+	};
+
+	/**
+	 * Measures building the montage's table, then gathering, handling historic notifies and ensuring notifies for each section in turn.
+	 * Each section starts halfway through so that historic notifies have work to do.
+	 */
+	static FMontageMeasurement MeasureMontage(UAnimMontage* Montage, const TSharedRef<const FAnimNotifyProMontageTable>& Table, int32 Iterations)
+	{
+		FMontageMeasurement Result;
+
+		// Building the table is paid once per montage, then it is cached
+		Result.Build = Measure(FMath::Max(1, Iterations / 10), 1, [Montage]()
+		{
+			FAnimNotifyProMontageTable::Build(Montage);
+		});
+
+		const int32 NumSections = Montage->CompositeSections.Num();
+		TArray<float, TInlineAllocator<32>> StartPositions;
+		for (int32 SectionIndex = 0; SectionIndex < NumSections; SectionIndex++)
+		{
+			float StartTime, EndTime;
+			Montage->GetSectionStartAndEndTime(SectionIndex, StartTime, EndTime);
+			StartPositions.Add((StartTime + EndTime) * 0.5f);
+		}
+
+		FBenchmarkInterface Interface;
+		Interface.Montage = Montage;
+		uint32 NotifyId = 0;
+		auto Gather = [&](int32 SectionIndex)
+		{
+			UPlayMontageProStatics::GatherNotifies(Table, Montage, NotifyId, Interface.Notifies, Montage->CompositeSections[SectionIndex].SectionName,
+				StartPositions[SectionIndex], 1.f);
+		};
+
+		Result.Gather = Measure(Iterations, NumSections, [&]()
+		{
+			for (int32 SectionIndex = 0; SectionIndex < NumSections; SectionIndex++)
+			{
+				Gather(SectionIndex);
+			}
+		});
+		Result.Historic = Measure(Iterations, NumSections, [&]()
+		{
+			for (int32 SectionIndex = 0; SectionIndex < NumSections; SectionIndex++)
+			{
+				Gather(SectionIndex);
+				UPlayMontageProStatics::HandleHistoricNotifies(Interface.Notifies, false, &Interface);
+			}
+		}) - Result.Gather;
+		Result.Ensure = Measure(Iterations, NumSections, [&]()
+		{
+			for (int32 SectionIndex = 0; SectionIndex < NumSections; SectionIndex++)
+			{
+				Gather(SectionIndex);
+				UPlayMontageProStatics::EnsureBroadcastNotifyEvents(EAnimNotifyProEventType::OnInterrupted, Interface.Notifies, &Interface);
+			}
+		}) - Result.Gather;
+		return Result;
+	}
+
+	static void LogMeasurement(FOutputDevice& Ar, const TCHAR* Name, const FMeasurement& Measurement)
+	{
+		Ar.Logf(TEXT("    %-8s %10.0f ns %8.2f allocs %10.1f bytes"), Name, Measurement.Nanoseconds, Measurement.Allocations, Measurement.Bytes);
+	}
+
+	static void LogMontageMeasurement(FOutputDevice& Ar, const FMontageMeasurement& Measurement)
+	{
+		LogMeasurement(Ar, TEXT("build"), Measurement.Build);
+		LogMeasurement(Ar, TEXT("gather"), Measurement.Gather);
+		LogMeasurement(Ar, TEXT("historic"), Measurement.Historic);
+		LogMeasurement(Ar, TEXT("ensure"), Measurement.Ensure);
+	}
+
+	/** @return A montage with NumNotifies spread evenly over NumSections one second sections, every fourth a notify state */
+	static UAnimMontage* CreateSweepMontage(int32 NumNotifies, int32 NumSections)
+	{
+		using namespace PlayMontageProTests;
+
+		const float Length = static_cast<float>(NumSections);
+		const float Spacing = NumNotifies > 0 ? Length / NumNotifies : Length;
+
+		TArray<FTestNotify> TestNotifies;
+		TestNotifies.Reserve(NumNotifies);
+		for (int32 Index = 0; Index < NumNotifies; Index++)
+		{
+			FTestNotify& TestNotify = TestNotifies.AddDefaulted_GetRef();
+			TestNotify.Time = (Index + 0.5f) * Spacing;
+			TestNotify.Duration = Index % 4 == 3 ? FMath::Min(0.25f, Spacing * 2.f) : 0.f;
+			TestNotify.EnsureTriggerNotify = Index % 3 == 0 ? EAnimNotifyProEventType::OnInterrupted : EAnimNotifyProEventType::None;
+		}
+
+		TArray<FTestSection> Sections;
+		for (int32 SectionIndex = 0; SectionIndex < NumSections; SectionIndex++)
+		{
+			const FName NextSectionName = SectionIndex + 1 < NumSections ? FName(TEXT("Section"), SectionIndex + 2) : NAME_None;
+			Sections.Add({ FName(TEXT("Section"), SectionIndex + 1), static_cast<float>(SectionIndex), NextSectionName });
+		}
+		return CreateMontage(Length, TestNotifies, Sections);
+	}
+
+	/** Measures synthetic montages from no notifies up to a thousand, spread over many sections */
+	static void RunSweep(int32 Iterations, FOutputDevice& Ar)
+	{
+		constexpr int32 NumSections = 16;
+		for (const int32 NumNotifies : { 0, 1, 10, 100, 250, 500, 1000 })
+		{
+			const TStrongObjectPtr<UAnimMontage> Montage(CreateSweepMontage(NumNotifies, NumSections));
+			const TSharedRef<const FAnimNotifyProMontageTable> Table = FAnimNotifyProMontageTable::Build(Montage.Get());
+
+			Ar.Logf(TEXT("  %d notifies, %d sections, table %llu bytes, per call:"), NumNotifies, NumSections,
+				static_cast<uint64>(GetAllocatedSize(*Table)));
+			LogMontageMeasurement(Ar, MeasureMontage(Montage.Get(), Table, Iterations));
+		}
+	}
+
+	/** Measures a project montage, with its notifies replaced by the stubs */
+	static void RunMontage(UAnimMontage* Montage, int32 Iterations, FOutputDevice& Ar)
+	{
+		// The montage's notifies would run the project's gameplay code, with no mesh, and that cost is not what is being measured
+		const TStrongObjectPtr<UAnimNotifyProTest> StubNotify(NewObject<UAnimNotifyProTest>());
+		const TStrongObjectPtr<UAnimNotifyStateProTest> StubNotifyState(NewObject<UAnimNotifyStateProTest>());
+		const TSharedRef<FAnimNotifyProMontageTable> StubbedTable = FAnimNotifyProMontageTable::Build(Montage);
+		for (FAnimNotifyProSectionTable& Section : StubbedTable->Sections)
+		{
+			StubSection(Section, StubNotify.Get(), StubNotifyState.Get());
+		}
+		StubSection(StubbedTable->InvalidSection, StubNotify.Get(), StubNotifyState.Get());
+
+		Ar.Logf(TEXT("  %s: %d notifies, %d sections, table %llu bytes, per call:"), *Montage->GetName(), Montage->Notifies.Num(),
+			Montage->CompositeSections.Num(), static_cast<uint64>(GetAllocatedSize(*StubbedTable)));
+		LogMontageMeasurement(Ar, MeasureMontage(Montage, StubbedTable, Iterations));
+	}
+
+	static void Run(const TArray<FString>& Args, FOutputDevice& Ar)
+	{
+		// A number on its own is the iteration count for the sweep
+		const bool bSweep = Args.Num() == 0 || Args[0].IsNumeric();
+		const int32 IterationsArg = bSweep ? 0 : 1;
+		const int32 Iterations = Args.IsValidIndex(IterationsArg) ? FMath::Max(1, FCString::Atoi(*Args[IterationsArg])) : 100;
+
+		if (bSweep)
+		{
+			RunSweep(Iterations, Ar);
+		}
+		else if (UAnimMontage* Montage = LoadObject<UAnimMontage>(nullptr, *Args[0]))
+		{
+			RunMontage(Montage, Iterations, Ar);
+		}
+		else
+		{
+			Ar.Logf(TEXT("Usage: a.PlayMontagePro.Benchmark [MontagePath] [Iterations=100]"));
+		}
+	}
+
+	static FAutoConsoleCommandWithArgsAndOutputDevice BenchmarkCommand(
+		TEXT("a.PlayMontagePro.Benchmark"),
+		TEXT("Measures the time, allocations and bytes allocated per call of building a notify table, GatherNotifies, HandleHistoricNotifies and EnsureBroadcastNotifyEvents. ")
+		TEXT("Sweeps synthetic montages from 0 to 1000 notifies over 16 sections, or measures every section of the given montage. Usage: a.PlayMontagePro.Benchmark [MontagePath] [Iterations=100]"),
+		FConsoleCommandWithArgsAndOutputDeviceDelegate::CreateStatic(&Run));
+}
+#endif
@@ -0,0 +1,384 @@
+// Copyright (c) Jared Taylor
+
+#include "AnimNotifyProTable.h"
+#include "PlayMontageProStatics.h"
+#include "PlayMontageProSubsystem.h"
+#include "PlayMontageProTestHelpers.h"
+#include "PlayMontageProTestInstance.h"
+#include "Animation/AnimMontage.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/StrongObjectPtr.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace PlayMontageProTests
+{
+	/** @return Whether the event was recorded */
+	static bool WasRecorded(const UPlayMontageProTestInstance& Instance, int32 NotifyIndex)
+	{
+		return Instance.Recorded.ContainsByPredicate([NotifyIndex](const UPlayMontageProTestInstance::FRecordedEvent& Event)
+		{
+			return Event.NotifyIndex == NotifyIndex;
+		});
+	}
+
+	/** @return Index of the first event gathered from the montage notify at Time, of the given type */
+	static int32 FindEvent(const UPlayMontageProTestInstance& Instance, float Time, EAnimNotifyProType Type)
+	{
+		const FAnimNotifyProSectionTable& Table = *Instance.Notifies.Table;
+		for (int32 NotifyIndex = 0; NotifyIndex < Table.Num(); NotifyIndex++)
+		{
+			if (Table.Types[NotifyIndex] == Type)
+			{
+				// End states are placed at the end of the state, their begin state at the notify time
+				const int32 BeginIndex = Type == EAnimNotifyProType::NotifyStateEnd ? Table.PairIndices[NotifyIndex] : NotifyIndex;
+				if (FMath::IsNearlyEqual(Table.Positions[BeginIndex], Time))
+				{
+					return NotifyIndex;
+				}
+			}
+		}
+		return INDEX_NONE;
+	}
+
+	/** Checks that every recorded event was broadcast once, matches the events' state, and that end states follow their begin states */
+	static void TestOrdering(FAutomationTestBase& Test, const UPlayMontageProTestInstance& Instance)
+	{
+		const FAnimNotifyProEvents& Notifies = Instance.Notifies;
+		TBitArray<> Seen(false, Notifies.Num());
+		for (const UPlayMontageProTestInstance::FRecordedEvent& Event : Instance.Recorded)
+		{
+			if (!Test.TestTrue(TEXT("Recorded event is valid"), Notifies.IsValidIndex(Event.NotifyIndex)))
+			{
+				return;
+			}
+
+			Test.TestFalse(FString::Printf(TEXT("Event %d was broadcast more than once"), Event.NotifyIndex), static_cast<bool>(Seen[Event.NotifyIndex]));
+			Seen[Event.NotifyIndex] = true;
+
+			if (Event.Type == EAnimNotifyProType::NotifyStateEnd)
+			{
+				const int32 PairIndex = Notifies.Table->PairIndices[Event.NotifyIndex];
+				Test.TestTrue(FString::Printf(TEXT("End state %d was broadcast after its begin state %d"), Event.NotifyIndex, PairIndex),
+					Notifies.IsValidIndex(PairIndex) && Seen[PairIndex]);
+			}
+		}
+
+		for (int32 NotifyIndex = 0; NotifyIndex < Notifies.Num(); NotifyIndex++)
+		{
+			Test.TestEqual(FString::Printf(TEXT("Event %d recorded if and only if it was broadcast"), NotifyIndex),
+				static_cast<bool>(Seen[NotifyIndex]), static_cast<bool>(Notifies.HasBroadcast[NotifyIndex]));
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlayMontageProBeginBeforeEndTest, "PlayMontagePro.Notifies.BeginBeforeEnd",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPlayMontageProBeginBeforeEndTest::RunTest(const FString& Parameters)
+{
+	using namespace PlayMontageProTests;
+
+	const FScopedValidation Validation;
+	FTestWorld TestWorld;
+	UAnimMontage* Montage = CreateMontage(2.f, {
+		{ 0.25f },
+		{ 0.5f, 1.f },
+		{ 0.75f, 0.25f },
+		{ 1.25f },
+	});
+
+	// Scheduled, every event is broadcast once, in montage order
+	UPlayMontageProTestInstance* Instance = NewObject<UPlayMontageProTestInstance>();
+	Instance->Play(TestWorld.World, Montage);
+	TestWorld.Tick(FTestWorld::GetNumFrames(Montage->GetPlayLength()));
+
+	TestEqual(TEXT("Every event was broadcast"), Instance->Recorded.Num(), Instance->Notifies.Num());
+	TestOrdering(*this, *Instance);
+	for (int32 Index = 1; Index < Instance->Recorded.Num(); Index++)
+	{
+		const TArray<float>& Positions = Instance->Notifies.Table->Positions;
+		TestTrue(TEXT("Events were broadcast in montage order"),
+			Positions[Instance->Recorded[Index - 1].NotifyIndex] <= Positions[Instance->Recorded[Index].NotifyIndex]);
+	}
+
+	// Broadcasting an end state directly broadcasts its begin state first, and the scheduler skips both afterwards
+	Instance->Play(TestWorld.World, Montage);
+	const int32 EndIndex = FindEvent(*Instance, 0.5f, EAnimNotifyProType::NotifyStateEnd);
+	if (TestNotEqual(TEXT("End state was gathered"), EndIndex, static_cast<int32>(INDEX_NONE)))
+	{
+		Instance->BroadcastNotifyEvent(EndIndex);
+		TestEqual(TEXT("Begin and end state were broadcast"), Instance->Recorded.Num(), 2);
+		TestWorld.Tick(FTestWorld::GetNumFrames(Montage->GetPlayLength()));
+		TestEqual(TEXT("Every event was broadcast"), Instance->Recorded.Num(), Instance->Notifies.Num());
+		TestOrdering(*this, *Instance);
+	}
+
+	// Notify states the start position is inside of are skipped along with their end
+	Instance->Play(TestWorld.World, Montage, 1.f);
+	TestWorld.Tick(FTestWorld::GetNumFrames(Montage->GetPlayLength()));
+	TestFalse(TEXT("End state of a skipped begin state was not broadcast"),
+		WasRecorded(*Instance, FindEvent(*Instance, 0.5f, EAnimNotifyProType::NotifyStateEnd)));
+	TestTrue(TEXT("Notify after the start position was broadcast"), WasRecorded(*Instance, FindEvent(*Instance, 1.25f, EAnimNotifyProType::Notify)));
+	TestOrdering(*this, *Instance);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlayMontageProEnsureOnInterruptTest, "PlayMontagePro.Notifies.EnsureOnInterrupt",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPlayMontageProEnsureOnInterruptTest::RunTest(const FString& Parameters)
+{
+	using namespace PlayMontageProTests;
+
+	const FScopedValidation Validation;
+	FTestWorld TestWorld;
+	UAnimMontage* Montage = CreateMontage(2.f, {
+		{ 0.1f, 1.4f },
+		{ 1.f, 0.f, EAnimNotifyProEventType::OnInterrupted },
+		{ 1.2f },
+		{ 1.3f, 0.5f, EAnimNotifyProEventType::OnInterrupted },
+		{ 1.4f, 0.f, EAnimNotifyProEventType::OnCompleted },
+	});
+
+	auto TestInterrupted = [this](const UPlayMontageProTestInstance& Instance, const TCHAR* Context)
+	{
+		TestTrue(FString::Printf(TEXT("%s: Active state ended"), Context), WasRecorded(Instance, FindEvent(Instance, 0.1f, EAnimNotifyProType::NotifyStateEnd)));
+		TestTrue(FString::Printf(TEXT("%s: Ensured notify was broadcast"), Context), WasRecorded(Instance, FindEvent(Instance, 1.f, EAnimNotifyProType::Notify)));
+		TestFalse(FString::Printf(TEXT("%s: Notify that is not ensured was not broadcast"), Context), WasRecorded(Instance, FindEvent(Instance, 1.2f, EAnimNotifyProType::Notify)));
+		TestTrue(FString::Printf(TEXT("%s: Ensured state began"), Context), WasRecorded(Instance, FindEvent(Instance, 1.3f, EAnimNotifyProType::NotifyStateBegin)));
+		TestTrue(FString::Printf(TEXT("%s: Ensured state ended"), Context), WasRecorded(Instance, FindEvent(Instance, 1.3f, EAnimNotifyProType::NotifyStateEnd)));
+		TestFalse(FString::Printf(TEXT("%s: Notify ensured for another condition was not broadcast"), Context), WasRecorded(Instance, FindEvent(Instance, 1.4f, EAnimNotifyProType::Notify)));
+		TestOrdering(*this, Instance);
+	};
+
+	// Interrupted from the montage delegate
+	UPlayMontageProTestInstance* Instance = NewObject<UPlayMontageProTestInstance>();
+	Instance->Play(TestWorld.World, Montage);
+	TestWorld.Tick(FTestWorld::GetNumFrames(0.5f));
+	TestEqual(TEXT("Only the first state began"), Instance->Recorded.Num(), 1);
+	Instance->Terminate(TestWorld.World, EAnimNotifyProEventType::OnInterrupted);
+	TestInterrupted(*Instance, TEXT("Immediate"));
+
+	// Nothing is dispatched once terminated
+	const int32 NumRecorded = Instance->Recorded.Num();
+	TestWorld.Tick(FTestWorld::GetNumFrames(Montage->GetPlayLength()));
+	TestEqual(TEXT("Nothing was broadcast after termination"), Instance->Recorded.Num(), NumRecorded);
+
+	// Queued on the subsystem, broadcast with the frame's other terminations
+	Instance->Play(TestWorld.World, Montage);
+	TestWorld.Tick(FTestWorld::GetNumFrames(0.5f));
+	TestWorld.Subsystem->QueueTermination(Instance, EAnimNotifyProEventType::OnInterrupted);
+	UPlayMontageProStatics::ClearNotifyTimers(TestWorld.World, Instance->Notifies);
+	TestWorld.Tick();
+	TestInterrupted(*Instance, TEXT("Queued"));
+
+	// A queued termination is skipped if the notifies are gathered again before it is dispatched
+	Instance->Play(TestWorld.World, Montage);
+	TestWorld.Subsystem->QueueTermination(Instance, EAnimNotifyProEventType::OnInterrupted);
+	Instance->Play(TestWorld.World, Montage);
+	TestWorld.Tick();
+	TestEqual(TEXT("Stale termination was skipped"), Instance->Recorded.Num(), 0);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlayMontageProNoDoubleFireTest, "PlayMontagePro.Notifies.NoDoubleFire",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPlayMontageProNoDoubleFireTest::RunTest(const FString& Parameters)
+{
+	using namespace PlayMontageProTests;
+
+	const FScopedValidation Validation;
+	FTestWorld TestWorld;
+	constexpr EAnimNotifyProEventType EnsureAll = EAnimNotifyProEventType::OnCompleted | EAnimNotifyProEventType::BlendOut
+		| EAnimNotifyProEventType::OnInterrupted | EAnimNotifyProEventType::OnCancelled;
+	UAnimMontage* Montage = CreateMontage(2.f, {
+		{ 0.f, 0.f, EnsureAll },
+		{ 0.2f, 0.6f, EnsureAll },
+		{ 0.5f, 0.f, EnsureAll },
+		{ 0.5f },
+		{ 0.9f, 1.f, EnsureAll },
+		{ 1.5f, 0.f, EnsureAll },
+	});
+
+	// Every termination after the montage has played through
+	UPlayMontageProTestInstance* Instance = NewObject<UPlayMontageProTestInstance>();
+	Instance->Play(TestWorld.World, Montage, 0.f, true);
+	TestWorld.Tick(FTestWorld::GetNumFrames(Montage->GetPlayLength()));
+	Instance->Terminate(TestWorld.World, EAnimNotifyProEventType::BlendOut);
+	Instance->Terminate(TestWorld.World, EAnimNotifyProEventType::OnCompleted);
+	TestEqual(TEXT("Played through: every event was broadcast once"), Instance->Recorded.Num(), Instance->Notifies.Num());
+	TestOrdering(*this, *Instance);
+
+	// Historic notifies, then terminated partway with every condition in turn
+	Instance->Play(TestWorld.World, Montage, 0.6f, true);
+	TestWorld.Tick(FTestWorld::GetNumFrames(0.5f));
+	for (const EAnimNotifyProEventType EventType : { EAnimNotifyProEventType::BlendOut, EAnimNotifyProEventType::OnInterrupted,
+		EAnimNotifyProEventType::OnCompleted, EAnimNotifyProEventType::OnCancelled })
+	{
+		Instance->Terminate(TestWorld.World, EventType);
+	}
+	TestWorld.Tick(FTestWorld::GetNumFrames(Montage->GetPlayLength()));
+	TestEqual(TEXT("Terminated: every event was broadcast once"), Instance->Recorded.Num(), Instance->Notifies.Num());
+	TestOrdering(*this, *Instance);
+
+	// Rescaling the clock every frame reschedules the pending event without dispatching it again
+	Instance->Play(TestWorld.World, Montage, 0.f, true);
+	for (int32 Frame = 0; Frame < FTestWorld::GetNumFrames(Montage->GetPlayLength() * 2.f); Frame++)
+	{
+		TestWorld.Subsystem->SetTimeDilation(Instance, Instance->Notifies, Frame % 2 == 0 ? 0.5f : 1.5f);
+		TestWorld.Tick();
+	}
+	TestEqual(TEXT("Dilated: every event was broadcast once"), Instance->Recorded.Num(), Instance->Notifies.Num());
+	TestOrdering(*this, *Instance);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlayMontageProThroughputTest, "PlayMontagePro.Performance.Throughput",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FPlayMontageProThroughputTest::RunTest(const FString& Parameters)
+{
+	using namespace PlayMontageProTests;
+
+	// Eight notifies and four notify states, the states ensure they end on completion
+	TArray<FTestNotify> TestNotifies;
+	for (int32 Index = 0; Index < 8; Index++)
+	{
+		TestNotifies.Add({ 0.1f + Index * 0.2f });
+	}
+	for (int32 Index = 0; Index < 4; Index++)
+	{
+		TestNotifies.Add({ 0.15f + Index * 0.35f, 0.3f, EAnimNotifyProEventType::OnCompleted });
+	}
+	const TStrongObjectPtr<UAnimMontage> Montage(CreateMontage(2.f, TestNotifies));
+	const int32 NumFrames = FTestWorld::GetNumFrames(Montage->GetPlayLength() + 1.f);
+
+	for (const int32 NumInstances : { 10, 100, 1000, 5000 })
+	{
+		FTestWorld TestWorld;
+		TArray<TStrongObjectPtr<UPlayMontageProTestInstance>> Instances;
+		Instances.Reserve(NumInstances);
+		for (int32 Index = 0; Index < NumInstances; Index++)
+		{
+			Instances.Emplace(NewObject<UPlayMontageProTestInstance>());
+			Instances.Last()->bRecordEvents = false;
+		}
+
+		// Start positions are spread over a second, as montages started on different frames would be
+		const uint64 PlayStartCycles = FPlatformTime::Cycles64();
+		{
+			FPlayMontageProScopedScheduleBatch ScheduleBatch(TestWorld.Subsystem);
+			for (int32 Index = 0; Index < NumInstances; Index++)
+			{
+				Instances[Index]->Play(TestWorld.World, Montage.Get(), (Index % 60) * FrameTime);
+			}
+		}
+		const double PlayMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - PlayStartCycles);
+
+		const uint64 TickStartCycles = FPlatformTime::Cycles64();
+		TestWorld.Tick(NumFrames);
+		const double TickMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - TickStartCycles);
+
+		int32 NumBroadcast = 0;
+		int32 NumPending = 0;
+		for (const TStrongObjectPtr<UPlayMontageProTestInstance>& Instance : Instances)
+		{
+			const FAnimNotifyProEvents& Notifies = Instance->Notifies;
+			for (int32 NotifyIndex = 0; NotifyIndex < Notifies.Num(); NotifyIndex++)
+			{
+				// End states are never broadcast if the start position skipped their begin state
+				const int32 PairIndex = Notifies.Table->PairIndices[NotifyIndex];
+				const bool bSkipped = Notifies.Skipped[NotifyIndex] || (Notifies.IsEndState(NotifyIndex) && Notifies.IsValidIndex(PairIndex) && Notifies.Skipped[PairIndex]);
+				NumBroadcast += Notifies.HasBroadcast[NotifyIndex] ? 1 : 0;
+				NumPending += Notifies.HasBroadcast[NotifyIndex] || bSkipped ? 0 : 1;
+			}
+		}
+		TestEqual(FString::Printf(TEXT("%d instances: every event was dispatched"), NumInstances), NumPending, 0);
+
+		AddInfo(FString::Printf(TEXT("%d instances: play %.2f us/instance, %.3f ms/frame over %d frames, %.0f events/s, %d events"),
+			NumInstances, PlayMs * 1000.0 / NumInstances, TickMs / NumFrames, NumFrames,
+			TickMs > 0.0 ? NumBroadcast * 1000.0 / TickMs : 0.0, NumBroadcast));
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlayMontageProTimeDilationTest, "PlayMontagePro.Performance.TimeDilation",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FPlayMontageProTimeDilationTest::RunTest(const FString& Parameters)
+{
+	using namespace PlayMontageProTests;
+
+	// Long enough that every instance still has pending notifies while measuring
+	TArray<FTestNotify> TestNotifies;
+	for (int32 Index = 0; Index < 20; Index++)
+	{
+		TestNotifies.Add({ 0.5f + Index * 0.5f });
+	}
+	const TStrongObjectPtr<UAnimMontage> Montage(CreateMontage(11.f, TestNotifies));
+
+	constexpr int32 NumActors = 500;
+	constexpr int32 NumFrames = 120;
+
+	FTestWorld TestWorld;
+	TArray<AActor*> Actors;
+	TArray<TStrongObjectPtr<UPlayMontageProTestInstance>> Instances;
+	for (int32 Index = 0; Index < NumActors; Index++)
+	{
+		Actors.Add(TestWorld.World->SpawnActor<AActor>());
+		Instances.Emplace(NewObject<UPlayMontageProTestInstance>());
+		Instances.Last()->bRecordEvents = false;
+		Instances.Last()->Play(TestWorld.World, Montage.Get());
+		TestWorld.Subsystem->RegisterTimeDilation(Instances.Last().Get(), Actors.Last(), 1.f);
+	}
+
+	// Every actor changes dilation every frame, as with slow motion or hit stop, then the same frames with dilation held
+	auto MeasureFrames = [&TestWorld, &Actors](bool bChangeDilation)
+	{
+		uint64 Cycles = 0;
+		for (int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			const float TimeDilation = bChangeDilation ? (Frame % 2 == 0 ? 0.25f : 0.5f) : 0.5f;
+			for (AActor* Actor : Actors)
+			{
+				Actor->CustomTimeDilation = TimeDilation;
+			}
+
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			TestWorld.Tick();
+			Cycles += FPlatformTime::Cycles64() - StartCycles;
+		}
+		return FPlatformTime::ToMilliseconds64(Cycles) / NumFrames;
+	};
+
+	const double ChangedMs = MeasureFrames(true);
+	const double HeldMs = MeasureFrames(false);
+
+	int32 NumBroadcast = 0;
+	for (const TStrongObjectPtr<UPlayMontageProTestInstance>& Instance : Instances)
+	{
+		NumBroadcast += Instance->Notifies.HasBroadcast.CountSetBits();
+	}
+	TestTrue(TEXT("Notifies were dispatched while dilated"), NumBroadcast > 0);
+
+	AddInfo(FString::Printf(TEXT("%d dilated actors: %.3f ms/frame changing dilation every frame, %.3f ms/frame with dilation held, %d events"),
+		NumActors, ChangedMs, HeldMs, NumBroadcast));
+
+	for (AActor* Actor : Actors)
+	{
+		Actor->Destroy();
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,263 @@
+// Copyright (c) Jared Taylor
+
+#include "AnimNotifyStatePro.h"
+#include "PlayMontageProBatchCallbackProxy.h"
+#include "PlayMontageProCallbackProxy.h"
+#include "PlayMontageProSubsystem.h"
+#include "PlayMontageProTestHelpers.h"
+#include "PlayMontageProTestRecorder.h"
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimMontage.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/StrongObjectPtr.h"
+#include "UObject/UObjectGlobals.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace PlayMontageProTests
+{
+	using EStep = UPlayMontageProTestRecorder::EStep;
+
+	/** Plays the montage on the mesh through the Blueprint factory, and binds a new recorder to the proxy */
+	static UPlayMontageProCallbackProxy* PlayRecorded(USkeletalMeshComponent* Mesh, UAnimMontage* Montage, UPlayMontageProTestRecorder*& OutRecorder,
+		FName StartingSection = NAME_None)
+	{
+		UPlayMontageProCallbackProxy* Proxy = UPlayMontageProCallbackProxy::CreateProxyObjectForPlayMontagePro(Mesh, Montage, 1.f, 0.f, StartingSection);
+		OutRecorder = NewObject<UPlayMontageProTestRecorder>();
+		OutRecorder->Bind(Proxy);
+		return Proxy;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlayMontageProProxyBlendOutTest, "PlayMontagePro.Proxy.BlendOutThenEnd",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPlayMontageProProxyBlendOutTest::RunTest(const FString& Parameters)
+{
+	using namespace PlayMontageProTests;
+
+	const FScopedValidation Validation;
+	FTestWorld TestWorld;
+	USkeletalMeshComponent* Mesh = TestWorld.SpawnMesh();
+
+	// Blends out automatically 0.25s before the end, before the last notify is reached
+	UAnimMontage* Montage = CreateMontage(2.f, {
+		{ 0.25f },
+		{ 0.5f, 0.5f },
+		{ 1.9f, 0.f, EAnimNotifyProEventType::BlendOut },
+	});
+
+	UPlayMontageProTestRecorder* Recorder = nullptr;
+	UPlayMontageProCallbackProxy* Proxy = PlayRecorded(Mesh, Montage, Recorder);
+	TestWorld.Tick(FTestWorld::GetNumFrames(Montage->GetPlayLength() + 0.25f));
+
+	const int32 BlendOutIndex = Recorder->Find(EStep::BlendOut);
+	const int32 CompletedIndex = Recorder->Find(EStep::Completed);
+	TestTrue(TEXT("Notify was broadcast"), Recorder->Find(EStep::Notify, 0.25f) != INDEX_NONE);
+	TestTrue(TEXT("Notify state began"), Recorder->Find(EStep::NotifyStateBegin, 0.5f) != INDEX_NONE);
+	TestTrue(TEXT("Notify state ended"), Recorder->Find(EStep::NotifyStateEnd, 1.f) != INDEX_NONE);
+	TestTrue(TEXT("Montage blended out"), BlendOutIndex != INDEX_NONE);
+	TestTrue(TEXT("Montage completed after blending out"), CompletedIndex > BlendOutIndex);
+	TestEqual(TEXT("Nothing was interrupted"), Recorder->Find(EStep::Interrupted), static_cast<int32>(INDEX_NONE));
+
+	// OnBlendOut is broadcast first, then the notifies ensured for blending out
+	const int32 EnsuredIndex = Recorder->Find(EStep::Notify, 1.9f);
+	TestTrue(TEXT("Notify ensured on blend out was broadcast after OnBlendOut"), EnsuredIndex != INDEX_NONE && EnsuredIndex > BlendOutIndex);
+
+	// The proxy returned to the pool once its montage ended, and is reused unbound
+	const FPlayMontageProProxyPoolStats Stats = TestWorld.Subsystem->GetProxyPoolStats();
+	TestEqual(TEXT("Proxy was pooled"), Stats.NumPooled, 1);
+
+	const int32 NumSteps = Recorder->Steps.Num();
+	UPlayMontageProTestRecorder* NextRecorder = nullptr;
+	UPlayMontageProCallbackProxy* NextProxy = PlayRecorded(Mesh, Montage, NextRecorder);
+	TestTrue(TEXT("Pooled proxy was reused"), NextProxy == Proxy);
+	TestEqual(TEXT("Pool counted the reuse"), TestWorld.Subsystem->GetProxyPoolStats().NumReused, Stats.NumReused + 1);
+
+	TestWorld.Tick(FTestWorld::GetNumFrames(Montage->GetPlayLength() + 0.25f));
+	TestEqual(TEXT("Previous bindings were cleared"), Recorder->Steps.Num(), NumSteps);
+	TestTrue(TEXT("Reused proxy completed"), NextRecorder->Find(EStep::Completed) != INDEX_NONE);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlayMontageProProxyInterruptTest, "PlayMontagePro.Proxy.Interrupted",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPlayMontageProProxyInterruptTest::RunTest(const FString& Parameters)
+{
+	using namespace PlayMontageProTests;
+
+	const FScopedValidation Validation;
+	FTestWorld TestWorld;
+	USkeletalMeshComponent* Mesh = TestWorld.SpawnMesh();
+	UAnimMontage* Montage = CreateMontage(2.f, {
+		{ 0.25f, 1.f },
+		{ 1.f, 0.f, EAnimNotifyProEventType::OnInterrupted },
+		{ 1.2f },
+	});
+
+	UPlayMontageProTestRecorder* Recorder = nullptr;
+	PlayRecorded(Mesh, Montage, Recorder);
+	TestWorld.Tick(FTestWorld::GetNumFrames(0.5f));
+	TestTrue(TEXT("Notify state began"), Recorder->Find(EStep::NotifyStateBegin, 0.25f) != INDEX_NONE);
+
+	Mesh->GetAnimInstance()->Montage_Stop(0.25f, Montage);
+	TestWorld.Tick(FTestWorld::GetNumFrames(Montage->GetPlayLength()));
+
+	// OnInterrupted is broadcast first, then the active state ends and the ensured notify is broadcast
+	const int32 InterruptedIndex = Recorder->Find(EStep::Interrupted);
+	const int32 EndIndex = Recorder->Find(EStep::NotifyStateEnd, 1.25f);
+	const int32 EnsuredIndex = Recorder->Find(EStep::Notify, 1.f);
+	TestTrue(TEXT("Montage was interrupted"), InterruptedIndex != INDEX_NONE);
+	TestTrue(TEXT("Active state ended after OnInterrupted"), EndIndex != INDEX_NONE && EndIndex > InterruptedIndex);
+	TestTrue(TEXT("Ensured notify was broadcast after OnInterrupted"), EnsuredIndex != INDEX_NONE && EnsuredIndex > InterruptedIndex);
+	TestEqual(TEXT("Notify that is not ensured was not broadcast"), Recorder->Find(EStep::Notify, 1.2f), static_cast<int32>(INDEX_NONE));
+
+	// Blending out already reported the interruption
+	const int32 NumInterrupted = Recorder->Steps.FilterByPredicate([](const UPlayMontageProTestRecorder::FStep& Step)
+	{
+		return Step.Step == EStep::Interrupted;
+	}).Num();
+	TestEqual(TEXT("OnInterrupted was broadcast once"), NumInterrupted, 1);
+	TestEqual(TEXT("Montage did not complete"), Recorder->Find(EStep::Completed), static_cast<int32>(INDEX_NONE));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlayMontageProProxySectionTest, "PlayMontagePro.Proxy.SectionChange",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPlayMontageProProxySectionTest::RunTest(const FString& Parameters)
+{
+	using namespace PlayMontageProTests;
+
+	const FScopedValidation Validation;
+	FTestWorld TestWorld;
+	USkeletalMeshComponent* Mesh = TestWorld.SpawnMesh();
+	UAnimMontage* Montage = CreateMontage(2.f, {
+		{ 0.25f },
+		{ 1.25f },
+	}, {
+		{ TEXT("A"), 0.f, TEXT("B") },
+		{ TEXT("B"), 1.f },
+	});
+
+	// Playing into the next section gathers its notifies
+	UPlayMontageProTestRecorder* Recorder = nullptr;
+	PlayRecorded(Mesh, Montage, Recorder);
+	TestWorld.Tick(FTestWorld::GetNumFrames(Montage->GetPlayLength() + 0.25f));
+
+	const int32 FirstIndex = Recorder->Find(EStep::Notify, 0.25f);
+	const int32 SecondIndex = Recorder->Find(EStep::Notify, 1.25f);
+	TestTrue(TEXT("Notify of the first section was broadcast"), FirstIndex != INDEX_NONE);
+	TestTrue(TEXT("Notify of the next section was broadcast after it"), SecondIndex != INDEX_NONE && SecondIndex > FirstIndex);
+	TestTrue(TEXT("Montage completed"), Recorder->Find(EStep::Completed) != INDEX_NONE);
+
+	// Starting in a later section skips the earlier section's notifies
+	PlayRecorded(Mesh, Montage, Recorder, TEXT("B"));
+	TestWorld.Tick(FTestWorld::GetNumFrames(1.25f));
+	TestEqual(TEXT("Notify of the skipped section was not broadcast"), Recorder->Find(EStep::Notify, 0.25f), static_cast<int32>(INDEX_NONE));
+	TestTrue(TEXT("Notify of the starting section was broadcast"), Recorder->Find(EStep::Notify, 1.25f) != INDEX_NONE);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlayMontageProBatchGarbageCollectionTest, "PlayMontagePro.Proxy.BatchSurvivesGarbageCollection",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPlayMontageProBatchGarbageCollectionTest::RunTest(const FString& Parameters)
+{
+	using namespace PlayMontageProTests;
+
+	const FScopedValidation Validation;
+	FTestWorld TestWorld;
+	const TStrongObjectPtr<UAnimMontage> Montage(CreateMontage(2.f, {
+		{ 0.25f },
+		{ 1.25f },
+	}));
+
+	TArray<USkeletalMeshComponent*> Meshes;
+	for (int32 Index = 0; Index < 4; Index++)
+	{
+		Meshes.Add(TestWorld.SpawnMesh());
+	}
+
+	// Only the subsystem keeps the batch alive, and only the batch keeps its proxies alive
+	TWeakObjectPtr<UPlayMontageProBatchCallbackProxy> Batch = UPlayMontageProBatchCallbackProxy::CreateProxyObjectForPlayMontageProBatch(Meshes, Montage.Get());
+	TArray<TWeakObjectPtr<UPlayMontageProCallbackProxy>> Proxies;
+	for (UPlayMontageProCallbackProxy* Proxy : Batch->GetProxies())
+	{
+		Proxies.Add(Proxy);
+	}
+
+	TestWorld.Tick(FTestWorld::GetNumFrames(0.5f));
+	CollectGarbage(GARBAGE_OBJECT_FLAGS, true);
+
+	if (!TestTrue(TEXT("Batch survived garbage collection"), Batch.IsValid()))
+	{
+		return false;
+	}
+	for (int32 Index = 0; Index < Proxies.Num(); Index++)
+	{
+		TestTrue(FString::Printf(TEXT("Proxy %d survived garbage collection"), Index), Proxies[Index].IsValid() && Batch->GetProxies()[Index] == Proxies[Index].Get());
+	}
+
+	// The montages play on to the end, and the batch releases every proxy as it ends
+	TestWorld.Tick(FTestWorld::GetNumFrames(Montage->GetPlayLength()));
+	if (TestTrue(TEXT("Batch is still alive until collected"), Batch.IsValid()))
+	{
+		for (int32 Index = 0; Index < Meshes.Num(); Index++)
+		{
+			TestTrue(FString::Printf(TEXT("Montage %d completed"), Index), Batch->GetResults()[Index].Result == EPlayMontageProResult::Completed);
+			TestNull(FString::Printf(TEXT("Proxy %d was released"), Index), Batch->GetProxies()[Index]);
+		}
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlayMontageProNotifyStateTickHandleTest, "PlayMontagePro.Subsystem.NotifyStateTickHandles",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPlayMontageProNotifyStateTickHandleTest::RunTest(const FString& Parameters)
+{
+	using namespace PlayMontageProTests;
+
+	FTestWorld TestWorld;
+	USkeletalMeshComponent* Mesh = TestWorld.SpawnMesh();
+	UAnimMontage* Montage = CreateMontage(2.f, {
+		{ 0.25f, 1.5f },
+	});
+	UAnimNotifyStatePro* NotifyState = Cast<UAnimNotifyStatePro>(Montage->Notifies[0].NotifyStateClass);
+	NotifyState->TickRate = EAnimNotifyProTickRate::EveryFrame;
+	Mesh->GetAnimInstance()->Montage_Play(Montage);
+
+	// Two instances of the same state on the same mesh, e.g. the montage restarted before the previous instance's state ended
+	UPlayMontageProSubsystem* Subsystem = TestWorld.Subsystem;
+	const uint32 First = Subsystem->RegisterNotifyStateTick(NotifyState, Mesh, Montage);
+	const uint32 Second = Subsystem->RegisterNotifyStateTick(NotifyState, Mesh, Montage);
+	TestTrue(TEXT("Each instance has its own handle"), First != 0 && Second != 0 && First != Second);
+	TestTrue(TEXT("Registering an existing handle again keeps it"), Subsystem->RegisterNotifyStateTick(NotifyState, Mesh, Montage, First) == First);
+	TestEqual(TEXT("Both instances tick"), Subsystem->GetNumTickingNotifyStates(), 2);
+
+	// Ending the first instance leaves the second ticking
+	Subsystem->UnregisterNotifyStateTick(First);
+	TestWorld.Tick();
+	TestEqual(TEXT("Second instance still ticks"), Subsystem->GetNumTickingNotifyStates(), 1);
+
+	// The first handle is gone and can't end anything else
+	Subsystem->UnregisterNotifyStateTick(First);
+	TestWorld.Tick();
+	TestEqual(TEXT("Stale handle is ignored"), Subsystem->GetNumTickingNotifyStates(), 1);
+
+	Subsystem->UnregisterNotifyStateTick(Second);
+	TestWorld.Tick();
+	TestEqual(TEXT("Nothing ticks once both ended"), Subsystem->GetNumTickingNotifyStates(), 0);
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,127 @@
+// Copyright (c) Jared Taylor
+
+#include "PlayMontageProTestHelpers.h"
+
+#include "PlayMontageProSubsystem.h"
+#include "PlayMontageProTestNotifies.h"
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimMontage.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/Package.h"
+#include "UObject/UnrealType.h"
+
+namespace PlayMontageProTests
+{
+	UAnimMontage* CreateMontage(float Length, TConstArrayView<FTestNotify> TestNotifies, TConstArrayView<FTestSection> Sections)
+	{
+		UAnimMontage* Montage = NewObject<UAnimMontage>(GetTransientPackage(), NAME_None, RF_Transient);
+
+		// Normally calculated from the slot segments, which would need an animation sequence and a skeleton
+		FFloatProperty* LengthProperty = FindFProperty<FFloatProperty>(UAnimSequenceBase::StaticClass(), TEXT("SequenceLength"));
+		check(LengthProperty);
+		LengthProperty->SetPropertyValue_InContainer(Montage, Length);
+
+		if (Sections.Num() == 0)
+		{
+			FCompositeSection& Section = Montage->CompositeSections.AddDefaulted_GetRef();
+			Section.SectionName = TEXT("Default");
+			Section.SetTime(0.f);
+		}
+		for (const FTestSection& TestSection : Sections)
+		{
+			FCompositeSection& Section = Montage->CompositeSections.AddDefaulted_GetRef();
+			Section.SectionName = TestSection.Name;
+			Section.NextSectionName = TestSection.NextSectionName;
+			Section.SetTime(TestSection.Time);
+		}
+
+		for (const FTestNotify& TestNotify : TestNotifies)
+		{
+			FAnimNotifyEvent& Event = Montage->Notifies.AddDefaulted_GetRef();
+			if (TestNotify.Duration > 0.f)
+			{
+				UAnimNotifyStateProTest* NotifyState = NewObject<UAnimNotifyStateProTest>(Montage);
+				NotifyState->EnsureTriggerNotify = static_cast<int32>(TestNotify.EnsureTriggerNotify);
+				Event.NotifyStateClass = NotifyState;
+			}
+			else
+			{
+				UAnimNotifyProTest* Notify = NewObject<UAnimNotifyProTest>(Montage);
+				Notify->EnsureTriggerNotify = static_cast<int32>(TestNotify.EnsureTriggerNotify);
+				Event.Notify = Notify;
+			}
+			Event.SetTime(TestNotify.Time);
+			Event.SetDuration(TestNotify.Duration);
+		}
+		return Montage;
+	}
+
+	FTestWorld::FTestWorld()
+	{
+		World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("PlayMontageProTestWorld"));
+		GEngine->CreateNewWorldContext(EWorldType::Game).SetCurrentWorld(World);
+		Subsystem = UPlayMontageProSubsystem::Get(World);
+	}
+
+	FTestWorld::~FTestWorld()
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+	}
+
+	USkeletalMeshComponent* FTestWorld::SpawnMesh()
+	{
+		AActor* Actor = World->SpawnActor<AActor>();
+		USkeletalMeshComponent* Mesh = NewObject<USkeletalMeshComponent>(Actor);
+
+		// Never rendered, so only montages are updated and there is no pose to evaluate
+		Mesh->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickMontagesWhenNotRendered;
+		Actor->SetRootComponent(Mesh);
+		Mesh->RegisterComponent();
+
+		// Without a skeletal mesh the component won't create its anim instance
+		Mesh->AnimScriptInstance = NewObject<UAnimInstance>(Mesh);
+		Mesh->AnimScriptInstance->InitializeAnimation();
+
+		Meshes.Add(Mesh);
+		return Mesh;
+	}
+
+	void FTestWorld::Tick(int32 NumFrames)
+	{
+		for (int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			for (const TWeakObjectPtr<USkeletalMeshComponent>& Mesh : Meshes)
+			{
+				if (UAnimInstance* AnimInstance = Mesh.IsValid() ? Mesh->GetAnimInstance() : nullptr)
+				{
+					AnimInstance->UpdateAnimation(FrameTime, false);
+					AnimInstance->DispatchQueuedAnimEvents();
+				}
+			}
+			Subsystem->Tick(FrameTime);
+		}
+	}
+
+	FScopedValidation::FScopedValidation()
+		: CVar(IConsoleManager::Get().FindConsoleVariable(TEXT("a.PlayMontagePro.ValidateNotifies")))
+	{
+		if (CVar)
+		{
+			bWasEnabled = CVar->GetBool();
+			CVar->Set(true);
+		}
+	}
+
+	FScopedValidation::~FScopedValidation()
+	{
+		if (CVar)
+		{
+			CVar->Set(bWasEnabled);
+		}
+	}
+}
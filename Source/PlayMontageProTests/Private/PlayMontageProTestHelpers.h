@@ -0,0 +1,83 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PlayMontageTypes.h"
+
+class IConsoleVariable;
+class UAnimMontage;
+class UPlayMontageProSubsystem;
+class USkeletalMeshComponent;
+class UWorld;
+
+namespace PlayMontageProTests
+{
+	static constexpr float FrameTime = 1.f / 60.f;
+
+	/** Notify, or notify state if it has a duration, placed on a test montage */
+	struct FTestNotify
+	{
+		float Time = 0.f;
+		float Duration = 0.f;
+		EAnimNotifyProEventType EnsureTriggerNotify = EAnimNotifyProEventType::None;
+	};
+
+	/** Section of a test montage, starting at Time and followed by NextSectionName once it reaches its end */
+	struct FTestSection
+	{
+		FName Name;
+		float Time = 0.f;
+		FName NextSectionName = NAME_None;
+	};
+
+	/**
+	 * @return A transient montage with the test notifies, using UAnimNotifyProTest and UAnimNotifyStateProTest.
+	 * Without sections, the montage has a single section named Default.
+	 */
+	UAnimMontage* CreateMontage(float Length, TConstArrayView<FTestNotify> TestNotifies, TConstArrayView<FTestSection> Sections = {});
+
+	/**
+	 * Game world whose UPlayMontageProSubsystem is ticked by hand, so every test is deterministic and runs headless.
+	 */
+	class FTestWorld
+	{
+	public:
+		FTestWorld();
+		~FTestWorld();
+
+		UE_NONCOPYABLE(FTestWorld);
+
+		/**
+		 * Spawns an actor with a skeletal mesh component that can play montages without a skeletal mesh.
+		 * Its anim instance only updates montages, and is ticked by Tick before the subsystem as the world would.
+		 */
+		USkeletalMeshComponent* SpawnMesh();
+
+		/** Updates the montages of every spawned mesh, dispatches their montage events, then ticks the subsystem */
+		void Tick(int32 NumFrames = 1);
+
+		/** @return Number of frames until Seconds have passed */
+		static int32 GetNumFrames(float Seconds) { return FMath::CeilToInt(Seconds / FrameTime) + 1; }
+
+		UWorld* World = nullptr;
+		UPlayMontageProSubsystem* Subsystem = nullptr;
+
+	private:
+		TArray<TWeakObjectPtr<USkeletalMeshComponent>> Meshes;
+	};
+
+	/** Enables a.PlayMontagePro.ValidateNotifies for its scope, any violation then also raises an ensure and fails the test */
+	class FScopedValidation
+	{
+	public:
+		FScopedValidation();
+		~FScopedValidation();
+
+		UE_NONCOPYABLE(FScopedValidation);
+
+	private:
+		IConsoleVariable* CVar = nullptr;
+		bool bWasEnabled = false;
+	};
+}
@@ -0,0 +1,77 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnimNotifyProTable.h"
+#include "PlayMontageProInterface.h"
+#include "PlayMontageProStatics.h"
+#include "Animation/AnimMontage.h"
+#include "PlayMontageProTestInstance.generated.h"
+
+/**
+ * Owns the notifies of one simulated montage in the automation tests, and records every event broadcast to it.
+ * Drives the statics and UPlayMontageProSubsystem the same way UPlayMontageProCallbackProxy does once its montage is playing,
+ * without needing a skeletal mesh.
+ */
+UCLASS(Transient)
+class UPlayMontageProTestInstance : public UObject, public IPlayMontageProInterface
+{
+	GENERATED_BODY()
+
+public:
+	struct FRecordedEvent
+	{
+		EAnimNotifyProType Type;
+		int32 NotifyIndex;
+	};
+
+	/** Every event broadcast since the notifies were last gathered, in order */
+	TArray<FRecordedEvent> Recorded;
+
+	/** Whether events are built and recorded, disabled when measuring throughput like a proxy with nothing bound */
+	bool bRecordEvents = true;
+
+	FAnimNotifyProEvents Notifies;
+
+	/** Gathers the first section of the montage from StartPosition and schedules its notifies on the world's subsystem */
+	void Play(const UWorld* World, UAnimMontage* InMontage, float StartPosition = 0.f, bool bTriggerNotifiesBeforeStartTime = false)
+	{
+		Montage = InMontage;
+		Recorded.Reset();
+		UPlayMontageProStatics::GatherNotifies(InMontage, NotifyId, Notifies, InMontage->GetSectionName(0), StartPosition, 1.f);
+		UPlayMontageProStatics::HandleHistoricNotifies(Notifies, bTriggerNotifiesBeforeStartTime, this);
+		UPlayMontageProStatics::SetupNotifyTimers(this, World, Notifies);
+	}
+
+	/** Ensures the notifies for EventType and stops dispatching them, as the proxy does when its montage ends */
+	void Terminate(const UWorld* World, EAnimNotifyProEventType EventType)
+	{
+		UPlayMontageProStatics::EnsureBroadcastNotifyEvents(EventType, Notifies, this);
+		UPlayMontageProStatics::ClearNotifyTimers(World, Notifies);
+	}
+
+	// Begin IPlayMontageProInterface
+	virtual void BroadcastNotifyEvent(int32 NotifyIndex) override { UPlayMontageProStatics::BroadcastNotifyEvent(Notifies, NotifyIndex, this); }
+	virtual void NotifyCallback(const FAnimNotifyProEvent& Event) override { Record(Event); }
+	virtual void NotifyBeginCallback(const FAnimNotifyProEvent& Event) override { Record(Event); }
+	virtual void NotifyEndCallback(const FAnimNotifyProEvent& Event) override { Record(Event); }
+	virtual bool WantsNotifyEvents() const override { return bRecordEvents; }
+
+	virtual UAnimMontage* GetMontage() const override { return Montage; }
+	virtual USkeletalMeshComponent* GetMesh() const override { return nullptr; }
+
+	virtual FAnimNotifyProEvents& GetNotifies() override { return Notifies; }
+	// ~End IPlayMontageProInterface
+
+protected:
+	void Record(const FAnimNotifyProEvent& Event)
+	{
+		Recorded.Add({ Event.NotifyType, static_cast<int32>(Event.NotifyId - Notifies.FirstNotifyId) });
+	}
+
+	UPROPERTY()
+	TObjectPtr<UAnimMontage> Montage;
+
+	uint32 NotifyId = 0;
+};
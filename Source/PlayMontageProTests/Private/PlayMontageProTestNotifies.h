@@ -0,0 +1,34 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnimNotifyPro.h"
+#include "AnimNotifyStatePro.h"
+#include "PlayMontageProTestNotifies.generated.h"
+
+/**
+ * Notify placed on the automation tests' montages, and used by the benchmark in place of a montage's own notifies,
+ * so exercising the statics never runs gameplay code. Events are recorded by UPlayMontageProTestInstance instead.
+ */
+UCLASS(Transient, HideDropdown, NotBlueprintable)
+class UAnimNotifyProTest : public UAnimNotifyPro
+{
+	GENERATED_BODY()
+
+public:
+	virtual void NotifyCallback(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage) override {}
+};
+
+/**
+ * Notify state placed on the automation tests' montages, and used by the benchmark in place of a montage's own notify states.
+ */
+UCLASS(Transient, HideDropdown, NotBlueprintable)
+class UAnimNotifyStateProTest : public UAnimNotifyStatePro
+{
+	GENERATED_BODY()
+
+public:
+	virtual void NotifyBeginCallback(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage) override {}
+	virtual void NotifyEndCallback(USkeletalMeshComponent* MeshComp, UAnimMontage* Montage) override {}
+};
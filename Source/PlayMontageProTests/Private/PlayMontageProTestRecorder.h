@@ -0,0 +1,78 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PlayMontageProCallbackProxy.h"
+#include "PlayMontageTypes.h"
+#include "PlayMontageProTestRecorder.generated.h"
+
+/**
+ * Binds to every delegate of a UPlayMontageProCallbackProxy in the automation tests, as a Blueprint would, and records what
+ * was broadcast in order.
+ */
+UCLASS(Transient)
+class UPlayMontageProTestRecorder : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	enum class EStep : uint8
+	{
+		Notify,
+		NotifyStateBegin,
+		NotifyStateEnd,
+		BlendOut,
+		Interrupted,
+		Completed,
+	};
+
+	struct FStep
+	{
+		EStep Step;
+
+		/** Montage position of the notify, or of the end of the notify state for NotifyStateEnd */
+		float Position;
+	};
+
+	/** Everything broadcast since the recorder was bound, in order */
+	TArray<FStep> Steps;
+
+	void Bind(UPlayMontageProCallbackProxy* Proxy)
+	{
+		Proxy->OnCompleted.AddDynamic(this, &ThisClass::OnCompleted);
+		Proxy->OnBlendOut.AddDynamic(this, &ThisClass::OnBlendOut);
+		Proxy->OnInterrupted.AddDynamic(this, &ThisClass::OnInterrupted);
+		Proxy->OnNotify.AddDynamic(this, &ThisClass::OnNotify);
+		Proxy->OnNotifyStateBegin.AddDynamic(this, &ThisClass::OnNotifyStateBegin);
+		Proxy->OnNotifyStateEnd.AddDynamic(this, &ThisClass::OnNotifyStateEnd);
+	}
+
+	/** @return Index of the first step of the given type, at Position for notifies, INDEX_NONE if it wasn't recorded */
+	int32 Find(EStep Step, float Position = 0.f) const
+	{
+		const bool bMatchPosition = Step == EStep::Notify || Step == EStep::NotifyStateBegin || Step == EStep::NotifyStateEnd;
+		return Steps.IndexOfByPredicate([Step, Position, bMatchPosition](const FStep& Recorded)
+		{
+			return Recorded.Step == Step && (!bMatchPosition || FMath::IsNearlyEqual(Recorded.Position, Position));
+		});
+	}
+
+	UFUNCTION()
+	void OnCompleted(FName NotifyName) { Steps.Add({ EStep::Completed, 0.f }); }
+
+	UFUNCTION()
+	void OnBlendOut(FName NotifyName) { Steps.Add({ EStep::BlendOut, 0.f }); }
+
+	UFUNCTION()
+	void OnInterrupted(FName NotifyName) { Steps.Add({ EStep::Interrupted, 0.f }); }
+
+	UFUNCTION()
+	void OnNotify(const FAnimNotifyProEvent& Event) { Steps.Add({ EStep::Notify, Event.Position }); }
+
+	UFUNCTION()
+	void OnNotifyStateBegin(const FAnimNotifyProEvent& Event) { Steps.Add({ EStep::NotifyStateBegin, Event.Position }); }
+
+	UFUNCTION()
+	void OnNotifyStateEnd(const FAnimNotifyProEvent& Event) { Steps.Add({ EStep::NotifyStateEnd, Event.Position }); }
+};
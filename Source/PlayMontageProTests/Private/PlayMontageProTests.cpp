@@ -0,0 +1,5 @@
+// Copyright (c) Jared Taylor
+
+#include "PlayMontageProTests.h"
+
+IMPLEMENT_MODULE(FPlayMontageProTestsModule, PlayMontageProTests)
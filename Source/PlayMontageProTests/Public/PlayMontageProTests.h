@@ -0,0 +1,13 @@
+// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "Modules/ModuleManager.h"
+
+/**
+ * Automation tests and benchmarks for PlayMontagePro, along with the notifies and interfaces they play montages with.
+ * Kept out of the runtime module so none of it is cooked or compiled into shipping builds.
+ */
+class FPlayMontageProTestsModule : public IModuleInterface
+{
+};